@@ -71,6 +71,27 @@ empathy_chat_view_append_message (EmpathyChatView *view,
 	}
 }
 
+gboolean
+empathy_chat_view_can_prepend_messages (EmpathyChatView *view)
+{
+	g_return_val_if_fail (EMPATHY_IS_CHAT_VIEW (view), FALSE);
+
+	return EMPATHY_TYPE_CHAT_VIEW_GET_IFACE (view)->prepend_messages != NULL;
+}
+
+/* @messages are the oldest first, and all older than what is displayed */
+void
+empathy_chat_view_prepend_messages (EmpathyChatView *view,
+				    GList           *messages)
+{
+	g_return_if_fail (EMPATHY_IS_CHAT_VIEW (view));
+
+	if (EMPATHY_TYPE_CHAT_VIEW_GET_IFACE (view)->prepend_messages) {
+		EMPATHY_TYPE_CHAT_VIEW_GET_IFACE (view)->prepend_messages (view,
+									   messages);
+	}
+}
+
 void
 empathy_chat_view_append_event (EmpathyChatView *view,
 				const gchar    *str)
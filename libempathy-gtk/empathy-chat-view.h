@@ -44,6 +44,8 @@ struct _EmpathyChatViewIface {
 	/* VTabled */
 	void             (*append_message)       (EmpathyChatView *view,
 						  EmpathyMessage  *msg);
+	void             (*prepend_messages)     (EmpathyChatView *view,
+						  GList           *messages);
 	void             (*append_event)         (EmpathyChatView *view,
 						  const gchar     *str);
 	void             (*edit_message)         (EmpathyChatView *view,
@@ -79,6 +81,9 @@ struct _EmpathyChatViewIface {
 GType            empathy_chat_view_get_type             (void) G_GNUC_CONST;
 void             empathy_chat_view_append_message       (EmpathyChatView *view,
 							 EmpathyMessage  *msg);
+gboolean         empathy_chat_view_can_prepend_messages (EmpathyChatView *view);
+void             empathy_chat_view_prepend_messages     (EmpathyChatView *view,
+							 GList           *messages);
 void             empathy_chat_view_append_event         (EmpathyChatView *view,
 							 const gchar     *str);
 void             empathy_chat_view_edit_message         (EmpathyChatView *view,
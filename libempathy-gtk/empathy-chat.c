@@ -45,6 +45,7 @@
 #include <libempathy/empathy-utils.h>
 #include <libempathy/empathy-request-util.h>
 #include <libempathy/empathy-chatroom-manager.h>
+#include <libempathy/empathy-time.h>
 
 #include "empathy-chat.h"
 #include "empathy-spell.h"
@@ -66,6 +67,19 @@
 
 #define IS_ENTER(v) (v == GDK_KEY_Return || v == GDK_KEY_ISO_Enter || v == GDK_KEY_KP_Enter)
 #define COMPOSING_STOP_TIMEOUT 5
+/* Number of log events displayed when opening a chat, and then each time
+ * the user scrolls to the top of the history */
+#define BACKLOG_INITIAL_EVENTS 5
+#define BACKLOG_PAGE_EVENTS 25
+
+/* A set of messages, to find quickly whether a log event is one of them:
+ * either by its token, or by its timestamp and body */
+typedef struct {
+	/* owned gchar * -> itself */
+	GHashTable *tokens;
+	/* owned gint64 * -> owned GPtrArray of owned gchar * bodies */
+	GHashTable *timestamps;
+} ChatLogKeys;
 
 #define GET_PRIV(obj) EMPATHY_GET_PRIV (obj, EmpathyChat)
 struct _EmpathyChatPriv {
@@ -152,6 +166,22 @@ struct _EmpathyChatPriv {
 	gboolean           retrieving_backlogs;
 	gboolean           sms_channel;
 
+	/* TRUE while logs are being fetched, to only have one request at once */
+	gboolean           backlog_fetching;
+	/* TRUE once we know there are no older logs left to display */
+	gboolean           backlog_exhausted;
+	/* Timestamp of the oldest displayed log event, and the keys of the
+	 * events displayed with that timestamp; NULL before the first batch
+	 * has been displayed, or while a request owns it */
+	gint64             backlog_oldest;
+	ChatLogKeys       *backlog_oldest_keys;
+	/* owned token -> NULL: the logged messages displayed with their latest
+	 * edit, which older pages must not display again */
+	GHashTable        *backlog_edited;
+	/* Incremented when the chat is cleared, so the pages requested before
+	 * are dropped */
+	guint              backlog_generation;
+
 	/* we need to know whether populate-popup happened in response to
 	 * the keyboard or the mouse. We can't ask GTK for the most recent
 	 * event, because it will be a notify event. Instead we track it here */
@@ -2343,32 +2373,244 @@ chat_input_populate_popup_cb (GtkTextView *view,
 }
 
 
+static ChatLogKeys *
+chat_log_keys_new (void)
+{
+	ChatLogKeys *keys = g_slice_new (ChatLogKeys);
+
+	keys->tokens = g_hash_table_new_full (g_str_hash, g_str_equal,
+		g_free, NULL);
+	keys->timestamps = g_hash_table_new_full (g_int64_hash, g_int64_equal,
+		g_free, (GDestroyNotify) g_ptr_array_unref);
+
+	return keys;
+}
+
+static void
+chat_log_keys_free (ChatLogKeys *keys)
+{
+	if (keys == NULL)
+		return;
+
+	g_hash_table_unref (keys->tokens);
+	g_hash_table_unref (keys->timestamps);
+	g_slice_free (ChatLogKeys, keys);
+}
+
+static void
+chat_log_keys_add (ChatLogKeys *keys,
+		   const gchar *token,
+		   gint64       timestamp,
+		   const gchar *body)
+{
+	GPtrArray *bodies;
+
+	if (!EMP_STR_EMPTY (token)) {
+		gchar *tmp = g_strdup (token);
+
+		g_hash_table_replace (keys->tokens, tmp, tmp);
+	}
+
+	bodies = g_hash_table_lookup (keys->timestamps, &timestamp);
+	if (bodies == NULL) {
+		gint64 *key = g_new (gint64, 1);
+
+		*key = timestamp;
+		bodies = g_ptr_array_new_with_free_func (g_free);
+		g_hash_table_insert (keys->timestamps, key, bodies);
+	}
+
+	g_ptr_array_add (bodies, g_strdup (body));
+}
+
+/* Same test as empathy_message_equal(), plus the token when there is one */
+static gboolean
+chat_log_keys_contains (ChatLogKeys *keys,
+			const gchar *token,
+			gint64       timestamp,
+			const gchar *body)
+{
+	GPtrArray *bodies;
+	guint i;
+
+	if (keys == NULL)
+		return FALSE;
+
+	if (!EMP_STR_EMPTY (token) &&
+	    g_hash_table_lookup (keys->tokens, token) != NULL)
+		return TRUE;
+
+	bodies = g_hash_table_lookup (keys->timestamps, &timestamp);
+	if (bodies == NULL)
+		return FALSE;
+
+	for (i = 0; i < bodies->len; i++) {
+		if (!tp_strdiff (g_ptr_array_index (bodies, i), body))
+			return TRUE;
+	}
+
+	return FALSE;
+}
+
+static void
+chat_log_keys_add_message (ChatLogKeys    *keys,
+			   EmpathyMessage *message)
+{
+	chat_log_keys_add (keys, empathy_message_get_token (message),
+		empathy_message_get_timestamp (message),
+		empathy_message_get_body (message));
+}
+
+/* Get the fields empathy_message_from_tpl_log_event() would give to the
+ * message, without building it */
+static void
+chat_log_event_get_key (TplEvent     *event,
+			const gchar **token,
+			gint64       *timestamp,
+			const gchar **body)
+{
+	TplTextEvent *text = TPL_TEXT_EVENT (event);
+
+	*token = tpl_text_event_get_message_token (text);
+	*body = tpl_text_event_get_message (text);
+
+	if (EMP_STR_EMPTY (tpl_text_event_get_supersedes_token (text)))
+		*timestamp = tpl_event_get_timestamp (event);
+	else
+		*timestamp = tpl_text_event_get_edit_timestamp (text);
+}
+
+static gboolean
+chat_log_keys_contains_event (ChatLogKeys *keys,
+			      TplEvent    *event)
+{
+	const gchar *token, *body;
+	gint64 timestamp;
+
+	chat_log_event_get_key (event, &token, &timestamp, &body);
+
+	return chat_log_keys_contains (keys, token, timestamp, body);
+}
+
+static ChatLogKeys *
+chat_dup_pending_keys (EmpathyChat *chat)
+{
+	EmpathyChatPriv *priv = GET_PRIV (chat);
+	ChatLogKeys *keys = chat_log_keys_new ();
+	const GList *l;
+
+	if (priv->tp_chat == NULL)
+		return keys;
+
+	for (l = empathy_tp_chat_get_pending_messages (priv->tp_chat);
+	     l != NULL; l = g_list_next (l)) {
+		chat_log_keys_add_message (keys, l->data);
+	}
+
+	return keys;
+}
+
+/* Everything the filter needs is copied in there as it may be called from
+ * another thread */
+typedef struct {
+	/* weak pointer */
+	EmpathyChat *chat;
+	gboolean older;
+	guint num_events;
+	/* Pending messages, which will be displayed anyway */
+	ChatLogKeys *pending;
+	/* Only events before that timestamp, or at it but not in
+	 * @oldest_keys, are not displayed yet */
+	gint64 oldest;
+	ChatLogKeys *oldest_keys;
+	guint generation;
+} ChatLogFetch;
+
+static void
+chat_log_fetch_free (ChatLogFetch *fetch)
+{
+	if (fetch->chat != NULL)
+		g_object_remove_weak_pointer (G_OBJECT (fetch->chat),
+			(gpointer *) &fetch->chat);
+
+	chat_log_keys_free (fetch->pending);
+	chat_log_keys_free (fetch->oldest_keys);
+	g_slice_free (ChatLogFetch, fetch);
+}
+
 static gboolean
 chat_log_filter (TplEvent *event,
 		 gpointer user_data)
 {
-	EmpathyChat *chat = user_data;
-	EmpathyMessage *message;
-	EmpathyChatPriv *priv = GET_PRIV (chat);
-	const GList *pending;
+	ChatLogFetch *fetch = user_data;
+	gint64 timestamp;
 
-	g_return_val_if_fail (TPL_IS_EVENT (event), FALSE);
-	g_return_val_if_fail (EMPATHY_IS_CHAT (chat), FALSE);
+	g_return_val_if_fail (TPL_IS_TEXT_EVENT (event), FALSE);
 
-	pending = empathy_tp_chat_get_pending_messages (priv->tp_chat);
-	message = empathy_message_from_tpl_log_event (event);
+	timestamp = tpl_event_get_timestamp (event);
+	if (timestamp > fetch->oldest)
+		return FALSE;
+
+	if (timestamp == fetch->oldest &&
+	    chat_log_keys_contains_event (fetch->oldest_keys, event))
+		return FALSE;
+
+	return !chat_log_keys_contains_event (fetch->pending, event);
+}
 
-	for (; pending; pending = g_list_next (pending)) {
-		if (empathy_message_equal (message, pending->data)) {
-			g_object_unref (message);
-			return FALSE;
+/* Remember where the displayed logs start, for the next older page */
+static void
+chat_log_fetch_update_oldest (ChatLogFetch *fetch,
+			      GList        *events)
+{
+	EmpathyChatPriv *priv = GET_PRIV (fetch->chat);
+	GList *l;
+
+	/* Give the keys back to the chat */
+	priv->backlog_oldest_keys = fetch->oldest_keys;
+	fetch->oldest_keys = NULL;
+
+	if (g_list_length (events) < fetch->num_events)
+		priv->backlog_exhausted = TRUE;
+
+	for (l = events; l != NULL; l = g_list_next (l)) {
+		gint64 timestamp = tpl_event_get_timestamp (l->data);
+
+		if (timestamp < priv->backlog_oldest ||
+		    priv->backlog_oldest_keys == NULL) {
+			chat_log_keys_free (priv->backlog_oldest_keys);
+			priv->backlog_oldest_keys = chat_log_keys_new ();
+			priv->backlog_oldest = timestamp;
 		}
-	}
 
-	g_object_unref (message);
-	return TRUE;
+		if (timestamp == priv->backlog_oldest) {
+			const gchar *token, *body;
+			gint64 key_timestamp;
+
+			chat_log_event_get_key (l->data, &token,
+				&key_timestamp, &body);
+			chat_log_keys_add (priv->backlog_oldest_keys, token,
+				key_timestamp, body);
+		}
+	}
 }
 
+/* tpl keeps edits as events of their own; display them as an empty message
+ * with the original token and timestamp, that @edit then replaces */
+static EmpathyMessage *
+chat_new_synthetic_message (EmpathyMessage *edit)
+{
+	return g_object_new (EMPATHY_TYPE_MESSAGE,
+		"body", "",
+		"token", empathy_message_get_supersedes (edit),
+		"type", empathy_message_get_tptype (edit),
+		"timestamp", empathy_message_get_original_timestamp (edit),
+		"incoming", empathy_message_is_incoming (edit),
+		"is-backlog", TRUE,
+		"receiver", empathy_message_get_receiver (edit),
+		"sender", empathy_message_get_sender (edit),
+		NULL);
+}
 
 static void
 show_pending_messages (EmpathyChat *chat) {
@@ -2392,54 +2634,43 @@ show_pending_messages (EmpathyChat *chat) {
 }
 
 
+
 static void
-got_filtered_messages_cb (GObject *manager,
-		GAsyncResult *result,
-		gpointer user_data)
+chat_append_logs (EmpathyChat *chat,
+		  GList       *events)
 {
-	GList *l;
-	GList *messages;
-	EmpathyChat *chat = EMPATHY_CHAT (user_data);
 	EmpathyChatPriv *priv = GET_PRIV (chat);
-	GError *error = NULL;
+	ChatLogKeys *pending;
+	GList *l;
 
-	if (!tpl_log_manager_get_filtered_events_finish (TPL_LOG_MANAGER (manager),
-		result, &messages, &error)) {
-		DEBUG ("%s. Aborting.", error->message);
-		empathy_chat_view_append_event (chat->view,
-			_("Failed to retrieve recent logs"));
-		g_error_free (error);
-		goto out;
-	}
+	/* Messages may have been received while we were fetching */
+	pending = chat_dup_pending_keys (chat);
 
-	for (l = messages; l; l = g_list_next (l)) {
+	for (l = events; l; l = g_list_next (l)) {
 		EmpathyMessage *message;
 
 		g_assert (TPL_IS_EVENT (l->data));
 
+		if (chat_log_keys_contains_event (pending, l->data))
+			continue;
+
 		message = empathy_message_from_tpl_log_event (l->data);
-		g_object_unref (l->data);
 
 		if (empathy_message_is_edit (message)) {
 			/* this is an edited message, create a synthetic event
 			 * using the supersedes token and
 			 * original-message-sent timestamp, that we can then
 			 * replace */
-			EmpathyMessage *syn_msg = g_object_new (
-				EMPATHY_TYPE_MESSAGE,
-				"body", "",
-				"token", empathy_message_get_supersedes (message),
-				"type", empathy_message_get_tptype (message),
-				"timestamp", empathy_message_get_original_timestamp (message),
-				"incoming", empathy_message_is_incoming (message),
-				"is-backlog", TRUE,
-				"receiver", empathy_message_get_receiver (message),
-				"sender", empathy_message_get_sender (message),
-				NULL);
+			EmpathyMessage *syn_msg = chat_new_synthetic_message (
+				message);
 
 			empathy_chat_view_append_message (chat->view, syn_msg);
 			empathy_chat_view_edit_message (chat->view, message);
 
+			g_hash_table_insert (priv->backlog_edited,
+				g_strdup (empathy_message_get_supersedes (message)),
+				NULL);
+
 			g_object_unref (syn_msg);
 		} else {
 			/* append the latest message */
@@ -2448,9 +2679,138 @@ got_filtered_messages_cb (GObject *manager,
 
 		g_object_unref (message);
 	}
-	g_list_free (messages);
 
-out:
+	chat_log_keys_free (pending);
+}
+
+static void
+chat_prepend_logs (EmpathyChat *chat,
+		   GList       *events)
+{
+	EmpathyChatPriv *priv = GET_PRIV (chat);
+	GList *messages = NULL;
+	GList *edits = NULL;
+	GHashTable *tokens;
+	GList *l;
+
+	/* token -> message in this page */
+	tokens = g_hash_table_new (g_str_hash, g_str_equal);
+
+	for (l = events; l; l = g_list_next (l)) {
+		EmpathyMessage *message;
+		const gchar *token;
+
+		message = empathy_message_from_tpl_log_event (l->data);
+
+		if (empathy_message_is_edit (message)) {
+			token = empathy_message_get_supersedes (message);
+
+			/* A newer page already displays the message with a
+			 * later edit */
+			if (g_hash_table_lookup_extended (priv->backlog_edited,
+					token, NULL, NULL)) {
+				g_object_unref (message);
+				continue;
+			}
+
+			/* Same as in chat_append_logs(), but only if what it
+			 * replaces is not part of this page */
+			if (g_hash_table_lookup (tokens, token) == NULL) {
+				EmpathyMessage *syn_msg;
+
+				syn_msg = chat_new_synthetic_message (message);
+				g_hash_table_insert (tokens, (gpointer) token,
+					syn_msg);
+				messages = g_list_prepend (messages, syn_msg);
+			}
+
+			edits = g_list_prepend (edits, message);
+		} else {
+			token = empathy_message_get_token (message);
+
+			/* A newer page displays it through a synthetic
+			 * message already */
+			if (!EMP_STR_EMPTY (token) &&
+			    g_hash_table_lookup_extended (priv->backlog_edited,
+					token, NULL, NULL)) {
+				g_object_unref (message);
+				continue;
+			}
+
+			if (!EMP_STR_EMPTY (token))
+				g_hash_table_insert (tokens, (gpointer) token,
+					message);
+
+			messages = g_list_prepend (messages, message);
+		}
+	}
+
+	messages = g_list_reverse (messages);
+	edits = g_list_reverse (edits);
+
+	empathy_chat_view_prepend_messages (chat->view, messages);
+
+	for (l = edits; l; l = g_list_next (l)) {
+		empathy_chat_view_edit_message (chat->view, l->data);
+		g_hash_table_insert (priv->backlog_edited,
+			g_strdup (empathy_message_get_supersedes (l->data)),
+			NULL);
+	}
+
+	g_hash_table_unref (tokens);
+	g_list_free_full (messages, g_object_unref);
+	g_list_free_full (edits, g_object_unref);
+}
+
+static void
+got_filtered_messages_cb (GObject *manager,
+		GAsyncResult *result,
+		gpointer user_data)
+{
+	ChatLogFetch *fetch = user_data;
+	EmpathyChat *chat = fetch->chat;
+	EmpathyChatPriv *priv;
+	GList *messages = NULL;
+	GError *error = NULL;
+	gboolean success;
+
+	success = tpl_log_manager_get_filtered_events_finish (
+		TPL_LOG_MANAGER (manager), result, &messages, &error);
+	if (!success) {
+		DEBUG ("%s. Aborting.", error->message);
+		if (chat != NULL && !fetch->older)
+			empathy_chat_view_append_event (chat->view,
+				_("Failed to retrieve recent logs"));
+		g_error_free (error);
+		messages = NULL;
+	}
+
+	if (chat == NULL) {
+		/* The chat has been destroyed in the meantime */
+		goto out;
+	}
+
+	priv = GET_PRIV (chat);
+	priv->backlog_fetching = FALSE;
+
+	if (fetch->generation != priv->backlog_generation) {
+		/* The chat has been cleared in the meantime */
+		DEBUG ("Dropping logs requested before the chat was cleared");
+	} else if (success) {
+		chat_log_fetch_update_oldest (fetch, messages);
+
+		if (fetch->older)
+			chat_prepend_logs (chat, messages);
+		else
+			chat_append_logs (chat, messages);
+	} else {
+		/* Don't try again */
+		priv->backlog_exhausted = TRUE;
+	}
+
+	if (fetch->older)
+		goto out;
+
 	/* in case of TPL error, skip backlog and show pending messages */
 	priv->can_show_pending = TRUE;
 	show_pending_messages (chat);
@@ -2462,41 +2822,128 @@ out:
 
 	/* Turn back on scrolling */
 	empathy_chat_view_scroll (chat->view, TRUE);
+
+out:
+	g_list_free_full (messages, g_object_unref);
+	chat_log_fetch_free (fetch);
 }
 
 static void
-chat_add_logs (EmpathyChat *chat)
+chat_fetch_logs (EmpathyChat *chat,
+		 gboolean     older)
 {
 	EmpathyChatPriv *priv = GET_PRIV (chat);
+	ChatLogFetch    *fetch;
 	TplEntity       *target;
 
-	if (!priv->id) {
-		return;
-	}
-
-	/* Turn off scrolling temporarily */
-	empathy_chat_view_scroll (chat->view, FALSE);
-
-	/* Add messages from last conversation */
 	if (priv->handle_type == TP_HANDLE_TYPE_ROOM)
 	  target = tpl_entity_new_from_room_id (priv->id);
 	else
 	  target = tpl_entity_new (priv->id, TPL_ENTITY_CONTACT, NULL, NULL);
 
-	priv->retrieving_backlogs = TRUE;
+	fetch = g_slice_new0 (ChatLogFetch);
+	fetch->chat = chat;
+	g_object_add_weak_pointer (G_OBJECT (chat), (gpointer *) &fetch->chat);
+	fetch->older = older;
+	fetch->num_events = older ? BACKLOG_PAGE_EVENTS : BACKLOG_INITIAL_EVENTS;
+	fetch->pending = chat_dup_pending_keys (chat);
+	fetch->generation = priv->backlog_generation;
+	if (older) {
+		fetch->oldest = priv->backlog_oldest;
+		fetch->oldest_keys = priv->backlog_oldest_keys;
+		priv->backlog_oldest_keys = NULL;
+	} else {
+		fetch->oldest = G_MAXINT64;
+	}
+
+	priv->backlog_fetching = TRUE;
 	tpl_log_manager_get_filtered_events_async (priv->log_manager,
 						   priv->account,
 						   target,
 						   TPL_EVENT_MASK_TEXT,
-						   5,
+						   fetch->num_events,
 						   chat_log_filter,
-						   chat,
+						   fetch,
 						   got_filtered_messages_cb,
-						   (gpointer) chat);
+						   fetch);
 
 	g_object_unref (target);
 }
 
+static void
+chat_add_logs (EmpathyChat *chat)
+{
+	EmpathyChatPriv *priv = GET_PRIV (chat);
+
+	if (!priv->id) {
+		return;
+	}
+
+	/* Turn off scrolling temporarily */
+	empathy_chat_view_scroll (chat->view, FALSE);
+
+	/* Add messages from last conversation */
+	priv->retrieving_backlogs = TRUE;
+	chat_fetch_logs (chat, FALSE);
+}
+
+/**
+ * empathy_chat_load_older_logs:
+ * @chat: an #EmpathyChat
+ *
+ * Display the page of logs preceding the oldest message displayed in @chat,
+ * if there is one. This is done when the user scrolls to the top of the
+ * conversation.
+ */
+void
+empathy_chat_load_older_logs (EmpathyChat *chat)
+{
+	EmpathyChatPriv *priv = GET_PRIV (chat);
+
+	g_return_if_fail (EMPATHY_IS_CHAT (chat));
+
+	/* We only go back from what the first request displayed */
+	if (priv->backlog_fetching || priv->backlog_exhausted ||
+	    priv->backlog_oldest_keys == NULL)
+		return;
+
+	if (!empathy_chat_view_can_prepend_messages (chat->view))
+		return;
+
+	DEBUG ("Loading logs older than %" G_GINT64_FORMAT,
+		priv->backlog_oldest);
+	chat_fetch_logs (chat, TRUE);
+}
+
+static void
+chat_view_vadjustment_value_changed_cb (GtkAdjustment *adjustment,
+					EmpathyChat   *chat)
+{
+	if (gtk_adjustment_get_value (adjustment) <=
+	    gtk_adjustment_get_lower (adjustment))
+		empathy_chat_load_older_logs (chat);
+}
+
+static gboolean
+chat_view_scroll_event_cb (GtkWidget      *view,
+			   GdkEventScroll *event,
+			   EmpathyChat    *chat)
+{
+	EmpathyChatPriv *priv = GET_PRIV (chat);
+	GtkAdjustment *adjustment;
+
+	/* When the history doesn't fill the view there is nothing to scroll,
+	 * so the adjustment alone wouldn't tell us */
+	if (event->direction != GDK_SCROLL_UP)
+		return FALSE;
+
+	adjustment = gtk_scrolled_window_get_vadjustment (
+		GTK_SCROLLED_WINDOW (priv->scrolled_window_chat));
+	chat_view_vadjustment_value_changed_cb (adjustment, chat);
+
+	return FALSE;
+}
+
 static gint
 chat_contacts_completion_func (const gchar *s1,
 			       const gchar *s2,
@@ -2975,6 +3422,16 @@ chat_create_ui (EmpathyChat *chat)
 			   GTK_WIDGET (chat->view));
 	gtk_widget_show (GTK_WIDGET (chat->view));
 
+	/* Load older logs when reaching the top of the conversation */
+	g_signal_connect (gtk_scrolled_window_get_vadjustment (
+				GTK_SCROLLED_WINDOW (priv->scrolled_window_chat)),
+			  "value-changed",
+			  G_CALLBACK (chat_view_vadjustment_value_changed_cb),
+			  chat);
+	g_signal_connect (chat->view, "scroll-event",
+			  G_CALLBACK (chat_view_scroll_event_cb),
+			  chat);
+
 	/* Add input GtkTextView */
 	chat->input_text_view = empathy_input_text_view_new ();
 	g_signal_connect (chat->input_text_view, "notify::has-focus",
@@ -3105,6 +3562,9 @@ chat_finalize (GObject *object)
 		g_source_remove (priv->block_events_timeout_id);
 	}
 
+	chat_log_keys_free (priv->backlog_oldest_keys);
+	g_hash_table_unref (priv->backlog_edited);
+
 	g_free (priv->id);
 	g_free (priv->name);
 	g_free (priv->subject);
@@ -3309,6 +3769,8 @@ empathy_chat_init (EmpathyChat *chat)
 	priv->input_history = NULL;
 	priv->input_history_current = NULL;
 	priv->account_manager = tp_account_manager_dup ();
+	priv->backlog_edited = g_hash_table_new_full (g_str_hash, g_str_equal,
+		g_free, NULL);
 
 	tp_proxy_prepare_async (priv->account_manager, NULL,
 					  account_manager_prepared_cb, chat);
@@ -3955,9 +4417,21 @@ empathy_chat_get_contact_menu (EmpathyChat *chat)
 void
 empathy_chat_clear (EmpathyChat *chat)
 {
+	EmpathyChatPriv *priv;
+
 	g_return_if_fail (EMPATHY_IS_CHAT (chat));
 
+	priv = GET_PRIV (chat);
+
 	empathy_chat_view_clear (chat->view);
+
+	/* Scrolling up now pages from the point the chat was cleared at */
+	priv->backlog_generation++;
+	priv->backlog_exhausted = FALSE;
+	priv->backlog_oldest = empathy_time_get_current ();
+	chat_log_keys_free (priv->backlog_oldest_keys);
+	priv->backlog_oldest_keys = chat_log_keys_new ();
+	g_hash_table_remove_all (priv->backlog_edited);
 }
 
 void
@@ -75,6 +75,7 @@ EmpathyContact *   empathy_chat_get_remote_contact   (EmpathyChat   *chat);
 GtkWidget *        empathy_chat_get_contact_menu     (EmpathyChat   *chat);
 void               empathy_chat_clear                (EmpathyChat   *chat);
 void               empathy_chat_scroll_down          (EmpathyChat   *chat);
+void               empathy_chat_load_older_logs      (EmpathyChat   *chat);
 void               empathy_chat_cut                  (EmpathyChat   *chat);
 void               empathy_chat_copy                 (EmpathyChat   *chat);
 void               empathy_chat_paste                (EmpathyChat   *chat);
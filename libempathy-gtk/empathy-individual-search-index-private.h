@@ -0,0 +1,42 @@
+/*
+ * Copyright (C) 2012 Collabora Ltd.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef __EMPATHY_INDIVIDUAL_SEARCH_INDEX_PRIVATE_H__
+#define __EMPATHY_INDIVIDUAL_SEARCH_INDEX_PRIVATE_H__
+
+#include <libempathy-gtk/empathy-individual-search-index.h>
+
+G_BEGIN_DECLS
+
+/* For the tests and the benchmark, which can't create individuals */
+
+EmpathyIndividualSearchIndex *empathy_individual_search_index_new_unbound (
+    void);
+
+void empathy_individual_search_index_set_words (
+    EmpathyIndividualSearchIndex *self,
+    GObject *item,
+    GPtrArray *words);
+
+void empathy_individual_search_index_remove (
+    EmpathyIndividualSearchIndex *self,
+    GObject *item);
+
+G_END_DECLS
+
+#endif /* __EMPATHY_INDIVIDUAL_SEARCH_INDEX_PRIVATE_H__ */
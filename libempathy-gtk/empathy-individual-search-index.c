@@ -0,0 +1,562 @@
+/*
+ * Copyright (C) 2012 Collabora Ltd.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <config.h>
+#include <string.h>
+
+#include <folks/folks.h>
+#include <telepathy-glib/util.h>
+
+#include <libempathy/empathy-individual-manager.h>
+#include <libempathy/empathy-utils.h>
+
+#include "empathy-individual-search-index.h"
+#include "empathy-individual-search-index-private.h"
+#include "empathy-live-search.h"
+
+#define DEBUG_FLAG EMPATHY_DEBUG_CONTACT
+#include <libempathy/empathy-debug.h>
+
+/* The index maps the first 1, 2 and PREFIX_MAX_CHARS chars of each searchable
+ * string to the individuals having it. Looking up a search string only gives
+ * the individuals sharing its first chars, which the caller still has to
+ * match with empathy_individual_match_string(). */
+#define PREFIX_MAX_CHARS 3
+
+G_DEFINE_TYPE (EmpathyIndividualSearchIndex, empathy_individual_search_index,
+    G_TYPE_OBJECT)
+
+#define GET_PRIV(obj) EMPATHY_GET_PRIV (obj, EmpathyIndividualSearchIndex)
+
+typedef struct
+{
+  EmpathyIndividualManager *manager;
+  /* Hash: owned prefix -> GHashTable (FolksIndividual* -> NULL) */
+  GHashTable *postings;
+  /* Hash: owned FolksIndividual* -> GHashTable (owned prefix -> NULL), the
+   * prefixes the individual is indexed under */
+  GHashTable *individuals;
+} EmpathyIndividualSearchIndexPriv;
+
+static EmpathyIndividualSearchIndex *index_singleton = NULL;
+
+static void
+search_index_add_key (EmpathyIndividualSearchIndex *self,
+    FolksIndividual *individual,
+    GHashTable *prefixes,
+    const gchar *key)
+{
+  EmpathyIndividualSearchIndexPriv *priv = GET_PRIV (self);
+  const gchar *p;
+  guint i;
+
+  if (key == NULL)
+    return;
+
+  for (i = 0, p = key; i < PREFIX_MAX_CHARS && *p != '\0'; i++)
+    {
+      GHashTable *posting;
+      gchar *prefix;
+
+      p = g_utf8_next_char (p);
+      prefix = g_strndup (key, p - key);
+
+      if (g_hash_table_lookup_extended (prefixes, prefix, NULL, NULL))
+        {
+          g_free (prefix);
+          continue;
+        }
+
+      g_hash_table_insert (prefixes, prefix, NULL);
+
+      posting = g_hash_table_lookup (priv->postings, prefix);
+      if (posting == NULL)
+        {
+          posting = g_hash_table_new (NULL, NULL);
+          g_hash_table_insert (priv->postings, g_strdup (prefix), posting);
+        }
+
+      g_hash_table_insert (posting, individual, NULL);
+    }
+}
+
+static void
+search_index_add_words (EmpathyIndividualSearchIndex *self,
+    FolksIndividual *individual,
+    GHashTable *prefixes,
+    GPtrArray *words)
+{
+  GString *key;
+  guint i, j;
+
+  if (words == NULL)
+    return;
+
+  key = g_string_sized_new (16);
+
+  /* A search word can start at any of the words and go on with the next
+   * ones, see empathy_live_search_match_stripped_words(): index the first
+   * chars of the words following each word, not just of the word */
+  for (i = 0; i < words->len; i++)
+    {
+      g_string_truncate (key, 0);
+
+      for (j = i; j < words->len &&
+           g_utf8_strlen (key->str, -1) < PREFIX_MAX_CHARS; j++)
+        g_string_append (key, g_ptr_array_index (words, j));
+
+      search_index_add_key (self, individual, prefixes, key->str);
+    }
+
+  g_string_free (key, TRUE);
+}
+
+/* Index an ID the way empathy_individual_match_string() matches it: as a
+ * whole and by the words of its part before the '@' */
+static void
+search_index_add_id (EmpathyIndividualSearchIndex *self,
+    FolksIndividual *individual,
+    GHashTable *prefixes,
+    GObject *owner,
+    const gchar *id)
+{
+  const gchar *p;
+
+  if (id == NULL)
+    return;
+
+  search_index_add_key (self, individual, prefixes, id);
+
+  p = strchr (id, '@');
+  search_index_add_words (self, individual, prefixes,
+      empathy_live_search_get_cached_words (owner, id,
+          p != NULL ? p - id : -1));
+}
+
+static void
+search_index_remove_prefixes (EmpathyIndividualSearchIndex *self,
+    FolksIndividual *individual,
+    GHashTable *prefixes)
+{
+  EmpathyIndividualSearchIndexPriv *priv = GET_PRIV (self);
+  GHashTableIter iter;
+  gpointer prefix;
+
+  g_hash_table_iter_init (&iter, prefixes);
+  while (g_hash_table_iter_next (&iter, &prefix, NULL))
+    {
+      GHashTable *posting = g_hash_table_lookup (priv->postings, prefix);
+
+      if (posting == NULL)
+        continue;
+
+      g_hash_table_remove (posting, individual);
+      if (g_hash_table_size (posting) == 0)
+        g_hash_table_remove (priv->postings, prefix);
+    }
+
+  g_hash_table_remove_all (prefixes);
+}
+
+static void
+search_index_update_individual (EmpathyIndividualSearchIndex *self,
+    FolksIndividual *individual)
+{
+  EmpathyIndividualSearchIndexPriv *priv = GET_PRIV (self);
+  GHashTable *prefixes;
+  GeeIterator *iter;
+  const gchar *str;
+
+  prefixes = g_hash_table_lookup (priv->individuals, individual);
+  if (prefixes == NULL)
+    return;
+
+  search_index_remove_prefixes (self, individual, prefixes);
+
+  str = folks_alias_details_get_alias (FOLKS_ALIAS_DETAILS (individual));
+  search_index_add_words (self, individual, prefixes,
+      empathy_live_search_get_cached_words (G_OBJECT (individual), str, -1));
+
+  iter = gee_iterable_iterator (
+      GEE_ITERABLE (folks_individual_get_personas (individual)));
+  while (gee_iterator_next (iter))
+    {
+      FolksPersona *persona = gee_iterator_get (iter);
+
+      if (empathy_folks_persona_is_interesting (persona))
+        search_index_add_id (self, individual, prefixes, G_OBJECT (persona),
+            folks_persona_get_display_id (persona));
+
+      g_clear_object (&persona);
+    }
+  g_clear_object (&iter);
+
+  iter = gee_iterable_iterator (GEE_ITERABLE (
+      folks_email_details_get_email_addresses (
+          FOLKS_EMAIL_DETAILS (individual))));
+  while (gee_iterator_next (iter))
+    {
+      FolksAbstractFieldDetails *details = gee_iterator_get (iter);
+
+      search_index_add_id (self, individual, prefixes, G_OBJECT (details),
+          folks_abstract_field_details_get_value (details));
+
+      g_clear_object (&details);
+    }
+  g_clear_object (&iter);
+
+  iter = gee_iterable_iterator (GEE_ITERABLE (
+      folks_phone_details_get_phone_numbers (
+          FOLKS_PHONE_DETAILS (individual))));
+  while (gee_iterator_next (iter))
+    {
+      FolksPhoneFieldDetails *details = gee_iterator_get (iter);
+      gchar *normalised;
+
+      normalised = folks_phone_field_details_get_normalised (details);
+      search_index_add_key (self, individual, prefixes, normalised);
+
+      g_free (normalised);
+      g_clear_object (&details);
+    }
+  g_clear_object (&iter);
+}
+
+static void
+search_index_individual_notify_cb (FolksIndividual *individual,
+    GParamSpec *pspec,
+    EmpathyIndividualSearchIndex *self)
+{
+  search_index_update_individual (self, individual);
+}
+
+static void
+search_index_personas_changed_cb (FolksIndividual *individual,
+    GeeSet *added,
+    GeeSet *removed,
+    EmpathyIndividualSearchIndex *self)
+{
+  search_index_update_individual (self, individual);
+}
+
+static void
+search_index_add_individual (EmpathyIndividualSearchIndex *self,
+    FolksIndividual *individual)
+{
+  EmpathyIndividualSearchIndexPriv *priv = GET_PRIV (self);
+
+  if (g_hash_table_lookup (priv->individuals, individual) != NULL)
+    return;
+
+  g_hash_table_insert (priv->individuals, g_object_ref (individual),
+      g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL));
+
+  g_signal_connect (individual, "notify::alias",
+      G_CALLBACK (search_index_individual_notify_cb), self);
+  g_signal_connect (individual, "notify::email-addresses",
+      G_CALLBACK (search_index_individual_notify_cb), self);
+  g_signal_connect (individual, "notify::phone-numbers",
+      G_CALLBACK (search_index_individual_notify_cb), self);
+  g_signal_connect (individual, "personas-changed",
+      G_CALLBACK (search_index_personas_changed_cb), self);
+
+  search_index_update_individual (self, individual);
+}
+
+static void
+search_index_disconnect_individual (EmpathyIndividualSearchIndex *self,
+    FolksIndividual *individual)
+{
+  g_signal_handlers_disconnect_by_func (individual,
+      search_index_individual_notify_cb, self);
+  g_signal_handlers_disconnect_by_func (individual,
+      search_index_personas_changed_cb, self);
+}
+
+static void
+search_index_remove_individual (EmpathyIndividualSearchIndex *self,
+    FolksIndividual *individual)
+{
+  EmpathyIndividualSearchIndexPriv *priv = GET_PRIV (self);
+  GHashTable *prefixes;
+
+  prefixes = g_hash_table_lookup (priv->individuals, individual);
+  if (prefixes == NULL)
+    return;
+
+  search_index_remove_prefixes (self, individual, prefixes);
+  search_index_disconnect_individual (self, individual);
+
+  g_hash_table_remove (priv->individuals, individual);
+}
+
+static void
+search_index_members_changed_cb (EmpathyIndividualManager *manager,
+    const gchar *message,
+    GList *added,
+    GList *removed,
+    guint reason,
+    EmpathyIndividualSearchIndex *self)
+{
+  GList *l;
+
+  for (l = added; l != NULL; l = l->next)
+    search_index_add_individual (self, l->data);
+
+  for (l = removed; l != NULL; l = l->next)
+    search_index_remove_individual (self, l->data);
+}
+
+static void
+search_index_add_prefix_matches (EmpathyIndividualSearchIndex *self,
+    const gchar *key,
+    GHashTable *candidates)
+{
+  EmpathyIndividualSearchIndexPriv *priv = GET_PRIV (self);
+  GHashTable *posting;
+  GHashTableIter iter;
+  gpointer individual;
+  const gchar *p;
+  gchar *prefix;
+  guint i;
+
+  if (EMP_STR_EMPTY (key))
+    return;
+
+  for (i = 0, p = key; i < PREFIX_MAX_CHARS && *p != '\0'; i++)
+    p = g_utf8_next_char (p);
+
+  prefix = g_strndup (key, p - key);
+  posting = g_hash_table_lookup (priv->postings, prefix);
+  g_free (prefix);
+
+  if (posting == NULL)
+    return;
+
+  g_hash_table_iter_init (&iter, posting);
+  while (g_hash_table_iter_next (&iter, &individual, NULL))
+    g_hash_table_insert (candidates, individual, NULL);
+}
+
+/**
+ * empathy_individual_search_index_lookup:
+ * @self: an #EmpathyIndividualSearchIndex
+ * @text: the searched text
+ * @words: the stripped words of @text, as returned by
+ *  empathy_live_search_strip_utf8_string()
+ * @candidates: a #GHashTable of FolksIndividual* -> %NULL
+ *
+ * Adds to @candidates the individuals which may match @text according to
+ * empathy_individual_match_string(). Those which aren't added don't match.
+ */
+void
+empathy_individual_search_index_lookup (EmpathyIndividualSearchIndex *self,
+    const gchar *text,
+    GPtrArray *words,
+    GHashTable *candidates)
+{
+  gchar *number;
+
+  g_return_if_fail (EMPATHY_IS_INDIVIDUAL_SEARCH_INDEX (self));
+
+  /* Each word has to be a prefix of one of the indexed words, possibly
+   * followed by the next ones; the first search word will do; or the text a prefix of an ID or of an e-mail address, or the
+   * digits of a phone number */
+  if (words != NULL && words->len > 0)
+    search_index_add_prefix_matches (self, g_ptr_array_index (words, 0),
+        candidates);
+
+  search_index_add_prefix_matches (self, text, candidates);
+
+  number = empathy_live_search_strip_phone_number (text);
+  search_index_add_prefix_matches (self, number, candidates);
+  g_free (number);
+}
+
+static void
+search_index_dispose (GObject *object)
+{
+  EmpathyIndividualSearchIndex *self = EMPATHY_INDIVIDUAL_SEARCH_INDEX (object);
+  EmpathyIndividualSearchIndexPriv *priv = GET_PRIV (self);
+  GHashTableIter iter;
+  gpointer individual;
+
+  if (priv->manager != NULL)
+    {
+      g_signal_handlers_disconnect_by_func (priv->manager,
+          search_index_members_changed_cb, self);
+      tp_clear_object (&priv->manager);
+    }
+
+  g_hash_table_iter_init (&iter, priv->individuals);
+  while (g_hash_table_iter_next (&iter, &individual, NULL))
+    search_index_disconnect_individual (self, individual);
+
+  g_hash_table_remove_all (priv->individuals);
+  g_hash_table_remove_all (priv->postings);
+
+  G_OBJECT_CLASS (empathy_individual_search_index_parent_class)->dispose (
+      object);
+}
+
+static void
+search_index_finalize (GObject *object)
+{
+  EmpathyIndividualSearchIndexPriv *priv = GET_PRIV (object);
+
+  g_hash_table_unref (priv->individuals);
+  g_hash_table_unref (priv->postings);
+
+  G_OBJECT_CLASS (empathy_individual_search_index_parent_class)->finalize (
+      object);
+}
+
+static void
+empathy_individual_search_index_class_init (
+    EmpathyIndividualSearchIndexClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  object_class->dispose = search_index_dispose;
+  object_class->finalize = search_index_finalize;
+
+  g_type_class_add_private (object_class,
+      sizeof (EmpathyIndividualSearchIndexPriv));
+}
+
+static void
+empathy_individual_search_index_init (EmpathyIndividualSearchIndex *self)
+{
+  EmpathyIndividualSearchIndexPriv *priv = G_TYPE_INSTANCE_GET_PRIVATE (self,
+      EMPATHY_TYPE_INDIVIDUAL_SEARCH_INDEX, EmpathyIndividualSearchIndexPriv);
+
+  self->priv = priv;
+  priv->postings = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+      (GDestroyNotify) g_hash_table_unref);
+  priv->individuals = g_hash_table_new_full (NULL, NULL, g_object_unref,
+      (GDestroyNotify) g_hash_table_unref);
+}
+
+/**
+ * empathy_individual_search_index_dup_singleton:
+ *
+ * Returns the index of the individuals of the
+ * #EmpathyIndividualManager singleton, which is kept up to date as they
+ * change.
+ *
+ * Returns: (transfer full): the #EmpathyIndividualSearchIndex singleton
+ */
+EmpathyIndividualSearchIndex *
+empathy_individual_search_index_dup_singleton (void)
+{
+  EmpathyIndividualSearchIndexPriv *priv;
+  GList *individuals, *l;
+
+  if (index_singleton != NULL)
+    return g_object_ref (index_singleton);
+
+  index_singleton = empathy_individual_search_index_new_unbound ();
+  g_object_add_weak_pointer (G_OBJECT (index_singleton),
+      (gpointer *) &index_singleton);
+
+  priv = GET_PRIV (index_singleton);
+  priv->manager = empathy_individual_manager_dup_singleton ();
+
+  g_signal_connect (priv->manager, "members-changed",
+      G_CALLBACK (search_index_members_changed_cb), index_singleton);
+
+  individuals = empathy_individual_manager_get_members (priv->manager);
+  for (l = individuals; l != NULL; l = l->next)
+    search_index_add_individual (index_singleton, l->data);
+  g_list_free (individuals);
+
+  DEBUG ("Indexed %u individuals under %u prefixes",
+      g_hash_table_size (priv->individuals),
+      g_hash_table_size (priv->postings));
+
+  return index_singleton;
+}
+
+/* Private API, to test the index without an EmpathyIndividualManager */
+
+/**
+ * empathy_individual_search_index_new_unbound:
+ *
+ * Returns: (transfer full): a new, empty #EmpathyIndividualSearchIndex
+ * which is not bound to the #EmpathyIndividualManager
+ */
+EmpathyIndividualSearchIndex *
+empathy_individual_search_index_new_unbound (void)
+{
+  return g_object_new (EMPATHY_TYPE_INDIVIDUAL_SEARCH_INDEX, NULL);
+}
+
+/**
+ * empathy_individual_search_index_set_words:
+ * @self: an #EmpathyIndividualSearchIndex
+ * @item: the object to index, which can be any #GObject
+ * @words: the stripped words to index @item under, as returned by
+ *  empathy_live_search_strip_utf8_string()
+ *
+ * Indexes @item under @words only, adding it to the index if needed, the
+ * way the alias of an individual is indexed.
+ */
+void
+empathy_individual_search_index_set_words (EmpathyIndividualSearchIndex *self,
+    GObject *item,
+    GPtrArray *words)
+{
+  EmpathyIndividualSearchIndexPriv *priv = GET_PRIV (self);
+  /* the index only uses individuals as keys */
+  FolksIndividual *individual = (FolksIndividual *) item;
+  GHashTable *prefixes;
+
+  g_return_if_fail (EMPATHY_IS_INDIVIDUAL_SEARCH_INDEX (self));
+  g_return_if_fail (G_IS_OBJECT (item));
+
+  prefixes = g_hash_table_lookup (priv->individuals, individual);
+  if (prefixes == NULL)
+    {
+      prefixes = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+          NULL);
+      g_hash_table_insert (priv->individuals, g_object_ref (individual),
+          prefixes);
+    }
+  else
+    {
+      search_index_remove_prefixes (self, individual, prefixes);
+    }
+
+  search_index_add_words (self, individual, prefixes, words);
+}
+
+/**
+ * empathy_individual_search_index_remove:
+ * @self: an #EmpathyIndividualSearchIndex
+ * @item: an object indexed with empathy_individual_search_index_set_words()
+ *
+ * Removes @item from the index.
+ */
+void
+empathy_individual_search_index_remove (EmpathyIndividualSearchIndex *self,
+    GObject *item)
+{
+  g_return_if_fail (EMPATHY_IS_INDIVIDUAL_SEARCH_INDEX (self));
+
+  search_index_remove_individual (self, (FolksIndividual *) item);
+}
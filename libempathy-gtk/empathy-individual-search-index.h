@@ -0,0 +1,60 @@
+/*
+ * Copyright (C) 2012 Collabora Ltd.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef __EMPATHY_INDIVIDUAL_SEARCH_INDEX_H__
+#define __EMPATHY_INDIVIDUAL_SEARCH_INDEX_H__
+
+#include <glib-object.h>
+
+G_BEGIN_DECLS
+
+#define EMPATHY_TYPE_INDIVIDUAL_SEARCH_INDEX         (empathy_individual_search_index_get_type ())
+#define EMPATHY_INDIVIDUAL_SEARCH_INDEX(o)           (G_TYPE_CHECK_INSTANCE_CAST ((o), EMPATHY_TYPE_INDIVIDUAL_SEARCH_INDEX, EmpathyIndividualSearchIndex))
+#define EMPATHY_INDIVIDUAL_SEARCH_INDEX_CLASS(k)     (G_TYPE_CHECK_CLASS_CAST ((k), EMPATHY_TYPE_INDIVIDUAL_SEARCH_INDEX, EmpathyIndividualSearchIndexClass))
+#define EMPATHY_IS_INDIVIDUAL_SEARCH_INDEX(o)        (G_TYPE_CHECK_INSTANCE_TYPE ((o), EMPATHY_TYPE_INDIVIDUAL_SEARCH_INDEX))
+#define EMPATHY_IS_INDIVIDUAL_SEARCH_INDEX_CLASS(k)  (G_TYPE_CHECK_CLASS_TYPE ((k), EMPATHY_TYPE_INDIVIDUAL_SEARCH_INDEX))
+#define EMPATHY_INDIVIDUAL_SEARCH_INDEX_GET_CLASS(o) (G_TYPE_INSTANCE_GET_CLASS ((o), EMPATHY_TYPE_INDIVIDUAL_SEARCH_INDEX, EmpathyIndividualSearchIndexClass))
+
+typedef struct _EmpathyIndividualSearchIndex      EmpathyIndividualSearchIndex;
+typedef struct _EmpathyIndividualSearchIndexClass EmpathyIndividualSearchIndexClass;
+
+struct _EmpathyIndividualSearchIndex {
+  GObject parent;
+
+  /*<private>*/
+  gpointer priv;
+};
+
+struct _EmpathyIndividualSearchIndexClass {
+  GObjectClass parent_class;
+};
+
+GType empathy_individual_search_index_get_type (void) G_GNUC_CONST;
+
+EmpathyIndividualSearchIndex *empathy_individual_search_index_dup_singleton (
+    void);
+
+void empathy_individual_search_index_lookup (
+    EmpathyIndividualSearchIndex *self,
+    const gchar *text,
+    GPtrArray *words,
+    GHashTable *candidates);
+
+G_END_DECLS
+
+#endif /* __EMPATHY_INDIVIDUAL_SEARCH_INDEX_H__ */
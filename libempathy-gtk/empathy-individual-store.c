@@ -57,6 +57,13 @@
 /* Time in seconds after connecting which we wait before active users are enabled */
 #define ACTIVE_USER_WAIT_TO_ENABLE_TIME 5
 
+/* Number of individuals added at once above which we sort the store once
+ * after adding them, rather than sorting each row as it is inserted */
+#define BULK_INSERT_MIN_INDIVIDUALS 32
+
+/* Maximum number of avatars being loaded at the same time */
+#define AVATAR_LOADS_MAX 8
+
 #define GET_PRIV(obj) EMPATHY_GET_PRIV (obj, EmpathyIndividualStore)
 typedef struct
 {
@@ -77,8 +84,44 @@ typedef struct
   GHashTable                  *folks_individual_cache;
   /* Hash: char *groupname -> GtkTreeIter * */
   GHashTable                  *empathy_group_cache;
+  /* Hash: owned EmpathyContact* -> FolksIndividual* having its persona */
+  GHashTable                  *empathy_contact_cache;
+  /* Number of individual_store_begin_bulk() calls not matched yet */
+  guint bulk_count;
+  /* Individuals whose avatar has to be loaded: owned FolksIndividual*s
+   * in the queue, and the set of them */
+  GQueue *avatar_queue;
+  GHashTable *avatar_queued;
+  /* Set of FolksIndividual*s whose avatar has been asked for by a view,
+   * see empathy_individual_store_load_avatar() */
+  GHashTable *avatars_wanted;
+  guint avatar_loads_running;
+  guint avatar_idle_id;
+  /* Set of FolksIndividual*s whose rows have to be refreshed, see
+   * individual_store_queue_update() */
+  GHashTable *updates_pending;
+  guint updates_idle_id;
+  /* Hash: FolksIndividual* -> owned IndividualSortKey*, also referenced by
+   * its rows */
+  GHashTable *sort_keys;
 } EmpathyIndividualStorePriv;
 
+/* What individual_store_contact_sort() compares, computed once per change
+ * of the individual rather than at each comparison */
+typedef struct
+{
+  /* g_utf8_collate_key() of the alias */
+  gchar *alias_key;
+  TpConnectionPresenceType presence;
+  /* The protocol and account path of the individual's EmpathyContact, if it
+   * has one */
+  gboolean has_contact;
+  gchar *protocol;
+  gchar *account_path;
+  /* g_utf8_collate_key() of the id */
+  gchar *id_key;
+} IndividualSortKey;
+
 typedef struct
 {
   EmpathyIndividualStore *self;
@@ -101,10 +144,79 @@ enum
 /* prototypes to break cycles */
 static void individual_store_contact_update (EmpathyIndividualStore *self,
     FolksIndividual *individual);
+static void individual_store_schedule_avatar_loads (
+    EmpathyIndividualStore *self);
 
 G_DEFINE_TYPE (EmpathyIndividualStore, empathy_individual_store,
     GTK_TYPE_TREE_STORE);
 
+static void
+individual_sort_key_clear (IndividualSortKey *key)
+{
+  g_free (key->alias_key);
+  g_free (key->protocol);
+  g_free (key->account_path);
+  g_free (key->id_key);
+}
+
+static void
+individual_sort_key_free (IndividualSortKey *key)
+{
+  individual_sort_key_clear (key);
+  g_slice_free (IndividualSortKey, key);
+}
+
+/* Returns the sort key of @individual, brought up to date. It has to be
+ * updated before its rows are changed, as that's when they get sorted. */
+static IndividualSortKey *
+individual_store_update_sort_key (EmpathyIndividualStore *self,
+    FolksIndividual *individual)
+{
+  EmpathyIndividualStorePriv *priv = GET_PRIV (self);
+  IndividualSortKey *key;
+  EmpathyContact *contact;
+
+  key = g_hash_table_lookup (priv->sort_keys, individual);
+  if (key == NULL)
+    {
+      /* The rows keep pointing to the same key */
+      key = g_slice_new0 (IndividualSortKey);
+      g_hash_table_insert (priv->sort_keys, individual, key);
+    }
+  else
+    {
+      individual_sort_key_clear (key);
+    }
+
+  key->alias_key = g_utf8_collate_key (
+      folks_alias_details_get_alias (FOLKS_ALIAS_DETAILS (individual)), -1);
+  key->presence = empathy_folks_presence_type_to_tp (
+      folks_presence_details_get_presence_type (
+          FOLKS_PRESENCE_DETAILS (individual)));
+  key->id_key = g_utf8_collate_key (folks_individual_get_id (individual), -1);
+
+  contact = empathy_contact_dup_from_folks_individual (individual);
+  key->has_contact = (contact != NULL);
+  if (contact != NULL)
+    {
+      TpAccount *account = empathy_contact_get_account (contact);
+
+      g_assert (account != NULL);
+
+      key->protocol = g_strdup (tp_account_get_protocol (account));
+      key->account_path = g_strdup (tp_proxy_get_object_path (account));
+    }
+  else
+    {
+      key->protocol = NULL;
+      key->account_path = NULL;
+    }
+
+  tp_clear_object (&contact);
+
+  return key;
+}
+
 /* Calculate whether the Individual can do audio or video calls.
  * FIXME: We can remove this once libfolks has grown capabilities support
  * again: bgo#626179. */
@@ -196,6 +308,44 @@ while_finish:
   return types;
 }
 
+static guint
+individual_get_flags (FolksIndividual *individual,
+    gboolean is_online)
+{
+  GeeSet *personas;
+  GeeIterator *iter;
+  guint flags = 0;
+
+  personas = folks_individual_get_personas (individual);
+  iter = gee_iterable_iterator (GEE_ITERABLE (personas));
+  while (gee_iterator_next (iter))
+    {
+      FolksPersona *persona = gee_iterator_get (iter);
+      gboolean interesting = empathy_folks_persona_is_interesting (persona);
+
+      g_clear_object (&persona);
+
+      if (interesting)
+        {
+          flags |= EMPATHY_INDIVIDUAL_STORE_FLAG_INTERESTING;
+          break;
+        }
+    }
+  g_clear_object (&iter);
+
+  if (folks_individual_get_trust_level (individual) == FOLKS_TRUST_LEVEL_NONE)
+    flags |= EMPATHY_INDIVIDUAL_STORE_FLAG_UNTRUSTED;
+
+  if (folks_favourite_details_get_is_favourite (
+          FOLKS_FAVOURITE_DETAILS (individual)))
+    flags |= EMPATHY_INDIVIDUAL_STORE_FLAG_FAVOURITE;
+
+  if (is_online)
+    flags |= EMPATHY_INDIVIDUAL_STORE_FLAG_ONLINE;
+
+  return flags;
+}
+
 static void
 add_individual_to_store (GtkTreeStore *self,
     GtkTreeIter *iter,
@@ -215,12 +365,16 @@ add_individual_to_store (GtkTreeStore *self,
   gtk_tree_store_insert_with_values (self, iter, parent, 0,
       EMPATHY_INDIVIDUAL_STORE_COL_NAME,
       folks_alias_details_get_alias (FOLKS_ALIAS_DETAILS (individual)),
+      EMPATHY_INDIVIDUAL_STORE_COL_SORT_KEY,
+      g_hash_table_lookup (priv->sort_keys, individual),
       EMPATHY_INDIVIDUAL_STORE_COL_INDIVIDUAL, individual,
       EMPATHY_INDIVIDUAL_STORE_COL_IS_GROUP, FALSE,
       EMPATHY_INDIVIDUAL_STORE_COL_IS_SEPARATOR, FALSE,
       EMPATHY_INDIVIDUAL_STORE_COL_CAN_AUDIO_CALL, can_audio_call,
       EMPATHY_INDIVIDUAL_STORE_COL_CAN_VIDEO_CALL, can_video_call,
       EMPATHY_INDIVIDUAL_STORE_COL_CLIENT_TYPES, types,
+      EMPATHY_INDIVIDUAL_STORE_COL_FLAGS, individual_get_flags (individual,
+          FALSE),
       -1);
 
   queue = g_hash_table_lookup (priv->folks_individual_cache, individual);
@@ -380,6 +534,8 @@ individual_store_remove_individual (EmpathyIndividualStore *self,
     }
 
   g_hash_table_remove (priv->folks_individual_cache, individual);
+  g_hash_table_remove (priv->sort_keys, individual);
+  g_hash_table_remove (priv->avatars_wanted, individual);
 }
 
 static void
@@ -396,6 +552,8 @@ individual_store_add_individual (EmpathyIndividualStore *self,
           FOLKS_ALIAS_DETAILS (individual))))
     return;
 
+  individual_store_update_sort_key (self, individual);
+
   if (priv->show_groups)
     {
       GeeSet *group_set = NULL;
@@ -607,6 +765,24 @@ typedef struct {
   GCancellable *cancellable; /* owned */
 } LoadAvatarData;
 
+static void
+individual_store_set_avatar (EmpathyIndividualStore *self,
+    FolksIndividual *individual,
+    GdkPixbuf *pixbuf)
+{
+  GList *iters, *l;
+
+  iters = individual_store_find_contact (self, individual);
+  for (l = iters; l; l = l->next)
+    {
+      gtk_tree_store_set (GTK_TREE_STORE (self), l->data,
+          EMPATHY_INDIVIDUAL_STORE_COL_PIXBUF_AVATAR, pixbuf,
+          -1);
+    }
+
+  free_iters (iters);
+}
+
 static void
 individual_avatar_pixbuf_received_cb (FolksIndividual *individual,
     GAsyncResult *result,
@@ -627,17 +803,7 @@ individual_avatar_pixbuf_received_cb (FolksIndividual *individual,
     }
   else if (data->store != NULL)
     {
-      GList *iters, *l;
-
-      iters = individual_store_find_contact (data->store, individual);
-      for (l = iters; l; l = l->next)
-        {
-          gtk_tree_store_set (GTK_TREE_STORE (data->store), l->data,
-              EMPATHY_INDIVIDUAL_STORE_COL_PIXBUF_AVATAR, pixbuf,
-              -1);
-        }
-
-      free_iters (iters);
+      individual_store_set_avatar (data->store, individual, pixbuf);
     }
 
   /* Free things */
@@ -649,6 +815,9 @@ individual_avatar_pixbuf_received_cb (FolksIndividual *individual,
           (gpointer *) &data->store);
       priv->avatar_cancellables = g_list_remove (priv->avatar_cancellables,
           data->cancellable);
+
+      priv->avatar_loads_running--;
+      individual_store_schedule_avatar_loads (data->store);
     }
 
   tp_clear_object (&pixbuf);
@@ -656,6 +825,93 @@ individual_avatar_pixbuf_received_cb (FolksIndividual *individual,
   g_slice_free (LoadAvatarData, data);
 }
 
+static void
+individual_store_load_avatar (EmpathyIndividualStore *self,
+    FolksIndividual *individual)
+{
+  EmpathyIndividualStorePriv *priv = GET_PRIV (self);
+  LoadAvatarData *load_avatar_data;
+  GdkPixbuf *pixbuf;
+
+  /* Another view may already have decoded it at this size */
+  pixbuf = empathy_pixbuf_avatar_from_individual_scaled_cached (individual,
+      32, 32);
+  if (pixbuf != NULL)
+    {
+      individual_store_set_avatar (self, individual, pixbuf);
+      g_object_unref (pixbuf);
+      return;
+    }
+
+  load_avatar_data = g_slice_new (LoadAvatarData);
+  load_avatar_data->store = self;
+  g_object_add_weak_pointer (G_OBJECT (self),
+      (gpointer *) &load_avatar_data->store);
+  load_avatar_data->cancellable = g_cancellable_new ();
+
+  priv->avatar_cancellables = g_list_prepend (priv->avatar_cancellables,
+      load_avatar_data->cancellable);
+  priv->avatar_loads_running++;
+  empathy_pixbuf_avatar_from_individual_scaled_async (individual, 32, 32,
+      load_avatar_data->cancellable,
+      (GAsyncReadyCallback) individual_avatar_pixbuf_received_cb,
+      load_avatar_data);
+}
+
+static gboolean
+individual_store_load_avatars_cb (gpointer user_data)
+{
+  EmpathyIndividualStore *self = user_data;
+  EmpathyIndividualStorePriv *priv = GET_PRIV (self);
+
+  priv->avatar_idle_id = 0;
+
+  while (priv->avatar_loads_running < AVATAR_LOADS_MAX &&
+      !g_queue_is_empty (priv->avatar_queue))
+    {
+      FolksIndividual *individual = g_queue_pop_head (priv->avatar_queue);
+
+      g_hash_table_remove (priv->avatar_queued, individual);
+      individual_store_load_avatar (self, individual);
+      g_object_unref (individual);
+    }
+
+  return FALSE;
+}
+
+/* Avatars are loaded from an idle, a few at a time, so that they don't get
+ * in the way of displaying the roster. */
+static void
+individual_store_schedule_avatar_loads (EmpathyIndividualStore *self)
+{
+  EmpathyIndividualStorePriv *priv = GET_PRIV (self);
+
+  if (priv->dispose_has_run || priv->bulk_count > 0 ||
+      priv->avatar_idle_id != 0 ||
+      priv->avatar_loads_running >= AVATAR_LOADS_MAX ||
+      g_queue_is_empty (priv->avatar_queue))
+    return;
+
+  priv->avatar_idle_id = g_idle_add_full (G_PRIORITY_LOW,
+      individual_store_load_avatars_cb, self, NULL);
+}
+
+static void
+individual_store_queue_avatar (EmpathyIndividualStore *self,
+    FolksIndividual *individual)
+{
+  EmpathyIndividualStorePriv *priv = GET_PRIV (self);
+
+  /* Updates coming while it is waiting don't need another load */
+  if (g_hash_table_lookup (priv->avatar_queued, individual) != NULL)
+    return;
+
+  g_queue_push_tail (priv->avatar_queue, g_object_ref (individual));
+  g_hash_table_insert (priv->avatar_queued, individual, individual);
+
+  individual_store_schedule_avatar_loads (self);
+}
+
 static void
 individual_store_contact_update (EmpathyIndividualStore *self,
     FolksIndividual *individual)
@@ -672,8 +928,8 @@ individual_store_contact_update (EmpathyIndividualStore *self,
   gboolean do_set_active = FALSE;
   gboolean do_set_refresh = FALSE;
   gboolean show_avatar = FALSE;
+  guint flags = 0;
   GdkPixbuf *pixbuf_status;
-  LoadAvatarData *load_avatar_data;
 
   priv = GET_PRIV (self);
 
@@ -748,23 +1004,15 @@ individual_store_contact_update (EmpathyIndividualStore *self,
       show_avatar = TRUE;
     }
 
-  /* Load the avatar asynchronously */
-  load_avatar_data = g_slice_new (LoadAvatarData);
-  load_avatar_data->store = self;
-  g_object_add_weak_pointer (G_OBJECT (self),
-      (gpointer *) &load_avatar_data->store);
-  load_avatar_data->cancellable = g_cancellable_new ();
-
-  priv->avatar_cancellables = g_list_prepend (priv->avatar_cancellables,
-      load_avatar_data->cancellable);
-  empathy_pixbuf_avatar_from_individual_scaled_async (individual, 32, 32,
-      load_avatar_data->cancellable,
-      (GAsyncReadyCallback) individual_avatar_pixbuf_received_cb,
-      load_avatar_data);
-
   pixbuf_status =
       empathy_individual_store_get_individual_status_icon (self, individual);
 
+  if (set_model)
+    {
+      individual_store_update_sort_key (self, individual);
+      flags = individual_get_flags (individual, now_online);
+    }
+
   for (l = iters; l && set_model; l = l->next)
     {
       gboolean can_audio_call, can_video_call;
@@ -793,6 +1041,7 @@ individual_store_contact_update (EmpathyIndividualStore *self,
           EMPATHY_INDIVIDUAL_STORE_COL_CAN_AUDIO_CALL, can_audio_call,
           EMPATHY_INDIVIDUAL_STORE_COL_CAN_VIDEO_CALL, can_video_call,
           EMPATHY_INDIVIDUAL_STORE_COL_CLIENT_TYPES, types,
+          EMPATHY_INDIVIDUAL_STORE_COL_FLAGS, flags,
           -1);
     }
 
@@ -819,15 +1068,70 @@ individual_store_contact_update (EmpathyIndividualStore *self,
   free_iters (iters);
 }
 
+static gboolean
+individual_store_updates_idle_cb (gpointer user_data)
+{
+  EmpathyIndividualStore *self = user_data;
+  EmpathyIndividualStorePriv *priv = GET_PRIV (self);
+  GList *individuals, *l;
+  gboolean bulk;
+
+  priv->updates_idle_id = 0;
+
+  individuals = g_hash_table_get_keys (priv->updates_pending);
+  g_hash_table_remove_all (priv->updates_pending);
+
+  DEBUG ("Updating %u individuals", g_list_length (individuals));
+
+  /* A presence storm moves most rows around: sort once at the end rather
+   * than once per row */
+  bulk = g_list_nth (individuals, BULK_INSERT_MIN_INDIVIDUALS) != NULL;
+  if (bulk)
+    individual_store_begin_bulk (self);
+
+  for (l = individuals; l != NULL; l = l->next)
+    individual_store_contact_update (self, l->data);
+
+  if (bulk)
+    individual_store_end_bulk (self);
+
+  g_list_free (individuals);
+
+  return FALSE;
+}
+
+/* Rows are refreshed from an idle so that the updates arriving in the same
+ * main loop iteration (typically all the presences of an account which just
+ * reconnected) are applied as one batch, each individual only once. */
+static void
+individual_store_queue_update (EmpathyIndividualStore *self,
+    FolksIndividual *individual)
+{
+  EmpathyIndividualStorePriv *priv = GET_PRIV (self);
+
+  g_hash_table_insert (priv->updates_pending, individual, individual);
+
+  if (priv->updates_idle_id == 0)
+    priv->updates_idle_id = g_idle_add (individual_store_updates_idle_cb,
+        self);
+}
+
 static void
 individual_store_individual_updated_cb (FolksIndividual *individual,
     GParamSpec *param,
     EmpathyIndividualStore *self)
 {
+  EmpathyIndividualStorePriv *priv = GET_PRIV (self);
+
   DEBUG ("Individual'%s' updated, checking roster is in sync...",
       folks_alias_details_get_alias (FOLKS_ALIAS_DETAILS (individual)));
 
-  individual_store_contact_update (self, individual);
+  individual_store_queue_update (self, individual);
+
+  /* Load the new avatar, if the old one was displayed */
+  if (!tp_strdiff (param->name, "avatar") &&
+      g_hash_table_lookup (priv->avatars_wanted, individual) != NULL)
+    individual_store_queue_avatar (self, individual);
 }
 
 static void
@@ -844,7 +1148,36 @@ individual_store_contact_updated_cb (EmpathyContact *contact,
   if (individual == NULL)
     return;
 
-  individual_store_contact_update (self, individual);
+  individual_store_queue_update (self, individual);
+}
+
+/* Refresh the flags of the individual's rows, if it has any */
+static void
+individual_store_update_flags (EmpathyIndividualStore *self,
+    FolksIndividual *individual)
+{
+  EmpathyIndividualStorePriv *priv = GET_PRIV (self);
+  GQueue *queue;
+  GList *l;
+  gboolean is_online;
+  guint flags;
+
+  queue = g_hash_table_lookup (priv->folks_individual_cache, individual);
+  if (queue == NULL)
+    return;
+
+  gtk_tree_model_get (GTK_TREE_MODEL (self), g_queue_peek_head (queue),
+      EMPATHY_INDIVIDUAL_STORE_COL_IS_ONLINE, &is_online,
+      -1);
+
+  flags = individual_get_flags (individual, is_online);
+
+  for (l = g_queue_peek_head_link (queue); l != NULL; l = l->next)
+    {
+      gtk_tree_store_set (GTK_TREE_STORE (self), l->data,
+          EMPATHY_INDIVIDUAL_STORE_COL_FLAGS, flags,
+          -1);
+    }
 }
 
 static void
@@ -853,6 +1186,7 @@ individual_personas_changed_cb (FolksIndividual *individual,
     GeeSet *removed,
     EmpathyIndividualStore *self)
 {
+  EmpathyIndividualStorePriv *priv = GET_PRIV (self);
   GeeIterator *iter;
 
   DEBUG ("Individual '%s' personas-changed.",
@@ -876,6 +1210,9 @@ individual_personas_changed_cb (FolksIndividual *individual,
               empathy_contact_set_persona (contact, FOLKS_PERSONA (persona));
 
               g_object_set_data (G_OBJECT (contact), "individual", NULL);
+              if (g_hash_table_lookup (priv->empathy_contact_cache,
+                      contact) == individual)
+                g_hash_table_remove (priv->empathy_contact_cache, contact);
               g_signal_handlers_disconnect_by_func (contact,
                   (GCallback) individual_store_contact_updated_cb, self);
 
@@ -903,6 +1240,8 @@ individual_personas_changed_cb (FolksIndividual *individual,
               empathy_contact_set_persona (contact, FOLKS_PERSONA (persona));
 
               g_object_set_data (G_OBJECT (contact), "individual", individual);
+              g_hash_table_replace (priv->empathy_contact_cache,
+                  g_object_ref (contact), individual);
               g_signal_connect (contact, "notify::capabilities",
                   (GCallback) individual_store_contact_updated_cb, self);
               g_signal_connect (contact, "notify::client-types",
@@ -915,6 +1254,20 @@ individual_personas_changed_cb (FolksIndividual *individual,
       g_clear_object (&persona);
     }
   g_clear_object (&iter);
+
+  individual_store_update_flags (self, individual);
+}
+
+static void
+individual_store_trust_level_changed_cb (FolksIndividual *individual,
+    GParamSpec *param,
+    EmpathyIndividualStore *self)
+{
+  DEBUG ("Individual '%s' trust level changed",
+      folks_individual_get_id (individual));
+
+  /* The UNTRUSTED flag is cached in the rows */
+  individual_store_update_flags (self, individual);
 }
 
 static void
@@ -951,6 +1304,8 @@ individual_store_add_individual_and_connect (EmpathyIndividualStore *self,
       (GCallback) individual_personas_changed_cb, self);
   g_signal_connect (individual, "notify::is-favourite",
       (GCallback) individual_store_favourites_changed_cb, self);
+  g_signal_connect (individual, "notify::trust-level",
+      (GCallback) individual_store_trust_level_changed_cb, self);
 
   /* provide an empty set so the callback can assume non-NULL sets */
   individual_personas_changed_cb (individual,
@@ -962,6 +1317,7 @@ static void
 individual_store_disconnect_individual (EmpathyIndividualStore *self,
     FolksIndividual *individual)
 {
+  EmpathyIndividualStorePriv *priv = GET_PRIV (self);
   GeeSet *empty_set = gee_set_empty (G_TYPE_NONE, NULL, NULL);
 
   /* provide an empty set so the callback can assume non-NULL sets */
@@ -975,6 +1331,10 @@ individual_store_disconnect_individual (EmpathyIndividualStore *self,
       (GCallback) individual_personas_changed_cb, self);
   g_signal_handlers_disconnect_by_func (individual,
       (GCallback) individual_store_favourites_changed_cb, self);
+  g_signal_handlers_disconnect_by_func (individual,
+      (GCallback) individual_store_trust_level_changed_cb, self);
+
+  g_hash_table_remove (priv->updates_pending, individual);
 }
 
 void
@@ -986,6 +1346,60 @@ individual_store_remove_individual_and_disconnect (
   individual_store_remove_individual (self, individual);
 }
 
+static void
+individual_store_apply_sort_criterium (EmpathyIndividualStore *self)
+{
+  EmpathyIndividualStorePriv *priv = GET_PRIV (self);
+
+  switch (priv->sort_criterium)
+    {
+    case EMPATHY_INDIVIDUAL_STORE_SORT_STATE:
+      gtk_tree_sortable_set_sort_column_id (GTK_TREE_SORTABLE (self),
+          EMPATHY_INDIVIDUAL_STORE_COL_STATUS, GTK_SORT_ASCENDING);
+      break;
+
+    case EMPATHY_INDIVIDUAL_STORE_SORT_NAME:
+      gtk_tree_sortable_set_sort_column_id (GTK_TREE_SORTABLE (self),
+          EMPATHY_INDIVIDUAL_STORE_COL_NAME, GTK_SORT_ASCENDING);
+      break;
+
+    default:
+      g_assert_not_reached ();
+    }
+}
+
+/* Bulk mode, for adding many individuals at once (the whole roster at
+ * startup). Each row inserted in a sorted store is compared with its
+ * siblings, so rows are inserted unsorted and the store is sorted once at
+ * the end; avatars are only loaded after that. */
+static void
+individual_store_begin_bulk (EmpathyIndividualStore *self)
+{
+  EmpathyIndividualStorePriv *priv = GET_PRIV (self);
+
+  if (priv->bulk_count++ > 0)
+    return;
+
+  gtk_tree_sortable_set_sort_column_id (GTK_TREE_SORTABLE (self),
+      GTK_TREE_SORTABLE_UNSORTED_SORT_COLUMN_ID, GTK_SORT_ASCENDING);
+}
+
+static void
+individual_store_end_bulk (EmpathyIndividualStore *self)
+{
+  EmpathyIndividualStorePriv *priv = GET_PRIV (self);
+
+  g_return_if_fail (priv->bulk_count > 0);
+
+  if (--priv->bulk_count > 0)
+    return;
+
+  /* Sorts the whole store */
+  individual_store_apply_sort_criterium (self);
+
+  individual_store_schedule_avatar_loads (self);
+}
+
 static void
 individual_store_members_changed_cb (EmpathyIndividualManager *manager,
     const gchar *message,
@@ -995,6 +1409,11 @@ individual_store_members_changed_cb (EmpathyIndividualManager *manager,
     EmpathyIndividualStore *self)
 {
   GList *l;
+  gboolean bulk;
+
+  bulk = g_list_nth (added, BULK_INSERT_MIN_INDIVIDUALS) != NULL;
+  if (bulk)
+    individual_store_begin_bulk (self);
 
   for (l = added; l; l = l->next)
     {
@@ -1009,6 +1428,9 @@ individual_store_members_changed_cb (EmpathyIndividualManager *manager,
 
       individual_store_remove_individual_and_disconnect (self, l->data);
     }
+
+  if (bulk)
+    individual_store_end_bulk (self);
 }
 
 static void
@@ -1061,8 +1483,10 @@ individual_store_manager_setup (gpointer user_data)
   individuals = empathy_individual_manager_get_members (priv->manager);
   if (individuals != NULL && FOLKS_IS_INDIVIDUAL (individuals->data))
     {
+      individual_store_begin_bulk (self);
       individual_store_members_changed_cb (priv->manager, "initial add",
           individuals, NULL, 0, self);
+      individual_store_end_bulk (self);
       g_list_free (individuals);
     }
 
@@ -1119,6 +1543,18 @@ individual_store_dispose (GObject *object)
     }
   g_list_free (priv->avatar_cancellables);
 
+  if (priv->avatar_idle_id != 0)
+    {
+      g_source_remove (priv->avatar_idle_id);
+      priv->avatar_idle_id = 0;
+    }
+
+  g_queue_foreach (priv->avatar_queue, (GFunc) g_object_unref, NULL);
+  g_queue_free (priv->avatar_queue);
+  priv->avatar_queue = NULL;
+  g_hash_table_destroy (priv->avatar_queued);
+  g_hash_table_destroy (priv->avatars_wanted);
+
   individuals = empathy_individual_manager_get_members (priv->manager);
   for (l = individuals; l; l = l->next)
     {
@@ -1127,6 +1563,13 @@ individual_store_dispose (GObject *object)
     }
   g_list_free (individuals);
 
+  if (priv->updates_idle_id != 0)
+    {
+      g_source_remove (priv->updates_idle_id);
+      priv->updates_idle_id = 0;
+    }
+  g_hash_table_destroy (priv->updates_pending);
+
   g_signal_handlers_disconnect_by_func (priv->manager,
       G_CALLBACK (individual_store_member_renamed_cb), object);
   g_signal_handlers_disconnect_by_func (priv->manager,
@@ -1148,6 +1591,8 @@ individual_store_dispose (GObject *object)
   g_hash_table_destroy (priv->status_icons);
   g_hash_table_destroy (priv->folks_individual_cache);
   g_hash_table_destroy (priv->empathy_group_cache);
+  g_hash_table_destroy (priv->empathy_contact_cache);
+  g_hash_table_destroy (priv->sort_keys);
   G_OBJECT_CLASS (empathy_individual_store_parent_class)->dispose (object);
 }
 
@@ -1377,72 +1822,45 @@ compare_separator_and_groups (gboolean is_separator_a,
 }
 
 static gint
-individual_store_contact_sort (FolksIndividual *individual_a,
-    FolksIndividual *individual_b)
+individual_store_contact_sort (const IndividualSortKey *key_a,
+    const IndividualSortKey *key_b)
 {
   gint ret_val;
-  EmpathyContact *contact_a = NULL, *contact_b = NULL;
-  TpAccount *account_a, *account_b;
-
-  g_return_val_if_fail (individual_a != NULL || individual_b != NULL, 0);
 
   /* alias */
-  ret_val = g_utf8_collate (
-      folks_alias_details_get_alias (FOLKS_ALIAS_DETAILS (individual_a)),
-      folks_alias_details_get_alias (FOLKS_ALIAS_DETAILS (individual_b)));
-
+  ret_val = strcmp (key_a->alias_key, key_b->alias_key);
   if (ret_val != 0)
-    goto out;
+    return ret_val;
 
-  contact_a = empathy_contact_dup_from_folks_individual (individual_a);
-  contact_b = empathy_contact_dup_from_folks_individual (individual_b);
-  if (contact_a != NULL && contact_b != NULL)
+  if (key_a->has_contact && key_b->has_contact)
     {
-      account_a = empathy_contact_get_account (contact_a);
-      account_b = empathy_contact_get_account (contact_b);
-
-      g_assert (account_a != NULL);
-      g_assert (account_b != NULL);
-
       /* protocol */
-      ret_val = g_strcmp0 (tp_account_get_protocol (account_a),
-          tp_account_get_protocol (account_b));
-
+      ret_val = g_strcmp0 (key_a->protocol, key_b->protocol);
       if (ret_val != 0)
-        goto out;
+        return ret_val;
 
       /* account ID */
-      ret_val = g_strcmp0 (tp_proxy_get_object_path (account_a),
-          tp_proxy_get_object_path (account_b));
-
+      ret_val = g_strcmp0 (key_a->account_path, key_b->account_path);
       if (ret_val != 0)
-        goto out;
+        return ret_val;
     }
 
   /* identifier */
-  ret_val = g_utf8_collate (folks_individual_get_id (individual_a),
-      folks_individual_get_id (individual_b));
-
-out:
-  tp_clear_object (&contact_a);
-  tp_clear_object (&contact_b);
-
-  return ret_val;
+  return strcmp (key_a->id_key, key_b->id_key);
 }
 
+/* Groups and separators are compared with compare_separator_and_groups(),
+ * which has the last word if one of the rows isn't an individual. */
 static gint
-individual_store_state_sort_func (GtkTreeModel *model,
+individual_store_compare_non_individuals (GtkTreeModel *model,
     GtkTreeIter *iter_a,
-    GtkTreeIter *iter_b,
-    gpointer user_data)
+    GtkTreeIter *iter_b)
 {
   gint ret_val;
   FolksIndividual *individual_a, *individual_b;
   gchar *name_a, *name_b;
   gboolean is_separator_a, is_separator_b;
   gboolean fake_group_a, fake_group_b;
-  FolksPresenceType folks_presence_type_a, folks_presence_type_b;
-  TpConnectionPresenceType tp_presence_a, tp_presence_b;
 
   gtk_tree_model_get (model, iter_a,
       EMPATHY_INDIVIDUAL_STORE_COL_NAME, &name_a,
@@ -1455,41 +1873,47 @@ individual_store_state_sort_func (GtkTreeModel *model,
       EMPATHY_INDIVIDUAL_STORE_COL_IS_SEPARATOR, &is_separator_b,
       EMPATHY_INDIVIDUAL_STORE_COL_IS_FAKE_GROUP, &fake_group_b, -1);
 
-  if (individual_a == NULL || individual_b == NULL)
-    {
-      ret_val = compare_separator_and_groups (is_separator_a, is_separator_b,
-          name_a, name_b, individual_a, individual_b, fake_group_a,
-          fake_group_b);
-      goto free_and_out;
-    }
+  ret_val = compare_separator_and_groups (is_separator_a, is_separator_b,
+      name_a, name_b, individual_a, individual_b, fake_group_a, fake_group_b);
+
+  tp_clear_object (&individual_a);
+  tp_clear_object (&individual_b);
+  g_free (name_a);
+  g_free (name_b);
+
+  return ret_val;
+}
+
+static gint
+individual_store_state_sort_func (GtkTreeModel *model,
+    GtkTreeIter *iter_a,
+    GtkTreeIter *iter_b,
+    gpointer user_data)
+{
+  IndividualSortKey *key_a, *key_b;
+  gint ret_val;
+
+  gtk_tree_model_get (model, iter_a,
+      EMPATHY_INDIVIDUAL_STORE_COL_SORT_KEY, &key_a, -1);
+  gtk_tree_model_get (model, iter_b,
+      EMPATHY_INDIVIDUAL_STORE_COL_SORT_KEY, &key_b, -1);
+
+  /* Only individuals have a sort key */
+  if (key_a == NULL || key_b == NULL)
+    return individual_store_compare_non_individuals (model, iter_a, iter_b);
 
   /* If we managed to get this far, we can start looking at
    * the presences.
    */
-  folks_presence_type_a =
-      folks_presence_details_get_presence_type (
-          FOLKS_PRESENCE_DETAILS (individual_a));
-  folks_presence_type_b =
-      folks_presence_details_get_presence_type (
-          FOLKS_PRESENCE_DETAILS (individual_b));
-  tp_presence_a = empathy_folks_presence_type_to_tp (folks_presence_type_a);
-  tp_presence_b = empathy_folks_presence_type_to_tp (folks_presence_type_b);
-
-  ret_val = -tp_connection_presence_type_cmp_availability (tp_presence_a,
-      tp_presence_b);
+  ret_val = -tp_connection_presence_type_cmp_availability (key_a->presence,
+      key_b->presence);
 
   if (ret_val == 0)
     {
       /* Fallback: compare by name et al. */
-      ret_val = individual_store_contact_sort (individual_a, individual_b);
+      ret_val = individual_store_contact_sort (key_a, key_b);
     }
 
-free_and_out:
-  g_free (name_a);
-  g_free (name_b);
-  tp_clear_object (&individual_a);
-  tp_clear_object (&individual_b);
-
   return ret_val;
 }
 
@@ -1499,35 +1923,18 @@ individual_store_name_sort_func (GtkTreeModel *model,
     GtkTreeIter *iter_b,
     gpointer user_data)
 {
-  gchar *name_a, *name_b;
-  FolksIndividual *individual_a, *individual_b;
-  gboolean is_separator_a = FALSE, is_separator_b = FALSE;
-  gint ret_val;
-  gboolean fake_group_a, fake_group_b;
+  IndividualSortKey *key_a, *key_b;
 
   gtk_tree_model_get (model, iter_a,
-      EMPATHY_INDIVIDUAL_STORE_COL_NAME, &name_a,
-      EMPATHY_INDIVIDUAL_STORE_COL_INDIVIDUAL, &individual_a,
-      EMPATHY_INDIVIDUAL_STORE_COL_IS_SEPARATOR, &is_separator_a,
-      EMPATHY_INDIVIDUAL_STORE_COL_IS_FAKE_GROUP, &fake_group_a, -1);
+      EMPATHY_INDIVIDUAL_STORE_COL_SORT_KEY, &key_a, -1);
   gtk_tree_model_get (model, iter_b,
-      EMPATHY_INDIVIDUAL_STORE_COL_NAME, &name_b,
-      EMPATHY_INDIVIDUAL_STORE_COL_INDIVIDUAL, &individual_b,
-      EMPATHY_INDIVIDUAL_STORE_COL_IS_SEPARATOR, &is_separator_b,
-      EMPATHY_INDIVIDUAL_STORE_COL_IS_FAKE_GROUP, &fake_group_b, -1);
+      EMPATHY_INDIVIDUAL_STORE_COL_SORT_KEY, &key_b, -1);
 
-  if (individual_a == NULL || individual_b == NULL)
-    ret_val = compare_separator_and_groups (is_separator_a, is_separator_b,
-        name_a, name_b, individual_a, individual_b, fake_group_a, fake_group_b);
-  else
-    ret_val = individual_store_contact_sort (individual_a, individual_b);
-
-  tp_clear_object (&individual_a);
-  tp_clear_object (&individual_b);
-  g_free (name_a);
-  g_free (name_b);
+  /* Only individuals have a sort key */
+  if (key_a == NULL || key_b == NULL)
+    return individual_store_compare_non_individuals (model, iter_a, iter_b);
 
-  return ret_val;
+  return individual_store_contact_sort (key_a, key_b);
 }
 
 static void
@@ -1552,6 +1959,8 @@ individual_store_setup (EmpathyIndividualStore *self)
     G_TYPE_BOOLEAN,             /* Is a fake group */
     G_TYPE_STRV,                /* Client types */
     G_TYPE_UINT,                /* Event count */
+    G_TYPE_UINT,                /* Flags */
+    G_TYPE_POINTER,             /* Sort key */
   };
 
   priv = GET_PRIV (self);
@@ -1611,6 +2020,14 @@ empathy_individual_store_init (EmpathyIndividualStore *self)
       g_queue_free_full_iter);
   priv->empathy_group_cache = g_hash_table_new_full (g_str_hash,
       g_str_equal, g_free, (GDestroyNotify) gtk_tree_iter_free);
+  priv->empathy_contact_cache = g_hash_table_new_full (NULL, NULL,
+      g_object_unref, NULL);
+  priv->avatar_queue = g_queue_new ();
+  priv->sort_keys = g_hash_table_new_full (NULL, NULL, NULL,
+      (GDestroyNotify) individual_sort_key_free);
+  priv->avatar_queued = g_hash_table_new (NULL, NULL);
+  priv->avatars_wanted = g_hash_table_new (NULL, NULL);
+  priv->updates_pending = g_hash_table_new (NULL, NULL);
   individual_store_setup (self);
 }
 
@@ -1788,9 +2205,11 @@ empathy_individual_store_set_show_groups (EmpathyIndividualStore *self,
 
       contacts = empathy_individual_manager_get_members (priv->manager);
 
+      individual_store_begin_bulk (self);
       individual_store_members_changed_cb (priv->manager,
           "re-adding members: toggled group visibility",
           contacts, NULL, 0, self);
+      individual_store_end_bulk (self);
       g_list_free (contacts);
     }
 
@@ -1855,21 +2274,9 @@ empathy_individual_store_set_sort_criterium (EmpathyIndividualStore *self,
 
   priv->sort_criterium = sort_criterium;
 
-  switch (sort_criterium)
-    {
-    case EMPATHY_INDIVIDUAL_STORE_SORT_STATE:
-      gtk_tree_sortable_set_sort_column_id (GTK_TREE_SORTABLE (self),
-          EMPATHY_INDIVIDUAL_STORE_COL_STATUS, GTK_SORT_ASCENDING);
-      break;
-
-    case EMPATHY_INDIVIDUAL_STORE_SORT_NAME:
-      gtk_tree_sortable_set_sort_column_id (GTK_TREE_SORTABLE (self),
-          EMPATHY_INDIVIDUAL_STORE_COL_NAME, GTK_SORT_ASCENDING);
-      break;
-
-    default:
-      g_assert_not_reached ();
-    }
+  /* Will be applied by individual_store_end_bulk() */
+  if (priv->bulk_count == 0)
+    individual_store_apply_sort_criterium (self);
 
   g_object_notify (G_OBJECT (self), "sort-criterium");
 }
@@ -2047,3 +2454,61 @@ empathy_individual_store_get_individual_status_icon (
 
   return pixbuf_status;
 }
+
+/**
+ * empathy_individual_store_find_contact:
+ * @self: an #EmpathyIndividualStore
+ * @contact: an #EmpathyContact
+ *
+ * Finds the rows of the individual @contact is a persona of, without
+ * walking the whole store.
+ *
+ * Return value: a list of #GtkTreeIter, to be freed with
+ * gtk_tree_iter_free() and g_list_free()
+ */
+GList *
+empathy_individual_store_find_contact (EmpathyIndividualStore *self,
+    EmpathyContact *contact)
+{
+  EmpathyIndividualStorePriv *priv;
+  FolksIndividual *individual;
+
+  g_return_val_if_fail (EMPATHY_IS_INDIVIDUAL_STORE (self), NULL);
+  g_return_val_if_fail (EMPATHY_IS_CONTACT (contact), NULL);
+
+  priv = GET_PRIV (self);
+
+  individual = g_hash_table_lookup (priv->empathy_contact_cache, contact);
+  if (individual == NULL)
+    return NULL;
+
+  return individual_store_find_contact (self, individual);
+}
+
+/**
+ * empathy_individual_store_load_avatar:
+ * @self: an #EmpathyIndividualStore
+ * @individual: a #FolksIndividual of @self
+ *
+ * Asks for the avatar of @individual to be loaded in its rows, and reloaded
+ * when it changes. Avatars aren't loaded otherwise: views call this when they
+ * display a row, so the avatars of hidden rows are neither decoded nor kept.
+ */
+void
+empathy_individual_store_load_avatar (EmpathyIndividualStore *self,
+    FolksIndividual *individual)
+{
+  EmpathyIndividualStorePriv *priv;
+
+  g_return_if_fail (EMPATHY_IS_INDIVIDUAL_STORE (self));
+  g_return_if_fail (FOLKS_IS_INDIVIDUAL (individual));
+
+  priv = GET_PRIV (self);
+
+  if (g_hash_table_lookup (priv->avatars_wanted, individual) != NULL ||
+      g_hash_table_lookup (priv->folks_individual_cache, individual) == NULL)
+    return;
+
+  g_hash_table_insert (priv->avatars_wanted, individual, individual);
+  individual_store_queue_avatar (self, individual);
+}
@@ -66,9 +66,23 @@ typedef enum
   EMPATHY_INDIVIDUAL_STORE_COL_IS_FAKE_GROUP,
   EMPATHY_INDIVIDUAL_STORE_COL_CLIENT_TYPES,
   EMPATHY_INDIVIDUAL_STORE_COL_EVENT_COUNT,
+  EMPATHY_INDIVIDUAL_STORE_COL_FLAGS,
+  /* private: what the sort functions compare */
+  EMPATHY_INDIVIDUAL_STORE_COL_SORT_KEY,
   EMPATHY_INDIVIDUAL_STORE_COL_COUNT,
 } EmpathyIndividualStoreCol;
 
+/* What EMPATHY_INDIVIDUAL_STORE_COL_FLAGS caches about the individual of a
+ * row; updated when its personas or its presence change */
+typedef enum
+{
+  EMPATHY_INDIVIDUAL_STORE_FLAG_INTERESTING = 1 << 0, /* has an interesting
+                                                         persona */
+  EMPATHY_INDIVIDUAL_STORE_FLAG_UNTRUSTED = 1 << 1,
+  EMPATHY_INDIVIDUAL_STORE_FLAG_FAVOURITE = 1 << 2,
+  EMPATHY_INDIVIDUAL_STORE_FLAG_ONLINE = 1 << 3,
+} EmpathyIndividualStoreFlags;
+
 #define EMPATHY_INDIVIDUAL_STORE_UNGROUPED _("Ungrouped")
 #define EMPATHY_INDIVIDUAL_STORE_FAVORITE  _("Favorite People")
 #define EMPATHY_INDIVIDUAL_STORE_PEOPLE_NEARBY _("People Nearby")
@@ -138,6 +152,12 @@ GdkPixbuf *empathy_individual_store_get_individual_status_icon (
     EmpathyIndividualStore *store,
     FolksIndividual *individual);
 
+GList *empathy_individual_store_find_contact (EmpathyIndividualStore *self,
+    EmpathyContact *contact);
+
+void empathy_individual_store_load_avatar (EmpathyIndividualStore *self,
+    FolksIndividual *individual);
+
 void individual_store_add_individual_and_connect (EmpathyIndividualStore *self,
     FolksIndividual *individual);
 
@@ -45,6 +45,7 @@
 
 #include "empathy-individual-view.h"
 #include "empathy-individual-menu.h"
+#include "empathy-individual-search-index.h"
 #include "empathy-individual-store.h"
 #include "empathy-contact-dialogs.h"
 #include "empathy-individual-dialogs.h"
@@ -79,10 +80,30 @@ typedef struct
   GtkTreeModelFilter *filter;
   GtkWidget *search_widget;
 
+  /* Live search state, set up when a search starts so key strokes only have
+   * to look at the individuals which may match.
+   * search_index: the roster-wide index of the searchable strings, kept
+   *   for the lifetime of the view once a search started so it is not
+   *   built again for each search
+   * search_dirty: owned FolksIndividual -> NULL, the individuals whose row
+   *   changed or got added since search_matches was computed
+   * search_matches: owned FolksIndividual -> NULL, the individuals
+   *   matching search_text */
+  EmpathyIndividualSearchIndex *search_index;
+  GHashTable *search_dirty;
+  GHashTable *search_matches;
+  gchar *search_text;
+
   guint expand_groups_idle_handler;
   /* owned string (group name) -> bool (whether to expand/contract) */
   GHashTable *expand_groups;
 
+  /* Group rows whose visibility has to be checked again, once per group
+   * however many of its children changed.
+   * GNode* of the group's row in the store -> owned GtkTreeRowReference */
+  GHashTable *verify_groups;
+  guint verify_groups_idle_id;
+
   /* Auto scroll */
   guint auto_scroll_timeout_id;
   /* Distance between mouse pointer and the nearby border. Negative when
@@ -1222,6 +1243,7 @@ individual_view_avatar_cell_data_func (GtkTreeViewColumn *tree_column,
     GtkTreeIter *iter,
     EmpathyIndividualView *view)
 {
+  EmpathyIndividualViewPriv *priv = GET_PRIV (view);
   GdkPixbuf *pixbuf;
   gboolean show_avatar;
   gboolean is_group;
@@ -1233,6 +1255,21 @@ individual_view_avatar_cell_data_func (GtkTreeViewColumn *tree_column,
       EMPATHY_INDIVIDUAL_STORE_COL_IS_GROUP, &is_group,
       EMPATHY_INDIVIDUAL_STORE_COL_IS_ACTIVE, &is_active, -1);
 
+  /* The store only loads the avatars of the rows being displayed */
+  if (pixbuf == NULL && !is_group && show_avatar && priv->store != NULL)
+    {
+      FolksIndividual *individual;
+
+      gtk_tree_model_get (model, iter,
+          EMPATHY_INDIVIDUAL_STORE_COL_INDIVIDUAL, &individual, -1);
+
+      if (individual != NULL)
+        {
+          empathy_individual_store_load_avatar (priv->store, individual);
+          g_object_unref (individual);
+        }
+    }
+
   g_object_set (cell,
       "visible", !is_group && show_avatar,
       "pixbuf", pixbuf,
@@ -1322,6 +1359,107 @@ individual_view_row_expand_or_collapse_cb (EmpathyIndividualView *view,
   g_free (name);
 }
 
+static void
+individual_view_search_index_clear (EmpathyIndividualView *self)
+{
+  EmpathyIndividualViewPriv *priv = GET_PRIV (self);
+
+  tp_clear_pointer (&priv->search_matches, g_hash_table_unref);
+  tp_clear_pointer (&priv->search_dirty, g_hash_table_unref);
+  tp_clear_pointer (&priv->search_text, g_free);
+}
+
+static void
+individual_view_search_update_matches (EmpathyIndividualView *self)
+{
+  EmpathyIndividualViewPriv *priv = GET_PRIV (self);
+  EmpathyLiveSearch *live = EMPATHY_LIVE_SEARCH (priv->search_widget);
+  const gchar *text;
+  GPtrArray *words;
+  GHashTable *candidates;
+  GHashTableIter iter;
+  gpointer individual;
+
+  text = empathy_live_search_get_text (live);
+  words = empathy_live_search_get_words (live);
+
+  if (words == NULL || priv->store == NULL)
+    {
+      /* Everybody matches, or there is nobody to match */
+      tp_clear_pointer (&priv->search_text, g_free);
+      return;
+    }
+
+  if (priv->search_index == NULL)
+    priv->search_index = empathy_individual_search_index_dup_singleton ();
+
+  if (priv->search_matches == NULL)
+    {
+      priv->search_dirty = g_hash_table_new_full (NULL, NULL,
+          g_object_unref, NULL);
+      priv->search_matches = g_hash_table_new_full (NULL, NULL,
+          g_object_unref, NULL);
+    }
+
+  if (priv->search_text != NULL && g_str_has_prefix (text, priv->search_text))
+    {
+      /* The text only grew, so whoever matches it matched the previous text
+       * as well */
+      candidates = priv->search_matches;
+      priv->search_matches = g_hash_table_new_full (NULL, NULL,
+          g_object_unref, NULL);
+    }
+  else
+    {
+      candidates = g_hash_table_new (NULL, NULL);
+      empathy_individual_search_index_lookup (priv->search_index, text, words,
+          candidates);
+      g_hash_table_remove_all (priv->search_matches);
+    }
+
+  /* The index may not know about the changes of those yet */
+  g_hash_table_iter_init (&iter, priv->search_dirty);
+  while (g_hash_table_iter_next (&iter, &individual, NULL))
+    g_hash_table_insert (candidates, individual, NULL);
+
+  g_hash_table_iter_init (&iter, candidates);
+  while (g_hash_table_iter_next (&iter, &individual, NULL))
+    {
+      if (empathy_individual_match_string (individual, text, words))
+        g_hash_table_insert (priv->search_matches, g_object_ref (individual),
+            NULL);
+    }
+
+  g_hash_table_unref (candidates);
+
+  /* They are all up to date in search_matches now */
+  g_hash_table_remove_all (priv->search_dirty);
+
+  g_free (priv->search_text);
+  priv->search_text = g_strdup (text);
+}
+
+static gboolean
+individual_view_search_match (EmpathyIndividualView *self,
+    FolksIndividual *individual)
+{
+  EmpathyIndividualViewPriv *priv = GET_PRIV (self);
+  EmpathyLiveSearch *live = EMPATHY_LIVE_SEARCH (priv->search_widget);
+  const gchar *text = empathy_live_search_get_text (live);
+
+  if (priv->search_text != NULL &&
+      !tp_strdiff (text, priv->search_text) &&
+      !g_hash_table_lookup_extended (priv->search_dirty, individual,
+          NULL, NULL))
+    {
+      return g_hash_table_lookup_extended (priv->search_matches, individual,
+          NULL, NULL);
+    }
+
+  return empathy_individual_match_string (individual, text,
+      empathy_live_search_get_words (live));
+}
+
 static gboolean
 individual_view_start_search_cb (EmpathyIndividualView *view,
     gpointer data)
@@ -1348,6 +1486,7 @@ individual_view_search_text_notify_cb (EmpathyLiveSearch *search,
   GtkTreeIter iter;
   gboolean set_cursor = FALSE;
 
+  individual_view_search_update_matches (view);
   gtk_tree_model_filter_refilter (priv->filter);
 
   /* Set cursor on the first contact. If it is already set on a group,
@@ -1439,6 +1578,8 @@ individual_view_search_hide_cb (EmpathyLiveSearch *search,
   GtkTreeIter iter;
   gboolean valid = FALSE;
 
+  individual_view_search_index_clear (view);
+
   /* block expand or collapse handlers, they would write the
    * expand or collapsed setting to file otherwise */
   g_signal_handlers_block_by_func (view,
@@ -1641,6 +1782,43 @@ individual_view_row_has_child_toggled_cb (GtkTreeModel *model,
   g_free (name);
 }
 
+static gboolean
+individual_view_verify_groups_cb (gpointer user_data)
+{
+  EmpathyIndividualView *view = user_data;
+  EmpathyIndividualViewPriv *priv = GET_PRIV (view);
+  GtkTreeModel *model = GTK_TREE_MODEL (priv->store);
+  GHashTableIter iter;
+  gpointer value;
+  GList *refs = NULL, *l;
+
+  priv->verify_groups_idle_id = 0;
+
+  /* Showing a group makes the filter check its children, which queues the
+   * group again; steal the queued ones first */
+  g_hash_table_iter_init (&iter, priv->verify_groups);
+  while (g_hash_table_iter_next (&iter, NULL, &value))
+    refs = g_list_prepend (refs, value);
+  g_hash_table_steal_all (priv->verify_groups);
+
+  for (l = refs; l != NULL; l = l->next)
+    {
+      GtkTreePath *path = gtk_tree_row_reference_get_path (l->data);
+      GtkTreeIter group_iter;
+
+      /* This tells the filter to verify the visibility of that row, and
+       * show/hide it if necessary */
+      if (path != NULL && gtk_tree_model_get_iter (model, &group_iter, path))
+        gtk_tree_model_row_changed (model, path, &group_iter);
+
+      gtk_tree_path_free (path);
+      gtk_tree_row_reference_free (l->data);
+    }
+  g_list_free (refs);
+
+  return FALSE;
+}
+
 /* FIXME: This is a workaround for bgo#621076 */
 static void
 individual_view_verify_group_visibility (EmpathyIndividualView *view,
@@ -1657,6 +1835,8 @@ individual_view_verify_group_visibility (EmpathyIndividualView *view,
   /* A group row is visible if and only if at least one if its child is visible.
    * So when a row is inserted/deleted/changed in the base model, that could
    * modify the visibility of its parent in the filter model.
+   * Re-checking the group means looking at all its children, so it's only
+   * done once per group, from an idle running before the view is redrawn.
   */
 
   model = GTK_TREE_MODEL (priv->store);
@@ -1664,14 +1844,41 @@ individual_view_verify_group_visibility (EmpathyIndividualView *view,
   gtk_tree_path_up (parent_path);
   if (gtk_tree_model_get_iter (model, &parent_iter, parent_path))
     {
-      /* This tells the filter to verify the visibility of that row, and
-       * show/hide it if necessary */
-      gtk_tree_model_row_changed (GTK_TREE_MODEL (priv->store),
-              parent_path, &parent_iter);
+      GtkTreeRowReference *ref;
+
+      /* The rows of a GtkTreeStore keep their node while they exist; a
+       * reference which isn't valid any more was to a deleted row whose node
+       * got reused */
+      ref = g_hash_table_lookup (priv->verify_groups, parent_iter.user_data);
+      if (ref == NULL || !gtk_tree_row_reference_valid (ref))
+        {
+          g_hash_table_replace (priv->verify_groups, parent_iter.user_data,
+              gtk_tree_row_reference_new (model, parent_path));
+        }
+
+      if (priv->verify_groups_idle_id == 0)
+        {
+          priv->verify_groups_idle_id = g_idle_add_full (G_PRIORITY_HIGH_IDLE,
+              individual_view_verify_groups_cb, view, NULL);
+        }
     }
   gtk_tree_path_free (parent_path);
 }
 
+static void
+individual_view_verify_groups_clear (EmpathyIndividualView *view)
+{
+  EmpathyIndividualViewPriv *priv = GET_PRIV (view);
+
+  if (priv->verify_groups_idle_id != 0)
+    {
+      g_source_remove (priv->verify_groups_idle_id);
+      priv->verify_groups_idle_id = 0;
+    }
+
+  g_hash_table_remove_all (priv->verify_groups);
+}
+
 static void
 individual_view_store_row_changed_cb (GtkTreeModel *model,
   GtkTreePath *path,
@@ -1681,6 +1888,34 @@ individual_view_store_row_changed_cb (GtkTreeModel *model,
   individual_view_verify_group_visibility (view, path);
 }
 
+static void
+individual_view_store_row_changed_search_cb (GtkTreeModel *model,
+  GtkTreePath *path,
+  GtkTreeIter *iter,
+  EmpathyIndividualView *view)
+{
+  EmpathyIndividualViewPriv *priv = GET_PRIV (view);
+  FolksIndividual *individual;
+
+  if (priv->search_dirty == NULL)
+    return;
+
+  gtk_tree_model_get (model, iter,
+      EMPATHY_INDIVIDUAL_STORE_COL_INDIVIDUAL, &individual,
+      -1);
+
+  if (individual == NULL)
+    return;
+
+  /* Its alias or IDs may have changed, don't trust the search index for it
+   * any more */
+  if (g_hash_table_lookup_extended (priv->search_dirty, individual,
+          NULL, NULL))
+    g_object_unref (individual);
+  else
+    g_hash_table_insert (priv->search_dirty, individual, NULL);
+}
+
 static void
 individual_view_store_row_deleted_cb (GtkTreeModel *model,
   GtkTreePath *path,
@@ -1692,17 +1927,13 @@ individual_view_store_row_deleted_cb (GtkTreeModel *model,
 static gboolean
 individual_view_is_visible_individual (EmpathyIndividualView *self,
     FolksIndividual *individual,
-    gboolean is_online,
+    guint flags,
     gboolean is_searching,
     const gchar *group,
     gboolean is_fake_group,
     guint event_count)
 {
   EmpathyIndividualViewPriv *priv = GET_PRIV (self);
-  EmpathyLiveSearch *live = EMPATHY_LIVE_SEARCH (priv->search_widget);
-  GeeSet *personas;
-  GeeIterator *iter;
-  gboolean is_favorite, contains_interesting_persona = FALSE;
 
   /* Always display individuals having pending events */
   if (event_count > 0)
@@ -1711,42 +1942,26 @@ individual_view_is_visible_individual (EmpathyIndividualView *self,
   /* We're only giving the visibility wrt filtering here, not things like
    * presence. */
   if (priv->show_untrusted == FALSE &&
-      folks_individual_get_trust_level (individual) == FOLKS_TRUST_LEVEL_NONE)
+      (flags & EMPATHY_INDIVIDUAL_STORE_FLAG_UNTRUSTED) != 0)
     {
       return FALSE;
     }
 
   /* Hide all individuals which consist entirely of uninteresting personas */
-  personas = folks_individual_get_personas (individual);
-  iter = gee_iterable_iterator (GEE_ITERABLE (personas));
-  while (!contains_interesting_persona && gee_iterator_next (iter))
-    {
-      FolksPersona *persona = gee_iterator_get (iter);
-
-      if (empathy_folks_persona_is_interesting (persona))
-        contains_interesting_persona = TRUE;
-
-      g_clear_object (&persona);
-    }
-  g_clear_object (&iter);
-
-  if (contains_interesting_persona == FALSE)
+  if ((flags & EMPATHY_INDIVIDUAL_STORE_FLAG_INTERESTING) == 0)
     return FALSE;
 
-  is_favorite = folks_favourite_details_get_is_favourite (
-      FOLKS_FAVOURITE_DETAILS (individual));
   if (is_searching == FALSE) {
-    if (is_favorite && is_fake_group &&
-        !tp_strdiff (group, EMPATHY_INDIVIDUAL_STORE_FAVORITE))
+    if ((flags & EMPATHY_INDIVIDUAL_STORE_FLAG_FAVOURITE) != 0 &&
+        is_fake_group && !tp_strdiff (group, EMPATHY_INDIVIDUAL_STORE_FAVORITE))
         /* Always display favorite contacts in the favorite group */
         return TRUE;
 
-    return (priv->show_offline || is_online);
+    return (priv->show_offline ||
+        (flags & EMPATHY_INDIVIDUAL_STORE_FLAG_ONLINE) != 0);
   }
 
-  return empathy_individual_match_string (individual,
-      empathy_live_search_get_text (live),
-      empathy_live_search_get_words (live));
+  return individual_view_search_match (self, individual);
 }
 
 static gchar *
@@ -1781,9 +1996,11 @@ individual_view_filter_visible_func (GtkTreeModel *model,
   FolksIndividual *individual = NULL;
   gboolean is_group, is_separator, valid;
   GtkTreeIter child_iter;
-  gboolean visible, is_online;
+  gchar *group;
+  gboolean is_fake_group;
+  gboolean visible = FALSE;
   gboolean is_searching = TRUE;
-  guint event_count;
+  guint event_count, flags;
 
   if (priv->custom_filter != NULL)
     return priv->custom_filter (model, iter, priv->custom_filter_data);
@@ -1795,20 +2012,17 @@ individual_view_filter_visible_func (GtkTreeModel *model,
   gtk_tree_model_get (model, iter,
       EMPATHY_INDIVIDUAL_STORE_COL_IS_GROUP, &is_group,
       EMPATHY_INDIVIDUAL_STORE_COL_IS_SEPARATOR, &is_separator,
-      EMPATHY_INDIVIDUAL_STORE_COL_IS_ONLINE, &is_online,
+      EMPATHY_INDIVIDUAL_STORE_COL_FLAGS, &flags,
       EMPATHY_INDIVIDUAL_STORE_COL_INDIVIDUAL, &individual,
       EMPATHY_INDIVIDUAL_STORE_COL_EVENT_COUNT, &event_count,
       -1);
 
   if (individual != NULL)
     {
-      gchar *group;
-      gboolean is_fake_group;
-
       group = get_group (model, iter, &is_fake_group);
 
       visible = individual_view_is_visible_individual (self, individual,
-          is_online, is_searching, group, is_fake_group, event_count);
+          flags, is_searching, group, is_fake_group, event_count);
 
       g_object_unref (individual);
       g_free (group);
@@ -1830,36 +2044,49 @@ individual_view_filter_visible_func (GtkTreeModel *model,
   /* Not a contact, not a separator, must be a group */
   g_return_val_if_fail (is_group, FALSE);
 
-  /* only show groups which are not empty */
+  gtk_tree_model_get (model, iter,
+      EMPATHY_INDIVIDUAL_STORE_COL_NAME, &group,
+      EMPATHY_INDIVIDUAL_STORE_COL_IS_FAKE_GROUP, &is_fake_group,
+      -1);
+
+  /* only show groups which are not empty; the children are only looked at
+   * through their cached flags, the individual is only needed to match the
+   * search */
   for (valid = gtk_tree_model_iter_children (model, &child_iter, iter);
-       valid; valid = gtk_tree_model_iter_next (model, &child_iter))
+       valid && !visible; valid = gtk_tree_model_iter_next (model, &child_iter))
     {
-      gchar *group;
-      gboolean is_fake_group;
+      gboolean is_child_group, is_child_separator;
 
       gtk_tree_model_get (model, &child_iter,
-        EMPATHY_INDIVIDUAL_STORE_COL_INDIVIDUAL, &individual,
-        EMPATHY_INDIVIDUAL_STORE_COL_IS_ONLINE, &is_online,
+        EMPATHY_INDIVIDUAL_STORE_COL_IS_GROUP, &is_child_group,
+        EMPATHY_INDIVIDUAL_STORE_COL_IS_SEPARATOR, &is_child_separator,
+        EMPATHY_INDIVIDUAL_STORE_COL_FLAGS, &flags,
         EMPATHY_INDIVIDUAL_STORE_COL_EVENT_COUNT, &event_count,
         -1);
 
-      if (individual == NULL)
+      if (is_child_group || is_child_separator)
         continue;
 
-      group = get_group (model, &child_iter, &is_fake_group);
-
-      visible = individual_view_is_visible_individual (self, individual,
-          is_online, is_searching, group, is_fake_group, event_count);
+      if (is_searching)
+        {
+          gtk_tree_model_get (model, &child_iter,
+            EMPATHY_INDIVIDUAL_STORE_COL_INDIVIDUAL, &individual,
+            -1);
 
-      g_object_unref (individual);
-      g_free (group);
+          if (individual == NULL)
+            continue;
+        }
 
       /* show group if it has at least one visible contact in it */
-      if (visible == TRUE)
-        return TRUE;
+      visible = individual_view_is_visible_individual (self, individual,
+          flags, is_searching, group, is_fake_group, event_count);
+
+      tp_clear_object (&individual);
     }
 
-  return FALSE;
+  g_free (group);
+
+  return visible;
 }
 
 static void
@@ -2031,11 +2258,13 @@ individual_view_dispose (GObject *object)
   EmpathyIndividualView *view = EMPATHY_INDIVIDUAL_VIEW (object);
   EmpathyIndividualViewPriv *priv = GET_PRIV (view);
 
+  individual_view_verify_groups_clear (view);
   tp_clear_object (&priv->store);
   tp_clear_object (&priv->filter);
   tp_clear_object (&priv->tooltip_widget);
 
   empathy_individual_view_set_live_search (view, NULL);
+  tp_clear_object (&priv->search_index);
 
   G_OBJECT_CLASS (empathy_individual_view_parent_class)->dispose (object);
 }
@@ -2048,6 +2277,7 @@ individual_view_finalize (GObject *object)
   if (priv->expand_groups_idle_handler != 0)
     g_source_remove (priv->expand_groups_idle_handler);
   g_hash_table_destroy (priv->expand_groups);
+  g_hash_table_destroy (priv->verify_groups);
 
   G_OBJECT_CLASS (empathy_individual_view_parent_class)->finalize (object);
 }
@@ -2218,6 +2448,8 @@ empathy_individual_view_init (EmpathyIndividualView *view)
 
   priv->expand_groups = g_hash_table_new_full (g_str_hash, g_str_equal,
       (GDestroyNotify) g_free, NULL);
+  priv->verify_groups = g_hash_table_new_full (NULL, NULL, NULL,
+      (GDestroyNotify) gtk_tree_row_reference_free);
 
   gtk_tree_view_set_row_separator_func (GTK_TREE_VIEW (view),
       empathy_individual_store_row_separator_func, NULL, NULL);
@@ -2664,6 +2896,8 @@ empathy_individual_view_set_live_search (EmpathyIndividualView *view,
   /* remove old handlers if old search was not null */
   if (priv->search_widget != NULL)
     {
+      individual_view_search_index_clear (view);
+
       g_signal_handlers_disconnect_by_func (view,
           individual_view_start_search_cb, NULL);
 
@@ -2793,6 +3027,8 @@ empathy_individual_view_set_store (EmpathyIndividualView *self,
           individual_view_store_row_changed_cb, self);
       g_signal_handlers_disconnect_by_func (priv->store,
           individual_view_store_row_deleted_cb, self);
+      g_signal_handlers_disconnect_by_func (priv->store,
+          individual_view_store_row_changed_search_cb, self);
 
       g_signal_handlers_disconnect_by_func (priv->filter,
           individual_view_row_has_child_toggled_cb, self);
@@ -2800,8 +3036,10 @@ empathy_individual_view_set_store (EmpathyIndividualView *self,
       gtk_tree_view_set_model (GTK_TREE_VIEW (self), NULL);
     }
 
+  individual_view_verify_groups_clear (self);
   tp_clear_object (&priv->filter);
   tp_clear_object (&priv->store);
+  individual_view_search_index_clear (self);
 
   /* Set the new store */
   priv->store = store;
@@ -2810,6 +3048,12 @@ empathy_individual_view_set_store (EmpathyIndividualView *self,
     {
       g_object_ref (store);
 
+      /* This has to run before the filter evaluates the changed row */
+      tp_g_signal_connect_object (priv->store, "row-changed",
+          G_CALLBACK (individual_view_store_row_changed_search_cb), self, 0);
+      tp_g_signal_connect_object (priv->store, "row-inserted",
+          G_CALLBACK (individual_view_store_row_changed_search_cb), self, 0);
+
       /* Create a new filter */
       priv->filter = GTK_TREE_MODEL_FILTER (gtk_tree_model_filter_new (
           GTK_TREE_MODEL (priv->store), NULL));
@@ -64,13 +64,13 @@ static void live_search_hook_widget_destroy_cb (GtkWidget *object,
     gpointer user_data);
 
 /**
- * stripped_char:
+ * stripped_char_compute:
  *
  * Returns a stripped version of @ch, removing any case, accentuation
  * mark, or any special mark on it.
  **/
 static gunichar
-stripped_char (gunichar ch)
+stripped_char_compute (gunichar ch)
 {
   gunichar retval = 0;
   GUnicodeType utype;
@@ -126,6 +126,62 @@ stripped_char (gunichar ch)
   return retval;
 }
 
+/* Stripped chars of the Latin, Greek and Cyrillic blocks, and of the
+ * Latin and Greek extended ones, looked up instead of being computed for
+ * each char. Filled on first use. */
+#define STRIP_TABLE_LOW_END 0x0530
+#define STRIP_TABLE_EXTENDED_START 0x1E00
+#define STRIP_TABLE_EXTENDED_END 0x2000
+
+static gunichar strip_table_low[STRIP_TABLE_LOW_END];
+static gunichar strip_table_extended[STRIP_TABLE_EXTENDED_END -
+    STRIP_TABLE_EXTENDED_START];
+
+/* For ASCII chars: their stripped char, or 0 for separators and ignored
+ * chars; see ascii_is_ignored() */
+static gchar strip_table_ascii[0x80];
+
+static void
+strip_tables_init (void)
+{
+  static gsize initialized = 0;
+  gunichar ch;
+
+  if (!g_once_init_enter (&initialized))
+    return;
+
+  for (ch = 0; ch < STRIP_TABLE_LOW_END; ch++)
+    strip_table_low[ch] = stripped_char_compute (ch);
+
+  for (ch = STRIP_TABLE_EXTENDED_START; ch < STRIP_TABLE_EXTENDED_END; ch++)
+    strip_table_extended[ch - STRIP_TABLE_EXTENDED_START] =
+        stripped_char_compute (ch);
+
+  for (ch = 0; ch < 0x80; ch++)
+    {
+      gunichar sc = strip_table_low[ch];
+
+      strip_table_ascii[ch] = g_unichar_isalnum (sc) ? sc : 0;
+    }
+
+  g_once_init_leave (&initialized, 1);
+}
+
+/* ASCII control chars are ignored rather than separating words */
+#define ascii_is_ignored(c) (strip_table_low[(guchar) (c)] == 0)
+
+static gunichar
+stripped_char (gunichar ch)
+{
+  if (ch < STRIP_TABLE_LOW_END)
+    return strip_table_low[ch];
+
+  if (ch >= STRIP_TABLE_EXTENDED_START && ch < STRIP_TABLE_EXTENDED_END)
+    return strip_table_extended[ch - STRIP_TABLE_EXTENDED_START];
+
+  return stripped_char_compute (ch);
+}
+
 static void
 append_word (GPtrArray **word_array,
     GString **word)
@@ -149,13 +205,38 @@ empathy_live_search_strip_utf8_string (const gchar *string)
   if (EMP_STR_EMPTY (string))
     return NULL;
 
-  for (p = string; *p != '\0'; p = g_utf8_next_char (p))
+  strip_tables_init ();
+
+  p = string;
+  while (*p != '\0')
     {
       gunichar sc;
 
+      /* Fast path for ASCII chars, which need neither decoding nor
+       * decomposing */
+      if ((guchar) *p < 0x80)
+        {
+          gchar c = strip_table_ascii[(guchar) *p];
+
+          if (c != 0)
+            {
+              if (word == NULL)
+                word = g_string_new (NULL);
+              g_string_append_c (word, c);
+            }
+          else if (!ascii_is_ignored (*p))
+            {
+              append_word (&word_array, &word);
+            }
+
+          p++;
+          continue;
+        }
+
       /* Make the char lower-case, remove its accentuation marks, and ignore it
        * if it is just unicode marks */
       sc = stripped_char (g_utf8_get_char (p));
+      p = g_utf8_next_char (p);
       if (sc == 0)
         continue;
 
@@ -191,6 +272,8 @@ live_search_match_prefix (const gchar *string,
   if (EMP_STR_EMPTY (string))
     return FALSE;
 
+  strip_tables_init ();
+
   prefix_p = prefix;
   for (p = string; *p != '\0'; p = g_utf8_next_char (p))
     {
@@ -246,6 +329,191 @@ empathy_live_search_match_words (const gchar *string,
   return TRUE;
 }
 
+/* Same as live_search_match_prefix(), on a string which has already been
+ * stripped: a match which reaches the end of a word carries on with the
+ * next word, as word separators are skipped. */
+static gboolean
+live_search_match_stripped_prefix (GPtrArray *string_words,
+    const gchar *prefix)
+{
+  const gchar *prefix_p;
+  guint i;
+
+  if (prefix == NULL || prefix[0] == 0)
+    return TRUE;
+
+  if (string_words == NULL)
+    return FALSE;
+
+  prefix_p = prefix;
+  for (i = 0; i < string_words->len; i++)
+    {
+      const gchar *p;
+
+      for (p = g_ptr_array_index (string_words, i); *p != '\0';
+           p = g_utf8_next_char (p))
+        {
+          /* If this char does not match prefix_p, go to next word and start
+           * again from the beginning of prefix */
+          if (g_utf8_get_char (p) != g_utf8_get_char (prefix_p))
+            {
+              prefix_p = prefix;
+              break;
+            }
+
+          prefix_p = g_utf8_next_char (prefix_p);
+          if (*prefix_p == '\0')
+            return TRUE;
+        }
+    }
+
+  return FALSE;
+}
+
+/**
+ * empathy_live_search_match_stripped_words:
+ * @string_words: the words of a string, as returned by
+ *  empathy_live_search_strip_utf8_string()
+ * @words: the words to search for, as returned by
+ *  empathy_live_search_strip_utf8_string()
+ *
+ * Same as empathy_live_search_match_words(), for a string which has already
+ * been stripped.
+ *
+ * Returns: %TRUE if each of @words is a prefix of one of @string_words,
+ *  possibly followed by the next ones
+ **/
+gboolean
+empathy_live_search_match_stripped_words (GPtrArray *string_words,
+    GPtrArray *words)
+{
+  guint i;
+
+  if (words == NULL)
+    return TRUE;
+
+  for (i = 0; i < words->len; i++)
+    if (!live_search_match_stripped_prefix (string_words,
+            g_ptr_array_index (words, i)))
+      return FALSE;
+
+  return TRUE;
+}
+
+typedef struct
+{
+  gchar *string;
+  GPtrArray *words;
+} CachedWords;
+
+static void
+cached_words_free (gpointer data)
+{
+  CachedWords *cached = data;
+
+  g_free (cached->string);
+  if (cached->words != NULL)
+    g_ptr_array_unref (cached->words);
+
+  g_slice_free (CachedWords, cached);
+}
+
+/**
+ * empathy_live_search_get_cached_words:
+ * @object: the object @string belongs to
+ * @string: a string, must be valid UTF-8
+ * @len: length of @string in bytes, or -1 if it's nul-terminated
+ *
+ * Strips @string like empathy_live_search_strip_utf8_string() does, keeping
+ * the result on @object so it is only computed again once @object is
+ * passed a different string. Each object caches one string only.
+ *
+ * Returns: (transfer none): the stripped words of @string, or %NULL
+ **/
+GPtrArray *
+empathy_live_search_get_cached_words (GObject *object,
+    const gchar *string,
+    gssize len)
+{
+  static GQuark quark = 0;
+  CachedWords *cached;
+
+  g_return_val_if_fail (G_IS_OBJECT (object), NULL);
+
+  if (G_UNLIKELY (quark == 0))
+    quark = g_quark_from_static_string ("empathy-live-search-cached-words");
+
+  if (string == NULL)
+    string = "";
+
+  if (len < 0)
+    len = strlen (string);
+
+  cached = g_object_get_qdata (object, quark);
+  if (cached != NULL &&
+      strncmp (cached->string, string, len) == 0 &&
+      cached->string[len] == '\0')
+    return cached->words;
+
+  cached = g_slice_new (CachedWords);
+  cached->string = g_strndup (string, len);
+  cached->words = empathy_live_search_strip_utf8_string (cached->string);
+
+  g_object_set_qdata_full (object, quark, cached, cached_words_free);
+
+  return cached->words;
+}
+
+/**
+ * empathy_live_search_strip_phone_number:
+ * @string: a string
+ *
+ * Keeps the digits of @string, and its leading '+', if it is written like a
+ * phone number: digits which may be separated by spaces, dashes, dots or
+ * parentheses. The result can be compared to the normalised form of phone
+ * numbers.
+ *
+ * Returns: a newly allocated string, or %NULL if @string isn't a phone number
+ **/
+gchar *
+empathy_live_search_strip_phone_number (const gchar *string)
+{
+  GString *number;
+  gboolean has_digit = FALSE;
+  const gchar *p;
+
+  if (EMP_STR_EMPTY (string))
+    return NULL;
+
+  number = g_string_new (NULL);
+
+  for (p = string; *p != '\0'; p++)
+    {
+      if (g_ascii_isdigit (*p))
+        {
+          g_string_append_c (number, *p);
+          has_digit = TRUE;
+        }
+      else if (*p == '+' && number->len == 0)
+        {
+          g_string_append_c (number, *p);
+        }
+      else if (strchr (" -.()", *p) == NULL)
+        {
+          g_string_free (number, TRUE);
+          return NULL;
+        }
+    }
+
+  if (!has_digit)
+    {
+      g_string_free (number, TRUE);
+      return NULL;
+    }
+
+  return g_string_free (number, FALSE);
+}
+
 static gboolean
 fire_key_navigation_sig (EmpathyLiveSearch *self,
     GdkEventKey *event)
@@ -70,8 +70,17 @@ GPtrArray * empathy_live_search_strip_utf8_string (const gchar *string);
 gboolean empathy_live_search_match_words (const gchar *string,
     GPtrArray *words);
 
+gboolean empathy_live_search_match_stripped_words (GPtrArray *string_words,
+    GPtrArray *words);
+
+GPtrArray * empathy_live_search_get_cached_words (GObject *object,
+    const gchar *string,
+    gssize len);
+
 GPtrArray * empathy_live_search_get_words (EmpathyLiveSearch *self);
 
+gchar * empathy_live_search_strip_phone_number (const gchar *string);
+
 /* Made public for unit tests */
 gboolean empathy_live_search_match_string (const gchar *string,
    const gchar *prefix);
@@ -115,6 +115,20 @@ struct _EmpathyLogWindowPriv
   /* Used to cancel logger calls when no longer needed */
   guint count;
 
+  /* owned gchar * (see events_cache_key()) -> owned CachedEvents, the
+   * events of dates already fetched from the logger */
+  GHashTable *events_cache;
+  /* borrowed CachedEvents, the most recently used first */
+  GQueue *events_cache_lru;
+  /* owned gchar * (same keys) -> NULL, dates being prefetched */
+  GHashTable *prefetching;
+  /* Bumped each time the cache is invalidated, so events fetched before
+   * aren't cached */
+  guint cache_generation;
+
+  /* Scripts queued for the webview, see events_webview_begin_batch() */
+  GString *pending_script;
+
   /* List of owned TplLogSearchHits, free with tpl_log_search_hit_free */
   GList *hits;
   guint source;
@@ -298,6 +312,137 @@ ctx_free (Ctx *ctx)
   g_slice_free (Ctx, ctx);
 }
 
+/* At most that many dates are fetched from the logger at once; their events
+ * are still shown in the order they were asked for */
+#define MAX_PARALLEL_FETCHES 4
+
+/* Fetched dates kept in the cache; the least recently used ones are
+ * dropped first */
+#define MAX_CACHED_DATES 64
+
+typedef struct
+{
+  /* the key of the entry, owned by the hash table */
+  const gchar *key;
+  guint32 julian;
+  /* owned TplEvent */
+  GList *events;
+  /* the link of the entry in events_cache_lru */
+  GQueue *lru;
+  GList *link;
+} CachedEvents;
+
+static void
+cached_events_free (CachedEvents *cached)
+{
+  g_queue_delete_link (cached->lru, cached->link);
+  g_list_free_full (cached->events, g_object_unref);
+  g_slice_free (CachedEvents, cached);
+}
+
+static GList *
+events_list_copy (GList *events)
+{
+  GList *copy = g_list_copy (events);
+
+  g_list_foreach (copy, (GFunc) g_object_ref, NULL);
+
+  return copy;
+}
+
+static gchar *
+events_cache_key (Ctx *ctx)
+{
+  return g_strdup_printf ("%s %u %s %u %u",
+      tp_proxy_get_object_path (ctx->account),
+      tpl_entity_get_entity_type (ctx->entity),
+      tpl_entity_get_identifier (ctx->entity),
+      g_date_get_julian (ctx->date),
+      ctx->event_mask);
+}
+
+/* Returns a copy of the cached events of @ctx's date, which is %NULL both
+ * for dates with no event and dates not in the cache */
+static GList *
+events_cache_lookup (EmpathyLogWindow *self,
+    Ctx *ctx,
+    gboolean *found)
+{
+  gchar *key = events_cache_key (ctx);
+  CachedEvents *cached;
+
+  cached = g_hash_table_lookup (self->priv->events_cache, key);
+  g_free (key);
+
+  *found = (cached != NULL);
+
+  if (cached != NULL)
+    {
+      g_queue_unlink (cached->lru, cached->link);
+      g_queue_push_head_link (cached->lru, cached->link);
+    }
+
+  return cached != NULL ? events_list_copy (cached->events) : NULL;
+}
+
+static void
+events_cache_insert (EmpathyLogWindow *self,
+    Ctx *ctx,
+    GList *events)
+{
+  CachedEvents *cached;
+  gchar *key;
+
+  key = events_cache_key (ctx);
+
+  /* Make room by dropping the date visited the longest time ago, unless
+   * this date replaces one */
+  if (g_hash_table_lookup (self->priv->events_cache, key) == NULL &&
+      g_hash_table_size (self->priv->events_cache) >= MAX_CACHED_DATES)
+    {
+      CachedEvents *oldest = g_queue_peek_tail (self->priv->events_cache_lru);
+
+      g_hash_table_remove (self->priv->events_cache, oldest->key);
+    }
+
+  cached = g_slice_new (CachedEvents);
+  cached->key = key;
+  cached->julian = g_date_get_julian (ctx->date);
+  cached->events = events_list_copy (events);
+  cached->lru = self->priv->events_cache_lru;
+
+  g_queue_push_head (cached->lru, cached);
+  cached->link = g_queue_peek_head_link (cached->lru);
+
+  /* replace, so that the table owns the key cached->key points to */
+  g_hash_table_replace (self->priv->events_cache, key, cached);
+}
+
+static gboolean
+cached_events_is_on_date (gpointer key,
+    gpointer value,
+    gpointer user_data)
+{
+  CachedEvents *cached = value;
+
+  return cached->julian == GPOINTER_TO_UINT (user_data);
+}
+
+/* Drop the cached events of @date, or all of them if it's %NULL */
+static void
+events_cache_invalidate (EmpathyLogWindow *self,
+    GDate *date)
+{
+  if (date != NULL)
+    g_hash_table_foreach_remove (self->priv->events_cache,
+        cached_events_is_on_date,
+        GUINT_TO_POINTER (g_date_get_julian (date)));
+  else
+    g_hash_table_remove_all (self->priv->events_cache);
+
+  self->priv->cache_generation++;
+}
+
 static void
 account_chooser_ready_cb (EmpathyAccountChooser *chooser,
     EmpathyLogWindow *self)
@@ -373,6 +518,71 @@ toolbutton_av_clicked (GtkToolButton *toolbutton,
       TRUE, video, gtk_get_current_event_time ());
 }
 
+/* Between these two calls, scripts for the events webview are queued and
+ * then all run at once */
+static void
+events_webview_begin_batch (EmpathyLogWindow *self)
+{
+  if (self->priv->pending_script == NULL)
+    self->priv->pending_script = g_string_new (NULL);
+}
+
+static void
+events_webview_end_batch (EmpathyLogWindow *self)
+{
+  GString *script = self->priv->pending_script;
+
+  if (script == NULL)
+    return;
+
+  self->priv->pending_script = NULL;
+
+  if (script->len > 0)
+    webkit_web_view_execute_script (WEBKIT_WEB_VIEW (self->priv->webview),
+        script->str);
+
+  g_string_free (script, TRUE);
+}
+
+static void
+events_webview_execute_script (EmpathyLogWindow *self,
+    const gchar *script)
+{
+  if (self->priv->pending_script != NULL)
+    {
+      g_string_append (self->priv->pending_script, script);
+      g_string_append (self->priv->pending_script, ";\n");
+      return;
+    }
+
+  webkit_web_view_execute_script (WEBKIT_WEB_VIEW (self->priv->webview),
+      script);
+}
+
+/* The webview only renders the rows close to the visible part of the page,
+ * so it highlights @text itself as it renders them; %NULL stops that */
+static void
+events_webview_set_highlight (EmpathyLogWindow *self,
+    const gchar *text)
+{
+  gchar exceptions[0x81];
+  gchar *escaped, *script;
+  guint i;
+
+  /* Don't escape UTF-8 sequences */
+  for (i = 0; i < 0x80; i++)
+    exceptions[i] = 0x80 + i;
+  exceptions[0x80] = '\0';
+
+  escaped = g_strescape (text != NULL ? text : "", exceptions);
+  script = g_strdup_printf ("javascript:setHighlight(\"%s\");", escaped);
+
+  events_webview_execute_script (self, script);
+
+  g_free (escaped);
+  g_free (script);
+}
+
 static void
 insert_or_change_row (EmpathyLogWindow *self,
     const char *method,
@@ -410,8 +620,7 @@ insert_or_change_row (EmpathyLogWindow *self,
       icon != NULL ? icon : "",
       date);
 
-  webkit_web_view_execute_script (WEBKIT_WEB_VIEW (self->priv->webview),
-      script);
+  events_webview_execute_script (self, script);
 
   g_free (str);
   g_free (text);
@@ -450,8 +659,7 @@ store_events_row_deleted (GtkTreeModel *model,
   script = g_strdup_printf ("javascript:deleteRow([%s]);",
       g_strdelimit (str, ":", ','));
 
-  webkit_web_view_execute_script (WEBKIT_WEB_VIEW (self->priv->webview),
-      script);
+  events_webview_execute_script (self, script);
 
   g_free (str);
   g_free (script);
@@ -470,8 +678,7 @@ store_events_has_child_rows (GtkTreeModel *model,
       g_strdelimit (str, ":", ','),
       gtk_tree_model_iter_has_child (model, iter));
 
-  webkit_web_view_execute_script (WEBKIT_WEB_VIEW (self->priv->webview),
-      script);
+  events_webview_execute_script (self, script);
 
   g_free (str);
   g_free (script);
@@ -500,8 +707,7 @@ store_events_rows_reordered (GtkTreeModel *model,
       str == NULL ? "" : g_strdelimit (str, ":", ','),
       new_order_s);
 
-  webkit_web_view_execute_script (WEBKIT_WEB_VIEW (self->priv->webview),
-      script);
+  events_webview_execute_script (self, script);
 
   g_free (str);
   g_free (script);
@@ -567,6 +773,9 @@ empathy_log_window_dispose (GObject *object)
 
   tp_clear_pointer (&self->priv->chain, _tpl_action_chain_free);
   tp_clear_pointer (&self->priv->channels, g_hash_table_unref);
+  tp_clear_pointer (&self->priv->events_cache, g_hash_table_unref);
+  tp_clear_pointer (&self->priv->events_cache_lru, g_queue_free);
+  tp_clear_pointer (&self->priv->prefetching, g_hash_table_unref);
 
   tp_clear_object (&self->priv->observer);
   tp_clear_object (&self->priv->log_manager);
@@ -591,6 +800,9 @@ empathy_log_window_finalize (GObject *object)
   g_free (self->priv->last_find);
   g_free (self->priv->selected_chat_id);
 
+  if (self->priv->pending_script != NULL)
+    g_string_free (self->priv->pending_script, TRUE);
+
   G_OBJECT_CLASS (empathy_log_window_parent_class)->finalize (object);
 }
 
@@ -623,6 +835,12 @@ empathy_log_window_init (EmpathyLogWindow *self)
 
   self->priv->chain = _tpl_action_chain_new_async (NULL, NULL, NULL);
 
+  self->priv->events_cache = g_hash_table_new_full (g_str_hash, g_str_equal,
+      g_free, (GDestroyNotify) cached_events_free);
+  self->priv->events_cache_lru = g_queue_new ();
+  self->priv->prefetching = g_hash_table_new_full (g_str_hash, g_str_equal,
+      g_free, NULL);
+
   self->priv->camera_monitor = empathy_camera_monitor_dup_singleton ();
 
   self->priv->log_manager = tpl_log_manager_dup_singleton ();
@@ -867,11 +1085,19 @@ maybe_refresh_logs (TpChannel *channel,
   gboolean anyone;
   const gchar *type;
 
+  now = g_date_time_new_now_local ();
+  today = g_date_new_dmy (g_date_time_get_day_of_month (now),
+      g_date_time_get_month (now),
+      g_date_time_get_year (now));
+
+  /* Whatever has happened is now part of today's logs */
+  events_cache_invalidate (log_window, today);
+
   if (!log_window_get_selected (log_window,
       &accounts, &entities, &anyone, &dates, &event_mask, NULL))
     {
       DEBUG ("Could not get selected rows");
-      return;
+      goto out;
     }
 
   type = tp_channel_get_channel_type (channel);
@@ -887,10 +1113,6 @@ maybe_refresh_logs (TpChannel *channel,
     goto out;
 
   anytime = g_date_new_dmy (2, 1, -1);
-  now = g_date_time_new_now_local ();
-  today = g_date_new_dmy (g_date_time_get_day_of_month (now),
-      g_date_time_get_month (now),
-      g_date_time_get_year (now));
 
   /* If Today (or anytime) isn't selected, anything that has happened now
    * won't be displayed. */
@@ -1640,8 +1862,9 @@ model_has_date (GtkTreeModel *model,
   return FALSE;
 }
 
-static void
-get_events_for_date (TplActionChain *chain, gpointer user_data);
+static void log_window_fetch_events (EmpathyLogWindow *self,
+    GPtrArray *ctxs,
+    gboolean prefetch);
 
 static void
 populate_events_from_search_hits (GList *accounts,
@@ -1652,12 +1875,15 @@ populate_events_from_search_hits (GList *accounts,
   EventSubtype subtype;
   GDate *anytime;
   GList *l;
+  GPtrArray *ctxs;
   gboolean is_anytime = FALSE;
 
   if (!log_window_get_selected (log_window,
       NULL, NULL, NULL, NULL, &event_mask, &subtype))
     return;
 
+  ctxs = g_ptr_array_new_with_free_func ((GDestroyNotify) ctx_free);
+
   anytime = g_date_new_dmy (2, 1, -1);
   if (g_list_find_custom (dates, anytime, (GCompareFunc) g_date_compare))
     is_anytime = TRUE;
@@ -1695,11 +1921,12 @@ populate_events_from_search_hits (GList *accounts,
 
           ctx = ctx_new (log_window, hit->account, hit->target, hit->date,
               event_mask, subtype, log_window->priv->count);
-          _tpl_action_chain_append (log_window->priv->chain,
-              get_events_for_date, ctx);
+          g_ptr_array_add (ctxs, ctx);
         }
     }
 
+  log_window_fetch_events (log_window, ctxs, FALSE);
+
   start_spinner ();
   _tpl_action_chain_start (log_window->priv->chain);
 
@@ -1983,8 +2210,7 @@ log_window_find_populate (EmpathyLogWindow *self,
   if (EMP_STR_EMPTY (search_criteria))
     {
       tp_clear_pointer (&self->priv->hits, tpl_log_manager_search_free);
-      webkit_web_view_set_highlight_text_matches (
-          WEBKIT_WEB_VIEW (self->priv->webview), FALSE);
+      events_webview_set_highlight (self, NULL);
       log_window_who_populate (self);
       return;
     }
@@ -1994,8 +2220,7 @@ log_window_find_populate (EmpathyLogWindow *self,
       self);
 
   /* highlight the search text */
-  webkit_web_view_mark_text_matches (WEBKIT_WEB_VIEW (self->priv->webview),
-      search_criteria, FALSE, 0);
+  events_webview_set_highlight (self, search_criteria);
 
   tpl_log_manager_search_async (self->priv->log_manager,
       search_criteria, TPL_EVENT_MASK_ANY,
@@ -3113,9 +3338,7 @@ log_window_maybe_expand_events (void)
 
   /* If there's only one result, expand it */
   if (gtk_tree_model_iter_n_children (model, NULL) == 1)
-    webkit_web_view_execute_script (
-        WEBKIT_WEB_VIEW (log_window->priv->webview),
-        "javascript:expandAll()");
+    events_webview_execute_script (log_window, "javascript:expandAll()");
 }
 
 static gboolean
@@ -3159,35 +3382,10 @@ start_spinner (void)
 }
 
 static void
-log_window_got_messages_for_date_cb (GObject *manager,
-    GAsyncResult *result,
-    gpointer user_data)
+log_window_append_events (Ctx *ctx,
+    GList *events)
 {
-  Ctx *ctx = user_data;
-  GtkTreeModel *model;
-  GtkTreeIter iter;
-  GList *events;
   GList *l;
-  GError *error = NULL;
-  gint n;
-
-  if (log_window == NULL)
-    {
-      ctx_free (ctx);
-      return;
-    }
-
-  if (log_window->priv->count != ctx->count)
-    goto out;
-
-  if (!tpl_log_manager_get_events_for_date_finish (TPL_LOG_MANAGER (manager),
-      result, &events, &error))
-    {
-      DEBUG ("Unable to retrieve messages for the selected date: %s. Aborting",
-          error->message);
-      g_error_free (error);
-      goto out;
-    }
 
   for (l = events; l; l = l->next)
     {
@@ -3238,12 +3436,17 @@ log_window_got_messages_for_date_cb (GObject *manager,
           log_window_append_message (event, msg);
           tp_clear_object (&msg);
         }
-
-      g_object_unref (event);
     }
-  g_list_free (events);
+}
+
+static void
+log_window_scroll_to_last_event (EmpathyLogWindow *self)
+{
+  GtkTreeModel *model;
+  GtkTreeIter iter;
+  gint n;
 
-  model = GTK_TREE_MODEL (log_window->priv->store_events);
+  model = GTK_TREE_MODEL (self->priv->store_events);
   n = gtk_tree_model_iter_n_children (model, NULL) - 1;
 
   if (n >= 0 && gtk_tree_model_iter_nth_child (model, &iter, NULL, n))
@@ -3257,31 +3460,337 @@ log_window_got_messages_for_date_cb (GObject *manager,
       script = g_strdup_printf ("javascript:scrollToRow([%s]);",
           g_strdelimit (str, ":", ','));
 
-      webkit_web_view_execute_script (
-          WEBKIT_WEB_VIEW (log_window->priv->webview),
-          script);
+      events_webview_execute_script (self, script);
 
       gtk_tree_path_free (path);
       g_free (str);
       g_free (script);
     }
+}
 
- out:
-  ctx_free (ctx);
+/* Fetches the events of several dates, up to MAX_PARALLEL_FETCHES of them at
+ * once, and shows them in order as soon as all the previous ones are there */
+typedef struct
+{
+  EmpathyLogWindow *self;
+  /* owned Ctx */
+  GPtrArray *ctxs;
+  /* owned TplEvent list for each ctx, once fetched */
+  GList **events;
+  gboolean *fetched;
+  guint next_fetch;
+  guint next_show;
+  guint pending;
+  guint count;
+  guint cache_generation;
+  /* Whether to prefetch the dates around the fetched one once done */
+  gboolean prefetch;
+} EventsFetch;
+
+typedef struct
+{
+  EventsFetch *fetch;
+  guint index;
+} EventsFetchRequest;
+
+static void log_window_got_events_for_date_cb (GObject *manager,
+    GAsyncResult *result,
+    gpointer user_data);
+
+static void
+events_fetch_free (EventsFetch *fetch)
+{
+  guint i;
+
+  for (i = 0; i < fetch->ctxs->len; i++)
+    g_list_free_full (fetch->events[i], g_object_unref);
+
+  g_ptr_array_unref (fetch->ctxs);
+  g_free (fetch->events);
+  g_free (fetch->fetched);
+  g_slice_free (EventsFetch, fetch);
+}
+
+static gboolean
+events_fetch_is_cancelled (EventsFetch *fetch)
+{
+  return log_window == NULL || log_window->priv->count != fetch->count;
+}
+
+/* Show the events of all the dates fetched so far, if all the dates before
+ * them have been shown */
+static void
+events_fetch_show_ready (EventsFetch *fetch)
+{
+  if (fetch->next_show >= fetch->ctxs->len ||
+      !fetch->fetched[fetch->next_show])
+    return;
+
+  events_webview_begin_batch (fetch->self);
+
+  while (fetch->next_show < fetch->ctxs->len &&
+      fetch->fetched[fetch->next_show])
+    {
+      log_window_append_events (g_ptr_array_index (fetch->ctxs,
+          fetch->next_show), fetch->events[fetch->next_show]);
+
+      g_list_free_full (fetch->events[fetch->next_show], g_object_unref);
+      fetch->events[fetch->next_show] = NULL;
+      fetch->next_show++;
+    }
+
+  log_window_scroll_to_last_event (fetch->self);
+  events_webview_end_batch (fetch->self);
+}
+
+static void log_window_prefetch_around (EventsFetch *fetch);
+
+static void
+events_fetch_continue (EventsFetch *fetch)
+{
+  if (!events_fetch_is_cancelled (fetch))
+    {
+      while (fetch->next_fetch < fetch->ctxs->len &&
+          fetch->pending < MAX_PARALLEL_FETCHES)
+        {
+          guint i = fetch->next_fetch++;
+          Ctx *ctx = g_ptr_array_index (fetch->ctxs, i);
+          EventsFetchRequest *request;
+          gboolean found;
+
+          fetch->events[i] = events_cache_lookup (fetch->self, ctx, &found);
+          if (found)
+            {
+              fetch->fetched[i] = TRUE;
+              continue;
+            }
+
+          request = g_slice_new (EventsFetchRequest);
+          request->fetch = fetch;
+          request->index = i;
+
+          fetch->pending++;
+          tpl_log_manager_get_events_for_date_async (
+              fetch->self->priv->log_manager,
+              ctx->account, ctx->entity, ctx->event_mask,
+              ctx->date,
+              log_window_got_events_for_date_cb,
+              request);
+        }
+
+      events_fetch_show_ready (fetch);
+    }
 
+  if (fetch->pending > 0)
+    return;
+
+  /* Done, or cancelled and all the requests we started came back */
+  if (log_window == NULL)
+    {
+      events_fetch_free (fetch);
+      return;
+    }
+
+  if (fetch->prefetch && !events_fetch_is_cancelled (fetch))
+    log_window_prefetch_around (fetch);
+
+  events_fetch_free (fetch);
   _tpl_action_chain_continue (log_window->priv->chain);
 }
 
 static void
-get_events_for_date (TplActionChain *chain, gpointer user_data)
+log_window_got_events_for_date_cb (GObject *manager,
+    GAsyncResult *result,
+    gpointer user_data)
+{
+  EventsFetchRequest *request = user_data;
+  EventsFetch *fetch = request->fetch;
+  guint i = request->index;
+  GList *events;
+  GError *error = NULL;
+
+  g_slice_free (EventsFetchRequest, request);
+  fetch->pending--;
+
+  if (events_fetch_is_cancelled (fetch))
+    goto out;
+
+  if (!tpl_log_manager_get_events_for_date_finish (TPL_LOG_MANAGER (manager),
+      result, &events, &error))
+    {
+      DEBUG ("Unable to retrieve messages for the selected date: %s",
+          error->message);
+      g_error_free (error);
+      events = NULL;
+    }
+  else if (log_window->priv->cache_generation == fetch->cache_generation)
+    {
+      events_cache_insert (log_window, g_ptr_array_index (fetch->ctxs, i),
+          events);
+    }
+
+  fetch->events[i] = events;
+  fetch->fetched[i] = TRUE;
+
+ out:
+  events_fetch_continue (fetch);
+}
+
+static void
+get_events_for_dates (TplActionChain *chain, gpointer user_data)
+{
+  events_fetch_continue (user_data);
+}
+
+/* Takes ownership of @ctxs */
+static void
+log_window_fetch_events (EmpathyLogWindow *self,
+    GPtrArray *ctxs,
+    gboolean prefetch)
+{
+  EventsFetch *fetch = g_slice_new0 (EventsFetch);
+
+  fetch->self = self;
+  fetch->ctxs = ctxs;
+  fetch->events = g_new0 (GList *, ctxs->len);
+  fetch->fetched = g_new0 (gboolean, ctxs->len);
+  fetch->count = self->priv->count;
+  fetch->cache_generation = self->priv->cache_generation;
+  fetch->prefetch = prefetch;
+
+  _tpl_action_chain_append (self->priv->chain, get_events_for_dates, fetch);
+}
+
+static void
+log_window_prefetched_events_cb (GObject *manager,
+    GAsyncResult *result,
+    gpointer user_data)
 {
   Ctx *ctx = user_data;
+  gchar *key;
+  GList *events;
 
-  tpl_log_manager_get_events_for_date_async (ctx->self->priv->log_manager,
-      ctx->account, ctx->entity, ctx->event_mask,
-      ctx->date,
-      log_window_got_messages_for_date_cb,
-      ctx);
+  if (log_window == NULL)
+    {
+      ctx_free (ctx);
+      return;
+    }
+
+  key = events_cache_key (ctx);
+  g_hash_table_remove (log_window->priv->prefetching, key);
+  g_free (key);
+
+  /* For prefetches, ctx->count is the cache generation they started in */
+  if (tpl_log_manager_get_events_for_date_finish (TPL_LOG_MANAGER (manager),
+          result, &events, NULL))
+    {
+      if (ctx->count == log_window->priv->cache_generation)
+        events_cache_insert (log_window, ctx, events);
+
+      g_list_free_full (events, g_object_unref);
+    }
+
+  ctx_free (ctx);
+}
+
+static void
+log_window_prefetch_date (EmpathyLogWindow *self,
+    Ctx *template,
+    GDate *date)
+{
+  Ctx *ctx;
+  gchar *key;
+
+  ctx = ctx_new (self, template->account, template->entity, date,
+      template->event_mask, template->subtype, self->priv->cache_generation);
+  key = events_cache_key (ctx);
+
+  if (g_hash_table_lookup (self->priv->events_cache, key) != NULL ||
+      g_hash_table_lookup_extended (self->priv->prefetching, key,
+          NULL, NULL))
+    {
+      g_free (key);
+      ctx_free (ctx);
+      return;
+    }
+
+  g_hash_table_insert (self->priv->prefetching, key, NULL);
+
+  tpl_log_manager_get_events_for_date_async (self->priv->log_manager,
+      ctx->account, ctx->entity, ctx->event_mask, ctx->date,
+      log_window_prefetched_events_cb, ctx);
+}
+
+/* Fetch the dates just before and after the one which was shown, so going
+ * through the "When" list one date at a time doesn't wait for the logger */
+static void
+log_window_prefetch_around (EventsFetch *fetch)
+{
+  GtkTreeView *view;
+  GtkTreeModel *model;
+  GtkTreeIter iter;
+  GDate *shown, *previous = NULL, *next = NULL, *anytime, *separator;
+  gboolean valid;
+  guint i;
+
+  if (fetch->ctxs->len == 0)
+    return;
+
+  shown = ((Ctx *) g_ptr_array_index (fetch->ctxs, 0))->date;
+  anytime = g_date_new_dmy (2, 1, -1);
+  separator = g_date_new_dmy (1, 1, -1);
+
+  view = GTK_TREE_VIEW (fetch->self->priv->treeview_when);
+  model = gtk_tree_view_get_model (view);
+
+  for (valid = gtk_tree_model_get_iter_first (model, &iter);
+       valid;
+       valid = gtk_tree_model_iter_next (model, &iter))
+    {
+      GDate *date;
+
+      gtk_tree_model_get (model, &iter,
+          COL_WHEN_DATE, &date,
+          -1);
+
+      if (g_date_compare (date, anytime) == 0 ||
+          g_date_compare (date, separator) == 0)
+        {
+          g_date_free (date);
+          continue;
+        }
+
+      if (g_date_compare (date, shown) == 0)
+        {
+          g_date_free (date);
+
+          /* The row after it, if any */
+          if (gtk_tree_model_iter_next (model, &iter))
+            gtk_tree_model_get (model, &iter,
+                COL_WHEN_DATE, &next,
+                -1);
+
+          break;
+        }
+
+      tp_clear_pointer (&previous, g_date_free);
+      previous = date;
+    }
+
+  for (i = 0; i < fetch->ctxs->len; i++)
+    {
+      Ctx *ctx = g_ptr_array_index (fetch->ctxs, i);
+
+      if (previous != NULL)
+        log_window_prefetch_date (fetch->self, ctx, previous);
+      if (next != NULL)
+        log_window_prefetch_date (fetch->self, ctx, next);
+    }
+
+  tp_clear_pointer (&previous, g_date_free);
+  tp_clear_pointer (&next, g_date_free);
+  g_date_free (separator);
+  g_date_free (anytime);
 }
 
 static void
@@ -3292,6 +3801,8 @@ log_window_get_messages_for_dates (EmpathyLogWindow *self,
   TplEventTypeMask event_mask;
   EventSubtype subtype;
   GDate *date, *anytime, *separator;
+  GPtrArray *ctxs;
+  gboolean prefetch;
 
   if (!log_window_get_selected (self,
       &accounts, &targets, NULL, NULL, &event_mask, &subtype))
@@ -3299,6 +3810,12 @@ log_window_get_messages_for_dates (EmpathyLogWindow *self,
 
   anytime = g_date_new_dmy (2, 1, -1);
   separator = g_date_new_dmy (1, 1, -1);
+  ctxs = g_ptr_array_new_with_free_func ((GDestroyNotify) ctx_free);
+
+  /* When looking at a single date, the user is likely to look at the ones
+   * around it next */
+  prefetch = (dates != NULL && dates->next == NULL &&
+      g_date_compare (dates->data, anytime) != 0);
 
   _tpl_action_chain_clear (self->priv->chain);
   self->priv->count++;
@@ -3321,7 +3838,7 @@ log_window_get_messages_for_dates (EmpathyLogWindow *self,
 
               ctx = ctx_new (self, account, target, date, event_mask, subtype,
                   self->priv->count);
-              _tpl_action_chain_append (self->priv->chain, get_events_for_date, ctx);
+              g_ptr_array_add (ctxs, ctx);
             }
           else
             {
@@ -3346,13 +3863,17 @@ log_window_get_messages_for_dates (EmpathyLogWindow *self,
                     {
                       ctx = ctx_new (self, account, target, d,
                           event_mask, subtype, self->priv->count);
-                      _tpl_action_chain_append (self->priv->chain, get_events_for_date, ctx);
+                      g_ptr_array_add (ctxs, ctx);
                     }
+
+                  g_date_free (d);
                 }
             }
         }
     }
 
+  log_window_fetch_events (self, ctxs, prefetch);
+
   start_spinner ();
   _tpl_action_chain_start (self->priv->chain);
 
@@ -3536,7 +4057,9 @@ log_window_chats_get_messages (EmpathyLogWindow *self,
   store = GTK_LIST_STORE (model);
 
   /* Clear all current messages shown in the textview */
+  events_webview_begin_batch (self);
   gtk_tree_store_clear (self->priv->store_events);
+  events_webview_end_batch (self);
 
   _tpl_action_chain_clear (self->priv->chain);
   self->priv->count++;
@@ -3770,6 +4293,8 @@ log_window_delete_menu_clicked_cb (GtkMenuItem *menuitem,
   if (response_id != GTK_RESPONSE_APPLY)
     goto out;
 
+  events_cache_invalidate (self, NULL);
+
   bus = tp_dbus_daemon_dup (&error);
   if (error != NULL)
     {
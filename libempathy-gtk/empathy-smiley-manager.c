@@ -30,14 +30,46 @@
 
 typedef struct _SmileyManagerTree SmileyManagerTree;
 
+/* Smileys are first added to a trie of SmileyManagerTree, keyed by byte so
+ * UTF-8 smileys need no special handling. Before parsing, the trie is
+ * compiled into an Aho-Corasick automaton: an array of SmileyNode in
+ * breadth-first order (root first) whose children are contiguous ranges of
+ * the edges array. Nodes refer to each other by index, 0 being the root. */
+typedef struct {
+	guint        first_edge;
+	guint        n_edges;
+	/* Node for the longest proper suffix of this node's string which is
+	 * also in the trie */
+	guint        fail;
+	/* This node if a smiley ends here, otherwise the deepest node
+	 * reachable through fail links where a smiley ends; 0 if none */
+	guint        match;
+	guint        depth;
+	/* Borrowed from the SmileyManagerTree */
+	GdkPixbuf   *pixbuf;
+	const gchar *path;
+} SmileyNode;
+
+typedef struct {
+	guchar       c;
+	guint        node;
+} SmileyEdge;
+
 #define GET_PRIV(obj) EMPATHY_GET_PRIV (obj, EmpathySmileyManager)
 typedef struct {
 	SmileyManagerTree *tree;
 	GSList            *smileys;
+
+	/* Compiled automaton, rebuilt on next parse when dirty */
+	gboolean           dirty;
+	GArray            *nodes;
+	GArray            *edges;
+	/* Transitions from the root, indexed by byte */
+	guint              root_next[256];
 } EmpathySmileyManagerPriv;
 
 struct _SmileyManagerTree {
-	gunichar     c;
+	guchar       c;
 	GdkPixbuf   *pixbuf;
 	gchar       *path;
 	GSList      *childrens;
@@ -48,7 +80,7 @@ G_DEFINE_TYPE (EmpathySmileyManager, empathy_smiley_manager, G_TYPE_OBJECT);
 static EmpathySmileyManager *manager_singleton = NULL;
 
 static SmileyManagerTree *
-smiley_manager_tree_new (gunichar c)
+smiley_manager_tree_new (guchar c)
 {
 	SmileyManagerTree *tree;
 
@@ -110,6 +142,10 @@ smiley_manager_finalize (GObject *object)
 	smiley_manager_tree_free (priv->tree);
 	g_slist_foreach (priv->smileys, (GFunc) smiley_free, NULL);
 	g_slist_free (priv->smileys);
+	g_array_free (priv->nodes, TRUE);
+	g_array_free (priv->edges, TRUE);
+
+	G_OBJECT_CLASS (empathy_smiley_manager_parent_class)->finalize (object);
 }
 
 static GObject *
@@ -152,6 +188,9 @@ empathy_smiley_manager_init (EmpathySmileyManager *manager)
 	manager->priv = priv;
 	priv->tree = smiley_manager_tree_new ('\0');
 	priv->smileys = NULL;
+	priv->nodes = g_array_new (FALSE, TRUE, sizeof (SmileyNode));
+	priv->edges = g_array_new (FALSE, FALSE, sizeof (SmileyEdge));
+	priv->dirty = TRUE;
 
 	empathy_smiley_manager_load (manager);
 }
@@ -163,7 +202,7 @@ empathy_smiley_manager_dup_singleton (void)
 }
 
 static SmileyManagerTree *
-smiley_manager_tree_find_child (SmileyManagerTree *tree, gunichar c)
+smiley_manager_tree_find_child (SmileyManagerTree *tree, guchar c)
 {
 	GSList *l;
 
@@ -179,7 +218,7 @@ smiley_manager_tree_find_child (SmileyManagerTree *tree, gunichar c)
 }
 
 static SmileyManagerTree *
-smiley_manager_tree_find_or_insert_child (SmileyManagerTree *tree, gunichar c)
+smiley_manager_tree_find_or_insert_child (SmileyManagerTree *tree, guchar c)
 {
 	SmileyManagerTree *child;
 
@@ -201,9 +240,9 @@ smiley_manager_tree_insert (SmileyManagerTree *tree,
 {
 	SmileyManagerTree *child;
 
-	child = smiley_manager_tree_find_or_insert_child (tree, g_utf8_get_char (str));
+	child = smiley_manager_tree_find_or_insert_child (tree, *str);
 
-	str = g_utf8_next_char (str);
+	str++;
 	if (*str) {
 		smiley_manager_tree_insert (child, pixbuf, str, path);
 		return;
@@ -227,6 +266,7 @@ smiley_manager_add_valist (EmpathySmileyManager *manager,
 	for (str = first_str; str; str = va_arg (var_args, gchar*)) {
 		smiley_manager_tree_insert (priv->tree, pixbuf, str, path);
 	}
+	priv->dirty = TRUE;
 
 	g_object_set_data_full (G_OBJECT (pixbuf), "smiley_str",
 				g_strdup (first_str), g_free);
@@ -289,20 +329,137 @@ empathy_smiley_manager_load (EmpathySmileyManager *manager)
 	empathy_smiley_manager_add (manager, "face-worried",    ":-S",   ":S",   ":-s", ":s", NULL);
 }
 
-static EmpathySmileyHit *
-smiley_hit_new (SmileyManagerTree *tree,
-		guint              start,
-		guint              end)
+static guint
+smiley_manager_find_edge (EmpathySmileyManagerPriv *priv,
+			  guint                     node,
+			  guchar                    c)
+{
+	const SmileyNode *n = &g_array_index (priv->nodes, SmileyNode, node);
+	const SmileyEdge *edges;
+	guint             i;
+
+	edges = &g_array_index (priv->edges, SmileyEdge, n->first_edge);
+	for (i = 0; i < n->n_edges; i++) {
+		if (edges[i].c == c) {
+			return edges[i].node;
+		}
+	}
+
+	return 0;
+}
+
+static guint
+smiley_manager_next (EmpathySmileyManagerPriv *priv,
+		     guint                     node,
+		     guchar                    c)
 {
-	EmpathySmileyHit *hit;
+	while (node != 0) {
+		guint next;
+
+		next = smiley_manager_find_edge (priv, node, c);
+		if (next != 0) {
+			return next;
+		}
+
+		node = g_array_index (priv->nodes, SmileyNode, node).fail;
+	}
+
+	return priv->root_next[c];
+}
+
+static void
+smiley_manager_compile (EmpathySmileyManagerPriv *priv)
+{
+	GQueue     *queue;
+	SmileyNode  root = { 0, };
+	guint       i;
+
+	g_array_set_size (priv->nodes, 0);
+	g_array_set_size (priv->edges, 0);
+	memset (priv->root_next, 0, sizeof (priv->root_next));
+
+	/* Flatten the trie breadth-first, so children of a node get
+	 * contiguous edges and every node comes after the ones with a
+	 * smaller depth. */
+	g_array_append_val (priv->nodes, root);
+	queue = g_queue_new ();
+	g_queue_push_tail (queue, priv->tree);
+
+	for (i = 0; !g_queue_is_empty (queue); i++) {
+		SmileyManagerTree *tree = g_queue_pop_head (queue);
+		guint              depth;
+		GSList            *l;
+
+		depth = g_array_index (priv->nodes, SmileyNode, i).depth;
+		g_array_index (priv->nodes, SmileyNode, i).first_edge =
+			priv->edges->len;
+
+		for (l = tree->childrens; l; l = l->next) {
+			SmileyManagerTree *child = l->data;
+			SmileyNode         node = { 0, };
+			SmileyEdge         edge;
+
+			node.depth = depth + 1;
+			node.pixbuf = child->pixbuf;
+			node.path = child->path;
+
+			edge.c = child->c;
+			edge.node = priv->nodes->len;
+
+			g_array_append_val (priv->nodes, node);
+			g_array_append_val (priv->edges, edge);
+			g_queue_push_tail (queue, child);
+		}
+
+		g_array_index (priv->nodes, SmileyNode, i).n_edges =
+			priv->edges->len -
+			g_array_index (priv->nodes, SmileyNode, i).first_edge;
+	}
+
+	g_queue_free (queue);
+
+	/* Compute fail and match links. Fail links always point to a
+	 * shallower node, which has been handled already. */
+	for (i = 0; i < priv->nodes->len; i++) {
+		SmileyNode *node = &g_array_index (priv->nodes, SmileyNode, i);
+		guint       e;
+
+		for (e = node->first_edge; e < node->first_edge + node->n_edges; e++) {
+			SmileyEdge *edge = &g_array_index (priv->edges, SmileyEdge, e);
+			SmileyNode *child;
+
+			child = &g_array_index (priv->nodes, SmileyNode, edge->node);
+
+			if (i == 0) {
+				priv->root_next[edge->c] = edge->node;
+				child->fail = 0;
+			} else {
+				child->fail = smiley_manager_next (priv,
+					node->fail, edge->c);
+			}
+
+			if (child->pixbuf != NULL) {
+				child->match = edge->node;
+			} else {
+				child->match = g_array_index (priv->nodes,
+					SmileyNode, child->fail).match;
+			}
+		}
+	}
+
+	priv->dirty = FALSE;
+}
 
-	hit = g_slice_new (EmpathySmileyHit);
-	hit->pixbuf = tree->pixbuf;
-	hit->path = tree->path;
+static void
+smiley_hit_init (EmpathySmileyHit *hit,
+		 const SmileyNode *node,
+		 guint             start,
+		 guint             end)
+{
+	hit->pixbuf = node->pixbuf;
+	hit->path = node->path;
 	hit->start = start;
 	hit->end = end;
-
-	return hit;
 }
 
 void
@@ -313,93 +470,120 @@ empathy_smiley_hit_free (EmpathySmileyHit *hit)
 	g_slice_free (EmpathySmileyHit, hit);
 }
 
-GSList *
-empathy_smiley_manager_parse_len (EmpathySmileyManager *manager,
-				  const gchar          *text,
-				  gssize                len)
+guint
+empathy_smiley_manager_parse_hits (EmpathySmileyManager *manager,
+				   const gchar          *text,
+				   gssize                len,
+				   EmpathySmileyHit     *hits,
+				   guint                 n_hits)
 {
 	EmpathySmileyManagerPriv *priv = GET_PRIV (manager);
-	EmpathySmileyHit         *hit;
-	GSList                   *hits = NULL;
-	SmileyManagerTree        *cur_tree = priv->tree;
-	const gchar              *cur_str;
-	const gchar              *start = NULL;
-
-	g_return_val_if_fail (EMPATHY_IS_SMILEY_MANAGER (manager), NULL);
-	g_return_val_if_fail (text != NULL, NULL);
+	const SmileyNode         *nodes;
+	const guchar             *str = (const guchar *) text;
+	gsize                     pos = 0;
+	gsize                     cand_start = 0;
+	guint                     cand = 0;
+	guint                     state = 0;
+	guint                     n = 0;
+
+	g_return_val_if_fail (EMPATHY_IS_SMILEY_MANAGER (manager), 0);
+	g_return_val_if_fail (text != NULL, 0);
+
+	if (priv->dirty) {
+		smiley_manager_compile (priv);
+	}
+	nodes = (const SmileyNode *) priv->nodes->data;
 
 	/* If len is negative, parse the string until we find '\0' */
 	if (len < 0) {
 		len = G_MAXSSIZE;
 	}
 
-	/* Parse the len first bytes of text to find smileys. Each time a smiley
-	 * is detected, append a EmpathySmileyHit struct to the returned list,
-	 * containing the smiley pixbuf and the position of the text to be
-	 * replaced by it.
-	 * cur_str is a pointer in the text showing the current position
-	 * of the parsing. It is always at the begining of an UTF-8 character,
-	 * because we support unicode smileys! For example we could want to
-	 * replace ™ by an image. */
-
-	for (cur_str = text;
-	     *cur_str != '\0' && cur_str - text < len;
-	     cur_str = g_utf8_next_char (cur_str)) {
-		SmileyManagerTree *child;
-		gunichar           c;
-
-		c = g_utf8_get_char (cur_str);
-		child = smiley_manager_tree_find_child (cur_tree, c);
-
-		/* If we have a child it means c is part of a smiley */
-		if (child) {
-			if (cur_tree == priv->tree) {
-				/* c is the first char of some smileys, keep
-				 * the begining position */
-				start = cur_str;
-			}
-			cur_tree = child;
+	/* Find leftmost-longest, non-overlapping smileys. We run the
+	 * automaton over the bytes of the text; state is always the node for
+	 * the longest suffix of the text read so far that is a prefix of some
+	 * smiley, so every smiley ending at pos is found by following its
+	 * match link.
+	 *
+	 * A candidate hit is only final once no smiley starting at or before
+	 * it can still be found, that is once the partial match held by the
+	 * state starts after it. Scanning then resumes from the root at the
+	 * end of the hit, so at most a smiley's length is ever read twice. */
+	while (n < n_hits) {
+		gboolean at_end;
+		gsize    partial_start;
+
+		at_end = (gssize) pos >= len || str[pos] == '\0';
+		if (!at_end) {
+			state = smiley_manager_next (priv, state, str[pos]);
+			pos++;
+		}
+
+		partial_start = at_end ? pos : pos - nodes[state].depth;
+
+		if (cand != 0 && partial_start > cand_start) {
+			gsize end = cand_start + nodes[cand].depth;
+
+			smiley_hit_init (&hits[n++], &nodes[cand],
+					 cand_start, end);
+			cand = 0;
+			state = 0;
+			pos = end;
 			continue;
 		}
 
-		/* c is not part of a smiley. let's check if we found a smiley
-		 * before it. */
-		if (cur_tree->pixbuf != NULL) {
-			/* found! */
-			hit = smiley_hit_new (cur_tree, start - text,
-					      cur_str - text);
-			hits = g_slist_prepend (hits, hit);
+		if (at_end) {
+			break;
+		}
 
-			/* c was not part of this smiley, check if a new smiley
-			 * start with it. */
-			cur_tree = smiley_manager_tree_find_child (priv->tree, c);
-			if (cur_tree) {
-				start = cur_str;
-			} else {
-				cur_tree = priv->tree;
+		/* The longest smiley ending here is the one starting
+		 * first; a later end with the same start is longer. */
+		if (nodes[state].match != 0) {
+			guint match = nodes[state].match;
+			gsize start = pos - nodes[match].depth;
+
+			if (cand == 0 || start <= cand_start) {
+				cand = match;
+				cand_start = start;
 			}
-		} else if (cur_tree != priv->tree) {
-			/* We searched a smiley starting at 'start' but we ended
-			 * with no smiley. Look again starting from next char.
-			 *
-			 * For example ">:)" and ":(" are both valid smileys,
-			 * when parsing text ">:(" we first see '>' which could
-			 * be the start of a smiley. 'start' variable is set to
-			 * that position and we parse next char which is ':' and
-			 * is still potential smiley. Then we see '(' which is
-			 * NOT part of the smiley, ">:(" does not exist, so we
-			 * have to start again from ':' to find ":(" which is
-			 * correct smiley. */
-			cur_str = start;
-			cur_tree = priv->tree;
 		}
 	}
 
-	/* Check if last char of the text was the end of a smiley */
-	if (cur_tree->pixbuf != NULL) {
-		hit = smiley_hit_new (cur_tree, start - text, cur_str - text);
-		hits = g_slist_prepend (hits, hit);
-	}
+	return n;
+}
+
+GSList *
+empathy_smiley_manager_parse_len (EmpathySmileyManager *manager,
+				  const gchar          *text,
+				  gssize                len)
+{
+	EmpathySmileyHit  buffer[16];
+	GSList           *hits = NULL;
+	guint             offset = 0;
+	guint             n, i;
+
+	g_return_val_if_fail (EMPATHY_IS_SMILEY_MANAGER (manager), NULL);
+	g_return_val_if_fail (text != NULL, NULL);
+
+	do {
+		n = empathy_smiley_manager_parse_hits (manager, text + offset,
+			len < 0 ? -1 : (gssize) (len - offset),
+			buffer, G_N_ELEMENTS (buffer));
+
+		for (i = 0; i < n; i++) {
+			EmpathySmileyHit *hit;
+
+			hit = g_slice_new (EmpathySmileyHit);
+			*hit = buffer[i];
+			hit->start += offset;
+			hit->end += offset;
+			hits = g_slist_prepend (hits, hit);
+		}
+
+		if (n > 0) {
+			offset += buffer[n - 1].end;
+		}
+	} while (n == G_N_ELEMENTS (buffer));
 
 	return g_slist_reverse (hits);
 }
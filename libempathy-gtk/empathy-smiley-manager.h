@@ -74,6 +74,11 @@ GSList *              empathy_smiley_manager_get_all         (EmpathySmileyManag
 GSList *              empathy_smiley_manager_parse_len       (EmpathySmileyManager *manager,
 							      const gchar          *text,
 							      gssize                len);
+guint                 empathy_smiley_manager_parse_hits      (EmpathySmileyManager *manager,
+							      const gchar          *text,
+							      gssize                len,
+							      EmpathySmileyHit     *hits,
+							      guint                 n_hits);
 GtkWidget *           empathy_smiley_menu_new                (EmpathySmileyManager *manager,
 							      EmpathySmileyMenuFunc func,
 							      gpointer              user_data);
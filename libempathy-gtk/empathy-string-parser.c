@@ -69,6 +69,102 @@ empathy_string_parser_substr (const gchar *text,
 	}
 }
 
+static EmpathySmileyManager *
+smiley_manager_get_singleton (void)
+{
+	static EmpathySmileyManager *smiley_manager = NULL;
+
+	/* Like the regex, keep a ref around instead of getting one for
+	 * each piece of text */
+	if (smiley_manager == NULL) {
+		smiley_manager = empathy_smiley_manager_dup_singleton ();
+	}
+
+	return smiley_manager;
+}
+
+/* Every match of URI_REGEX contains one of "://", "www.", "ftp." or '@';
+ * most messages have none of them, so check for those before running the
+ * regex. */
+static gboolean
+string_parser_may_contain_link (const gchar *text,
+				gsize len)
+{
+	gsize i;
+
+	for (i = 0; i < len; i++) {
+		switch (text[i]) {
+		case '@':
+			return TRUE;
+		case ':':
+			if (i + 2 < len && text[i + 1] == '/' &&
+			    text[i + 2] == '/') {
+				return TRUE;
+			}
+			break;
+		case '.':
+			if (i >= 3 && (!strncmp (text + i - 3, "www", 3) ||
+				       !strncmp (text + i - 3, "ftp", 3))) {
+				return TRUE;
+			}
+			break;
+		default:
+			break;
+		}
+	}
+
+	return FALSE;
+}
+
+/* Calls replace_func for each smiley in text[0:len] and hands the text
+ * around them to sub_parsers. */
+static void
+string_parser_match_smileys_len (const gchar *text,
+				 gsize len,
+				 EmpathyStringReplace replace_func,
+				 EmpathyStringParser *sub_parsers,
+				 gpointer user_data)
+{
+	EmpathySmileyManager *smiley_manager = smiley_manager_get_singleton ();
+	EmpathySmileyHit hits[16];
+	guint n_hits, i;
+	gsize last = 0;
+
+	/* Hits are reported relative to the text we passed, which starts
+	 * at the end of the previous batch */
+	do {
+		gsize offset = last;
+
+		n_hits = empathy_smiley_manager_parse_hits (smiley_manager,
+			text + offset, len - offset, hits, G_N_ELEMENTS (hits));
+
+		for (i = 0; i < n_hits; i++) {
+			EmpathySmileyHit *hit = &hits[i];
+
+			hit->start += offset;
+			hit->end += offset;
+
+			if (hit->start > last) {
+				/* Append the text between last smiley (or the
+				 * start of the message) and this smiley */
+				empathy_string_parser_substr (text + last,
+							      hit->start - last,
+							      sub_parsers, user_data);
+			}
+
+			replace_func (text + hit->start, hit->end - hit->start,
+				      hit, user_data);
+
+			last = hit->end;
+		}
+	} while (n_hits == G_N_ELEMENTS (hits));
+
+	if (last < len) {
+		empathy_string_parser_substr (text + last, len - last,
+					      sub_parsers, user_data);
+	}
+}
+
 void
 empathy_string_match_link (const gchar *text,
 			   gssize len,
@@ -76,44 +172,69 @@ empathy_string_match_link (const gchar *text,
 			   EmpathyStringParser *sub_parsers,
 			   gpointer user_data)
 {
-	GRegex     *uri_regex;
-	GMatchInfo *match_info;
-	gboolean    match;
-	gint        last = 0;
-
-	uri_regex = uri_regex_dup_singleton ();
-	if (uri_regex == NULL) {
-		empathy_string_parser_substr (text, len, sub_parsers, user_data);
-		return;
+	GRegex     *uri_regex = NULL;
+	GMatchInfo *match_info = NULL;
+	gboolean    match = FALSE;
+	gboolean    fuse_smileys;
+	gsize       last = 0;
+
+	if (len < 0) {
+		len = strlen (text);
 	}
 
-	match = g_regex_match_full (uri_regex, text, len, 0, 0, &match_info, NULL);
-	if (match) {
-		gint s = 0, e = 0;
+	if (string_parser_may_contain_link (text, len)) {
+		uri_regex = uri_regex_dup_singleton ();
+		if (uri_regex != NULL) {
+			match = g_regex_match_full (uri_regex, text, len, 0, 0,
+						    &match_info, NULL);
+		}
+	}
+
+	/* When smileys are the next stage, look for them here directly, in
+	 * the same forward scan as links, rather than going through
+	 * empathy_string_parser_substr() for each piece between links. */
+	fuse_smileys = sub_parsers != NULL &&
+		sub_parsers[0].match_func == empathy_string_match_smiley;
+
+	while (TRUE) {
+		gint s = len, e = len;
 
-		do {
+		if (match) {
 			g_match_info_fetch_pos (match_info, 0, &s, &e);
+		}
 
-			if (s > last) {
-				/* Append the text between last link (or the
-				 * start of the message) and this link */
+		if ((gsize) s > last) {
+			/* Hand over the text between last link (or the
+			 * start of the message) and this link */
+			if (fuse_smileys) {
+				string_parser_match_smileys_len (text + last,
+					s - last, sub_parsers[0].replace_func,
+					sub_parsers + 1, user_data);
+			} else {
 				empathy_string_parser_substr (text + last,
 							      s - last,
 							      sub_parsers,
 							      user_data);
 			}
+		}
 
-			replace_func (text + s, e - s, NULL, user_data);
+		if (!match) {
+			break;
+		}
 
-			last = e;
-		} while (g_match_info_next (match_info, NULL));
+		replace_func (text + s, e - s, NULL, user_data);
+
+		last = e;
+		match = g_match_info_next (match_info, NULL);
 	}
 
-	empathy_string_parser_substr (text + last, len - last,
-				      sub_parsers, user_data);
+	if (match_info != NULL) {
+		g_match_info_free (match_info);
+	}
 
-	g_match_info_free (match_info);
-	g_regex_unref (uri_regex);
+	if (uri_regex != NULL) {
+		g_regex_unref (uri_regex);
+	}
 }
 
 void
@@ -123,36 +244,12 @@ empathy_string_match_smiley (const gchar *text,
 			     EmpathyStringParser *sub_parsers,
 			     gpointer user_data)
 {
-	guint last = 0;
-	EmpathySmileyManager *smiley_manager;
-	GSList *hits, *l;
-
-	smiley_manager = empathy_smiley_manager_dup_singleton ();
-	hits = empathy_smiley_manager_parse_len (smiley_manager, text, len);
-
-	for (l = hits; l; l = l->next) {
-		EmpathySmileyHit *hit = l->data;
-
-		if (hit->start > last) {
-			/* Append the text between last smiley (or the
-			 * start of the message) and this smiley */
-			empathy_string_parser_substr (text + last,
-						      hit->start - last,
-						      sub_parsers, user_data);
-		}
-
-		replace_func (text + hit->start, hit->end - hit->start,
-			      hit, user_data);
-
-		last = hit->end;
-
-		empathy_smiley_hit_free (hit);
+	if (len < 0) {
+		len = strlen (text);
 	}
-	g_slist_free (hits);
-	g_object_unref (smiley_manager);
 
-	empathy_string_parser_substr (text + last, len - last,
-				      sub_parsers, user_data);
+	string_parser_match_smileys_len (text, len, replace_func,
+					 sub_parsers, user_data);
 }
 
 void
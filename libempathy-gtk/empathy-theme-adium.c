@@ -74,6 +74,10 @@ typedef struct {
 	gboolean              allow_scrolling;
 	gchar                *variant;
 	gboolean              in_construction;
+	/* Scripts run together at the next idle, see
+	 * theme_adium_get_script_buffer() */
+	GString              *pending_scripts;
+	guint                 flush_scripts_id;
 } EmpathyThemeAdiumPriv;
 
 struct _EmpathyAdiumData {
@@ -88,6 +92,9 @@ struct _EmpathyAdiumData {
 	gboolean custom_template;
 	/* gchar* -> gchar* both owned */
 	GHashTable *date_format_cache;
+	/* const gchar* (one of the HTML bits below) -> owned GArray of
+	 * AdiumSegment, see adium_template_compile() */
+	GHashTable *templates;
 
 	/* HTML bits */
 	const gchar *template_html;
@@ -530,65 +537,95 @@ nsdate_to_strftime (EmpathyAdiumData *data, const gchar *nsdate)
 }
 
 
+/* The HTML bits of a theme are split once in a list of segments, each being
+ * either a piece of literal HTML or a keyword to replace */
+typedef enum {
+	ADIUM_SEGMENT_LITERAL,
+	ADIUM_SEGMENT_USER_ICON_PATH,
+	ADIUM_SEGMENT_SENDER_SCREEN_NAME,
+	ADIUM_SEGMENT_SENDER,
+	ADIUM_SEGMENT_SENDER_COLOR,
+	ADIUM_SEGMENT_MESSAGE,
+	ADIUM_SEGMENT_TIME,
+	ADIUM_SEGMENT_SHORT_TIME,
+	ADIUM_SEGMENT_SERVICE,
+	ADIUM_SEGMENT_USER_ICONS,
+	ADIUM_SEGMENT_MESSAGE_CLASSES,
+	/* A keyword we don't support yet, replaced by nothing */
+	ADIUM_SEGMENT_NONE,
+} AdiumSegmentType;
+
+typedef struct {
+	AdiumSegmentType type;
+	/* The HTML, already escaped, for ADIUM_SEGMENT_LITERAL; the
+	 * strftime format, if any, for ADIUM_SEGMENT_TIME */
+	gchar *text;
+} AdiumSegment;
+
 static void
-theme_adium_append_html (EmpathyThemeAdium *theme,
-			 const gchar       *func,
-			 const gchar       *html,
-		         const gchar       *message,
-		         const gchar       *avatar_filename,
-		         const gchar       *name,
-		         const gchar       *contact_id,
-		         const gchar       *service_name,
-		         const gchar       *message_classes,
-		         gint64             timestamp,
-		         gboolean           is_backlog,
-		         gboolean           outgoing)
+adium_template_free (GArray *segments)
 {
-	EmpathyThemeAdiumPriv *priv = GET_PRIV (theme);
-	GString     *string;
-	const gchar *cur = NULL;
-	gchar       *script;
+	guint i;
+
+	for (i = 0; i < segments->len; i++) {
+		g_free (g_array_index (segments, AdiumSegment, i).text);
+	}
+
+	g_array_free (segments, TRUE);
+}
+
+static void
+adium_template_add (GArray           *segments,
+		    AdiumSegmentType  type,
+		    gchar            *text)
+{
+	AdiumSegment segment = { type, text };
+
+	g_array_append_val (segments, segment);
+}
+
+static GArray *
+adium_template_compile (EmpathyAdiumData *data,
+			const gchar      *html)
+{
+	GArray      *segments;
+	GString     *literal;
+	const gchar *cur;
+
+	segments = g_array_new (FALSE, FALSE, sizeof (AdiumSegment));
+	literal = g_string_new (NULL);
 
-	/* Make some search-and-replace in the html code */
-	string = g_string_sized_new (strlen (html) + strlen (message));
-	g_string_append_printf (string, "%s(\"", func);
 	for (cur = html; *cur != '\0'; cur++) {
-		const gchar *replace = NULL;
-		gchar       *dup_replace = NULL;
-		gchar       *format = NULL;
+		AdiumSegmentType type;
+		gchar           *format = NULL;
+		gchar           *text = NULL;
 
 		/* Those are all well known keywords that needs replacement in
 		 * html files. Please keep them in the same order than the adium
 		 * spec. See http://trac.adium.im/wiki/CreatingMessageStyles */
 		if (theme_adium_match (&cur, "%userIconPath%")) {
-			replace = avatar_filename;
+			type = ADIUM_SEGMENT_USER_ICON_PATH;
 		} else if (theme_adium_match (&cur, "%senderScreenName%")) {
-			replace = contact_id;
+			type = ADIUM_SEGMENT_SENDER_SCREEN_NAME;
 		} else if (theme_adium_match (&cur, "%sender%")) {
-			replace = name;
+			type = ADIUM_SEGMENT_SENDER;
 		} else if (theme_adium_match (&cur, "%senderColor%")) {
 			/* A color derived from the user's name.
 			 * FIXME: If a colon separated list of HTML colors is at
 			 * Incoming/SenderColors.txt it will be used instead of
 			 * the default colors.
 			 */
-
-			/* Ensure we always use the same color when sending messages
-			 * (bgo #658821) */
-			if (outgoing) {
-				replace = "inherit";
-			} else if (contact_id != NULL) {
-				guint hash = g_str_hash (contact_id);
-				replace = colors[hash % G_N_ELEMENTS (colors)];
-			}
+			type = ADIUM_SEGMENT_SENDER_COLOR;
 		} else if (theme_adium_match (&cur, "%senderStatusIcon%")) {
 			/* FIXME: The path to the status icon of the sender
 			 * (available, away, etc...)
 			 */
+			type = ADIUM_SEGMENT_NONE;
 		} else if (theme_adium_match (&cur, "%messageDirection%")) {
 			/* FIXME: The text direction of the message
 			 * (either rtl or ltr)
 			 */
+			type = ADIUM_SEGMENT_NONE;
 		} else if (theme_adium_match (&cur, "%senderDisplayName%")) {
 			/* FIXME: The serverside (remotely set) name of the
 			 * sender, such as an MSN display name.
@@ -596,48 +633,37 @@ theme_adium_append_html (EmpathyThemeAdium *theme,
 			 *  We don't have access to that yet so we use
 			 * local alias instead.
 			 */
-			replace = name;
+			type = ADIUM_SEGMENT_SENDER;
 		} else if (theme_adium_match_with_format (&cur, "%textbackgroundcolor{", &format)) {
 			/* FIXME: This keyword is used to represent the
 			 * highlight background color. "X" is the opacity of the
 			 * background, ranges from 0 to 1 and can be any decimal
 			 * between.
 			 */
+			type = ADIUM_SEGMENT_NONE;
 		} else if (theme_adium_match (&cur, "%message%")) {
-			replace = message;
+			type = ADIUM_SEGMENT_MESSAGE;
 		} else if (theme_adium_match (&cur, "%time%") ||
 			   theme_adium_match_with_format (&cur, "%time{", &format)) {
-			const gchar *strftime_format;
-
-			strftime_format = nsdate_to_strftime (priv->data, format);
-			if (is_backlog) {
-				dup_replace = empathy_time_to_string_local (timestamp,
-					strftime_format ? strftime_format :
-					EMPATHY_TIME_DATE_FORMAT_DISPLAY_SHORT);
-			} else {
-				dup_replace = empathy_time_to_string_local (timestamp,
-					strftime_format ? strftime_format :
-					EMPATHY_TIME_FORMAT_DISPLAY_SHORT);
-			}
-			replace = dup_replace;
+			type = ADIUM_SEGMENT_TIME;
+			text = g_strdup (nsdate_to_strftime (data, format));
 		} else if (theme_adium_match (&cur, "%shortTime%")) {
-			dup_replace = empathy_time_to_string_local (timestamp,
-				EMPATHY_TIME_FORMAT_DISPLAY_SHORT);
-			replace = dup_replace;
+			type = ADIUM_SEGMENT_SHORT_TIME;
 		} else if (theme_adium_match (&cur, "%service%")) {
-			replace = service_name;
+			type = ADIUM_SEGMENT_SERVICE;
 		} else if (theme_adium_match (&cur, "%variant%")) {
 			/* FIXME: The name of the active message style variant,
 			 * with all spaces replaced with an underscore.
 			 * A variant named "Alternating Messages - Blue Red"
 			 * will become "Alternating_Messages_-_Blue_Red".
 			 */
+			type = ADIUM_SEGMENT_NONE;
 		} else if (theme_adium_match (&cur, "%userIcons%")) {
 			/* FIXME: mus t be "hideIcons" if use preference is set
 			 * to hide avatars */
-			replace = "showIcons";
+			type = ADIUM_SEGMENT_USER_ICONS;
 		} else if (theme_adium_match (&cur, "%messageClasses%")) {
-			replace = message_classes;
+			type = ADIUM_SEGMENT_MESSAGE_CLASSES;
 		} else if (theme_adium_match (&cur, "%status%")) {
 			/* FIXME: A description of the status event. This is
 			 * neither in the user's local language nor expected to
@@ -665,22 +691,205 @@ theme_adium_append_html (EmpathyThemeAdium *theme,
 			 *	fileTransferStarted
 			 *	fileTransferCompleted
 			 */
+			type = ADIUM_SEGMENT_NONE;
 		} else {
-			escape_and_append_len (string, cur, 1);
+			escape_and_append_len (literal, cur, 1);
+			continue;
+		}
+
+		g_free (format);
+
+		if (type == ADIUM_SEGMENT_NONE) {
+			continue;
+		}
+
+		if (literal->len > 0) {
+			adium_template_add (segments, ADIUM_SEGMENT_LITERAL,
+					    g_strndup (literal->str, literal->len));
+			g_string_truncate (literal, 0);
+		}
+
+		adium_template_add (segments, type, text);
+	}
+
+	if (literal->len > 0) {
+		adium_template_add (segments, ADIUM_SEGMENT_LITERAL,
+				    g_string_free (literal, FALSE));
+	} else {
+		g_string_free (literal, TRUE);
+	}
+
+	return segments;
+}
+
+static GArray *
+adium_data_get_template (EmpathyAdiumData *data,
+			 const gchar      *html)
+{
+	GArray *segments;
+
+	segments = g_hash_table_lookup (data->templates, html);
+	if (segments == NULL) {
+		segments = adium_template_compile (data, html);
+		g_hash_table_insert (data->templates, (gpointer) html, segments);
+	}
+
+	return segments;
+}
+
+static void
+theme_adium_flush_scripts (EmpathyThemeAdium *theme)
+{
+	EmpathyThemeAdiumPriv *priv = GET_PRIV (theme);
+
+	if (priv->flush_scripts_id != 0) {
+		g_source_remove (priv->flush_scripts_id);
+		priv->flush_scripts_id = 0;
+	}
+
+	if (priv->pending_scripts == NULL || priv->pending_scripts->len == 0) {
+		return;
+	}
+
+	webkit_web_view_execute_script (WEBKIT_WEB_VIEW (theme),
+					priv->pending_scripts->str);
+	g_string_truncate (priv->pending_scripts, 0);
+}
+
+static gboolean
+theme_adium_flush_scripts_cb (gpointer user_data)
+{
+	EmpathyThemeAdium *theme = user_data;
+	EmpathyThemeAdiumPriv *priv = GET_PRIV (theme);
+
+	priv->flush_scripts_id = 0;
+	theme_adium_flush_scripts (theme);
+
+	return FALSE;
+}
+
+/* Scripts are not run right away but appended to this buffer, which is run
+ * in one go before the next redraw. Anything reading the DOM has to call
+ * theme_adium_flush_scripts() first. */
+static GString *
+theme_adium_get_script_buffer (EmpathyThemeAdium *theme)
+{
+	EmpathyThemeAdiumPriv *priv = GET_PRIV (theme);
+
+	if (priv->pending_scripts == NULL) {
+		priv->pending_scripts = g_string_new (NULL);
+	}
+
+	if (priv->flush_scripts_id == 0) {
+		priv->flush_scripts_id = g_idle_add_full (G_PRIORITY_HIGH_IDLE,
+			theme_adium_flush_scripts_cb, theme, NULL);
+	}
+
+	return priv->pending_scripts;
+}
+
+static void
+theme_adium_execute_script (EmpathyThemeAdium *theme,
+			    const gchar       *script)
+{
+	GString *string = theme_adium_get_script_buffer (theme);
+
+	g_string_append (string, script);
+	g_string_append (string, ";\n");
+}
+
+static void
+theme_adium_append_html (EmpathyThemeAdium *theme,
+			 const gchar       *func,
+			 const gchar       *html,
+		         const gchar       *message,
+		         const gchar       *avatar_filename,
+		         const gchar       *name,
+		         const gchar       *contact_id,
+		         const gchar       *service_name,
+		         const gchar       *message_classes,
+		         gint64             timestamp,
+		         gboolean           is_backlog,
+		         gboolean           outgoing)
+{
+	EmpathyThemeAdiumPriv *priv = GET_PRIV (theme);
+	GArray      *segments;
+	GString     *string;
+	guint        i;
+
+	segments = adium_data_get_template (priv->data, html);
+
+	/* Make some search-and-replace in the html code */
+	string = theme_adium_get_script_buffer (theme);
+	g_string_append_printf (string, "%s(\"", func);
+	for (i = 0; i < segments->len; i++) {
+		AdiumSegment *segment = &g_array_index (segments, AdiumSegment, i);
+		const gchar  *replace = NULL;
+		gchar        *dup_replace = NULL;
+
+		switch (segment->type) {
+		case ADIUM_SEGMENT_LITERAL:
+			/* Already escaped */
+			g_string_append (string, segment->text);
 			continue;
+		case ADIUM_SEGMENT_USER_ICON_PATH:
+			replace = avatar_filename;
+			break;
+		case ADIUM_SEGMENT_SENDER_SCREEN_NAME:
+			replace = contact_id;
+			break;
+		case ADIUM_SEGMENT_SENDER:
+			replace = name;
+			break;
+		case ADIUM_SEGMENT_SENDER_COLOR:
+			/* Ensure we always use the same color when sending messages
+			 * (bgo #658821) */
+			if (outgoing) {
+				replace = "inherit";
+			} else if (contact_id != NULL) {
+				guint hash = g_str_hash (contact_id);
+				replace = colors[hash % G_N_ELEMENTS (colors)];
+			}
+			break;
+		case ADIUM_SEGMENT_MESSAGE:
+			replace = message;
+			break;
+		case ADIUM_SEGMENT_TIME:
+			if (is_backlog) {
+				dup_replace = empathy_time_to_string_local (timestamp,
+					segment->text ? segment->text :
+					EMPATHY_TIME_DATE_FORMAT_DISPLAY_SHORT);
+			} else {
+				dup_replace = empathy_time_to_string_local (timestamp,
+					segment->text ? segment->text :
+					EMPATHY_TIME_FORMAT_DISPLAY_SHORT);
+			}
+			replace = dup_replace;
+			break;
+		case ADIUM_SEGMENT_SHORT_TIME:
+			dup_replace = empathy_time_to_string_local (timestamp,
+				EMPATHY_TIME_FORMAT_DISPLAY_SHORT);
+			replace = dup_replace;
+			break;
+		case ADIUM_SEGMENT_SERVICE:
+			replace = service_name;
+			break;
+		case ADIUM_SEGMENT_USER_ICONS:
+			replace = "showIcons";
+			break;
+		case ADIUM_SEGMENT_MESSAGE_CLASSES:
+			replace = message_classes;
+			break;
+		case ADIUM_SEGMENT_NONE:
+			break;
 		}
 
 		/* Here we have a replacement to make */
 		escape_and_append_len (string, replace, -1);
 
 		g_free (dup_replace);
-		g_free (format);
 	}
-	g_string_append (string, "\")");
-
-	script = g_string_free (string, FALSE);
-	webkit_web_view_execute_script (WEBKIT_WEB_VIEW (theme), script);
-	g_free (script);
+	g_string_append (string, "\");\n");
 }
 
 static void
@@ -756,6 +965,7 @@ theme_adium_remove_all_focus_marks (EmpathyThemeAdium *theme)
 
 	priv->has_unread_message = FALSE;
 
+	theme_adium_flush_scripts (theme);
 	dom = webkit_web_view_get_dom_document (WEBKIT_WEB_VIEW (theme));
 	if (dom == NULL) {
 		return;
@@ -773,11 +983,17 @@ theme_adium_remove_all_focus_marks (EmpathyThemeAdium *theme)
 	theme_adium_remove_focus_marks (theme, nodes);
 }
 
+/* Write the script displaying @msg, calling @func or, if it can be joined
+ * with the message from @last_contact before it, @next_func */
 static void
-theme_adium_append_message (EmpathyChatView *view,
-			    EmpathyMessage  *msg)
+theme_adium_write_message (EmpathyThemeAdium *theme,
+			   EmpathyMessage    *msg,
+			   EmpathyContact    *last_contact,
+			   gint64             last_timestamp,
+			   gboolean           last_is_backlog,
+			   const gchar       *func,
+			   const gchar       *next_func)
 {
-	EmpathyThemeAdium     *theme = EMPATHY_THEME_ADIUM (view);
 	EmpathyThemeAdiumPriv *priv = GET_PRIV (theme);
 	EmpathyContact        *sender;
 	TpMessage             *tp_msg;
@@ -789,18 +1005,12 @@ theme_adium_append_message (EmpathyChatView *view,
 	const gchar           *avatar_filename = NULL;
 	gint64                 timestamp;
 	const gchar           *html = NULL;
-	const gchar           *func;
 	const gchar           *service_name;
 	GString               *message_classes = NULL;
 	gboolean               is_backlog;
 	gboolean               consecutive;
 	gboolean               action;
 
-	if (priv->pages_loading != 0) {
-		queue_item (&priv->message_queue, QUEUED_MESSAGE, msg, NULL);
-		return;
-	}
-
 	/* Get information */
 	sender = empathy_message_get_sender (msg);
 	account = empathy_contact_get_account (sender);
@@ -858,9 +1068,9 @@ theme_adium_append_message (EmpathyChatView *view,
 	 * - last message and this message both are/aren't backlog, and
 	 * - DisableCombineConsecutive is not set in theme's settings */
 	is_backlog = empathy_message_is_backlog (msg);
-	consecutive = empathy_contact_equal (priv->last_contact, sender) &&
-		(timestamp - priv->last_timestamp < MESSAGE_JOIN_PERIOD) &&
-		(is_backlog == priv->last_is_backlog) &&
+	consecutive = empathy_contact_equal (last_contact, sender) &&
+		(timestamp - last_timestamp < MESSAGE_JOIN_PERIOD) &&
+		(is_backlog == last_is_backlog) &&
 		!tp_asv_get_boolean (priv->data->info,
 				     "DisableCombineConsecutive", NULL);
 
@@ -917,13 +1127,6 @@ theme_adium_append_message (EmpathyChatView *view,
 		}
 	}
 
-	/* Define javascript function to use */
-	if (consecutive) {
-		func = priv->allow_scrolling ? "appendNextMessage" : "appendNextMessageNoScroll";
-	} else {
-		func = priv->allow_scrolling ? "appendMessage" : "appendMessageNoScroll";
-	}
-
 	if (empathy_contact_is_user (sender)) {
 		/* out */
 		if (is_backlog) {
@@ -933,9 +1136,6 @@ theme_adium_append_message (EmpathyChatView *view,
 			/* content */
 			html = consecutive ? priv->data->out_nextcontent_html : priv->data->out_content_html;
 		}
-
-		/* remove all the unread marks when we are sending a message */
-		theme_adium_remove_all_focus_marks (theme);
 	} else {
 		/* in */
 		if (is_backlog) {
@@ -947,21 +1147,130 @@ theme_adium_append_message (EmpathyChatView *view,
 		}
 	}
 
-	theme_adium_append_html (theme, func, html, body_escaped,
-				 avatar_filename, name, contact_id,
+	theme_adium_append_html (theme, consecutive ? next_func : func, html,
+				 body_escaped, avatar_filename, name, contact_id,
 				 service_name, message_classes->str,
 				 timestamp, is_backlog, empathy_contact_is_user (sender));
 
+	g_free (body_escaped);
+	g_string_free (message_classes, TRUE);
+}
+
+static void
+theme_adium_append_message (EmpathyChatView *view,
+			    EmpathyMessage  *msg)
+{
+	EmpathyThemeAdium     *theme = EMPATHY_THEME_ADIUM (view);
+	EmpathyThemeAdiumPriv *priv = GET_PRIV (theme);
+	EmpathyContact        *sender;
+
+	if (priv->pages_loading != 0) {
+		queue_item (&priv->message_queue, QUEUED_MESSAGE, msg, NULL);
+		return;
+	}
+
+	sender = empathy_message_get_sender (msg);
+
+	/* remove all the unread marks when we are sending a message */
+	if (empathy_contact_is_user (sender)) {
+		theme_adium_remove_all_focus_marks (theme);
+	}
+
+	/* Define javascript function to use */
+	if (priv->allow_scrolling) {
+		theme_adium_write_message (theme, msg, priv->last_contact,
+			priv->last_timestamp, priv->last_is_backlog,
+			"appendMessage", "appendNextMessage");
+	} else {
+		theme_adium_write_message (theme, msg, priv->last_contact,
+			priv->last_timestamp, priv->last_is_backlog,
+			"appendMessageNoScroll", "appendNextMessageNoScroll");
+	}
+
 	/* Keep the sender of the last displayed message */
 	if (priv->last_contact) {
 		g_object_unref (priv->last_contact);
 	}
 	priv->last_contact = g_object_ref (sender);
-	priv->last_timestamp = timestamp;
-	priv->last_is_backlog = is_backlog;
+	priv->last_timestamp = empathy_message_get_timestamp (msg);
+	priv->last_is_backlog = empathy_message_is_backlog (msg);
+}
 
-	g_free (body_escaped);
-	g_string_free (message_classes, TRUE);
+/* The templates only know how to append messages, so older ones are built
+ * in a fragment by those helpers and inserted at the top in one go, keeping
+ * what the user was looking at in place. */
+static const gchar *prepend_script_begin =
+	"(function () {\n"
+	"var chat = document.getElementById(\"Chat\");\n"
+	"var range = document.createRange();\n"
+	"var fragment = document.createDocumentFragment();\n"
+	"range.selectNode(chat);\n"
+	"function removeInsert() {\n"
+	"  var insert = fragment.querySelector(\"#insert\");\n"
+	"  if (insert) insert.parentNode.removeChild(insert);\n"
+	"}\n"
+	"function prependMessage(html) {\n"
+	"  removeInsert();\n"
+	"  fragment.appendChild(range.createContextualFragment(html));\n"
+	"}\n"
+	"function prependNextMessage(html) {\n"
+	"  var node = range.createContextualFragment(html);\n"
+	"  var insert = fragment.querySelector(\"#insert\");\n"
+	"  if (insert) insert.parentNode.replaceChild(node, insert);\n"
+	"  else fragment.appendChild(node);\n"
+	"}\n";
+
+static const gchar *prepend_script_end =
+	"removeInsert();\n"
+	"var height = document.body.scrollHeight;\n"
+	"chat.insertBefore(fragment, chat.firstChild);\n"
+	"alignChat(false);\n"
+	"document.body.scrollTop += document.body.scrollHeight - height;\n"
+	"})()";
+
+static void
+theme_adium_prepend_messages (EmpathyChatView *view,
+			      GList           *messages)
+{
+	EmpathyThemeAdium     *theme = EMPATHY_THEME_ADIUM (view);
+	EmpathyThemeAdiumPriv *priv = GET_PRIV (theme);
+	EmpathyContact        *last_contact = NULL;
+	gint64                 last_timestamp = 0;
+	gboolean               last_is_backlog = FALSE;
+	GList                 *l;
+
+	if (messages == NULL) {
+		return;
+	}
+
+	if (priv->pages_loading != 0) {
+		/* Nothing is displayed yet, so they just go before what
+		 * is already waiting */
+		for (l = g_list_last (messages); l != NULL; l = g_list_previous (l)) {
+			queue_item (&priv->message_queue, QUEUED_MESSAGE,
+				    l->data, NULL);
+			g_queue_push_head (&priv->message_queue,
+					   g_queue_pop_tail (&priv->message_queue));
+		}
+		return;
+	}
+
+	g_string_append (theme_adium_get_script_buffer (theme),
+			 prepend_script_begin);
+
+	for (l = messages; l != NULL; l = g_list_next (l)) {
+		EmpathyMessage *msg = l->data;
+
+		theme_adium_write_message (theme, msg, last_contact,
+			last_timestamp, last_is_backlog,
+			"prependMessage", "prependNextMessage");
+
+		last_contact = empathy_message_get_sender (msg);
+		last_timestamp = empathy_message_get_timestamp (msg);
+		last_is_backlog = empathy_message_is_backlog (msg);
+	}
+
+	theme_adium_execute_script (theme, prepend_script_end);
 }
 
 static void
@@ -1006,6 +1315,7 @@ theme_adium_edit_message (EmpathyChatView *view,
 		empathy_message_get_body (message), NULL);
 
 	/* find the element */
+	theme_adium_flush_scripts (EMPATHY_THEME_ADIUM (view));
 	doc = webkit_web_view_get_dom_document (WEBKIT_WEB_VIEW (view));
 	span = webkit_dom_document_get_element_by_id (doc, id);
 
@@ -1094,12 +1404,13 @@ theme_adium_scroll (EmpathyChatView *view,
 static void
 theme_adium_scroll_down (EmpathyChatView *view)
 {
-	webkit_web_view_execute_script (WEBKIT_WEB_VIEW (view), "alignChat(true);");
+	theme_adium_execute_script (EMPATHY_THEME_ADIUM (view), "alignChat(true)");
 }
 
 static gboolean
 theme_adium_get_has_selection (EmpathyChatView *view)
 {
+	theme_adium_flush_scripts (EMPATHY_THEME_ADIUM (view));
 	return webkit_web_view_has_selection (WEBKIT_WEB_VIEW (view));
 }
 
@@ -1108,6 +1419,11 @@ theme_adium_clear (EmpathyChatView *view)
 {
 	EmpathyThemeAdiumPriv *priv = GET_PRIV (view);
 
+	/* Those were meant for the page we're replacing */
+	if (priv->pending_scripts != NULL) {
+		g_string_truncate (priv->pending_scripts, 0);
+	}
+
 	theme_adium_load_template (EMPATHY_THEME_ADIUM (view));
 
 	/* Clear last contact to avoid trying to add a 'joined'
@@ -1125,6 +1441,7 @@ theme_adium_find_previous (EmpathyChatView *view,
 			   gboolean         match_case)
 {
 	/* FIXME: Doesn't respect new_search */
+	theme_adium_flush_scripts (EMPATHY_THEME_ADIUM (view));
 	return webkit_web_view_search_text (WEBKIT_WEB_VIEW (view),
 					    search_criteria, match_case,
 					    FALSE, TRUE);
@@ -1137,6 +1454,7 @@ theme_adium_find_next (EmpathyChatView *view,
 		       gboolean         match_case)
 {
 	/* FIXME: Doesn't respect new_search */
+	theme_adium_flush_scripts (EMPATHY_THEME_ADIUM (view));
 	return webkit_web_view_search_text (WEBKIT_WEB_VIEW (view),
 					    search_criteria, match_case,
 					    TRUE, TRUE);
@@ -1162,6 +1480,7 @@ theme_adium_highlight (EmpathyChatView *view,
 		       const gchar     *text,
 		       gboolean         match_case)
 {
+	theme_adium_flush_scripts (EMPATHY_THEME_ADIUM (view));
 	webkit_web_view_unmark_text_matches (WEBKIT_WEB_VIEW (view));
 	webkit_web_view_mark_text_matches (WEBKIT_WEB_VIEW (view),
 					   text, match_case, 0);
@@ -1184,6 +1503,7 @@ theme_adium_remove_mark_from_message (EmpathyThemeAdium *self,
 	gchar *class;
 	GError *error = NULL;
 
+	theme_adium_flush_scripts (self);
 	dom = webkit_web_view_get_dom_document (WEBKIT_WEB_VIEW (self));
 	if (dom == NULL) {
 		return;
@@ -1296,6 +1616,7 @@ static void
 theme_adium_iface_init (EmpathyChatViewIface *iface)
 {
 	iface->append_message = theme_adium_append_message;
+	iface->prepend_messages = theme_adium_prepend_messages;
 	iface->append_event = theme_adium_append_event;
 	iface->edit_message = theme_adium_edit_message;
 	iface->scroll = theme_adium_scroll;
@@ -1358,6 +1679,10 @@ theme_adium_finalize (GObject *object)
 
 	empathy_adium_data_unref (priv->data);
 
+	if (priv->pending_scripts != NULL) {
+		g_string_free (priv->pending_scripts, TRUE);
+	}
+
 	g_object_unref (priv->gsettings_chat);
 	g_object_unref (priv->gsettings_desktop);
 
@@ -1384,6 +1709,11 @@ theme_adium_dispose (GObject *object)
 		priv->inspector_window = NULL;
 	}
 
+	if (priv->flush_scripts_id != 0) {
+		g_source_remove (priv->flush_scripts_id);
+		priv->flush_scripts_id = 0;
+	}
+
 	if (priv->acked_messages.length > 0) {
 		g_queue_clear (&priv->acked_messages);
 	}
@@ -1644,9 +1974,9 @@ empathy_theme_adium_set_variant (EmpathyThemeAdium *theme,
 	DEBUG ("Update view with variant: '%s'", variant);
 	variant_path = adium_info_dup_path_for_variant (priv->data->info,
 		priv->variant);
-	script = g_strdup_printf ("setStylesheet(\"mainStyle\",\"%s\");", variant_path);
+	script = g_strdup_printf ("setStylesheet(\"mainStyle\",\"%s\")", variant_path);
 
-	webkit_web_view_execute_script (WEBKIT_WEB_VIEW (theme), script);
+	theme_adium_execute_script (theme, script);
 
 	g_free (variant_path);
 	g_free (script);
@@ -1955,6 +2285,25 @@ empathy_adium_data_new_with_info (const gchar *path, GHashTable *info)
 	g_ptr_array_add (data->strings_to_free, tmp);
 	data->template_html = tmp;
 
+	/* Split the message HTML bits once for all; fallbacks share theirs */
+	data->templates = g_hash_table_new_full (NULL, NULL, NULL,
+		(GDestroyNotify) adium_template_free);
+	{
+		const gchar *htmls[] = { data->content_html,
+			data->in_content_html, data->in_nextcontent_html,
+			data->in_context_html, data->in_nextcontext_html,
+			data->out_content_html, data->out_nextcontent_html,
+			data->out_context_html, data->out_nextcontext_html,
+			data->status_html };
+		guint i;
+
+		for (i = 0; i < G_N_ELEMENTS (htmls); i++) {
+			if (htmls[i] != NULL) {
+				adium_data_get_template (data, htmls[i]);
+			}
+		}
+	}
+
 	g_free (template_html);
 	g_free (footer_html);
 
@@ -1998,6 +2347,7 @@ empathy_adium_data_unref (EmpathyAdiumData *data)
 		g_hash_table_unref (data->info);
 		g_ptr_array_unref (data->strings_to_free);
 		tp_clear_pointer (&data->date_format_cache, g_hash_table_unref);
+		tp_clear_pointer (&data->templates, g_hash_table_unref);
 
 		g_slice_free (EmpathyAdiumData, data);
 	}
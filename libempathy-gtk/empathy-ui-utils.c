@@ -52,6 +52,9 @@
 #include <libempathy/empathy-utils.h>
 #include <libempathy/empathy-ft-factory.h>
 
+/* Budget of the decoded avatars kept around for reuse */
+#define AVATAR_CACHE_MAX_BYTES (4 * 1024 * 1024)
+
 void
 empathy_gtk_init (void)
 {
@@ -467,6 +470,103 @@ avatar_pixbuf_from_loader (GdkPixbufLoader *loader)
 	return pixbuf;
 }
 
+/* Decoded avatars, shared by everything displaying them. Only used from the
+ * main thread.
+ * avatar_cache: owned key -> owned AvatarCacheEntry, see avatar_cache_key()
+ * avatar_cache_lru: the entries, most recently used first */
+typedef struct {
+	gchar *key;
+	GdkPixbuf *pixbuf;
+	gsize size;
+	GList *link;
+} AvatarCacheEntry;
+
+static GHashTable *avatar_cache = NULL;
+static GQueue avatar_cache_lru = G_QUEUE_INIT;
+static gsize avatar_cache_size = 0;
+
+static void
+avatar_cache_entry_free (AvatarCacheEntry *entry)
+{
+	g_object_unref (entry->pixbuf);
+	g_free (entry->key);
+	g_slice_free (AvatarCacheEntry, entry);
+}
+
+/* @token identifies the image, NULL if it can't be cached */
+static gchar *
+avatar_cache_key (const gchar *token,
+		  gint         width,
+		  gint         height)
+{
+	if (token == NULL)
+		return NULL;
+
+	return g_strdup_printf ("%dx%d:%s", width, height, token);
+}
+
+static void
+avatar_cache_remove_entry (AvatarCacheEntry *entry)
+{
+	g_queue_delete_link (&avatar_cache_lru, entry->link);
+	avatar_cache_size -= entry->size;
+	g_hash_table_remove (avatar_cache, entry->key);
+}
+
+/* Return a ref on the cached GdkPixbuf, or NULL */
+static GdkPixbuf *
+avatar_cache_lookup (const gchar *key)
+{
+	AvatarCacheEntry *entry;
+
+	if (key == NULL || avatar_cache == NULL)
+		return NULL;
+
+	entry = g_hash_table_lookup (avatar_cache, key);
+	if (entry == NULL)
+		return NULL;
+
+	g_queue_unlink (&avatar_cache_lru, entry->link);
+	g_queue_push_head_link (&avatar_cache_lru, entry->link);
+
+	return g_object_ref (entry->pixbuf);
+}
+
+static void
+avatar_cache_insert (const gchar *key,
+		     GdkPixbuf   *pixbuf)
+{
+	AvatarCacheEntry *entry;
+	gsize size;
+
+	size = gdk_pixbuf_get_rowstride (pixbuf) *
+		gdk_pixbuf_get_height (pixbuf);
+	if (size > AVATAR_CACHE_MAX_BYTES)
+		return;
+
+	if (avatar_cache == NULL) {
+		avatar_cache = g_hash_table_new_full (g_str_hash, g_str_equal,
+			NULL, (GDestroyNotify) avatar_cache_entry_free);
+	}
+
+	entry = g_hash_table_lookup (avatar_cache, key);
+	if (entry != NULL)
+		avatar_cache_remove_entry (entry);
+
+	entry = g_slice_new (AvatarCacheEntry);
+	entry->key = g_strdup (key);
+	entry->pixbuf = g_object_ref (pixbuf);
+	entry->size = size;
+	g_queue_push_head (&avatar_cache_lru, entry);
+	entry->link = avatar_cache_lru.head;
+
+	g_hash_table_insert (avatar_cache, entry->key, entry);
+	avatar_cache_size += size;
+
+	while (avatar_cache_size > AVATAR_CACHE_MAX_BYTES)
+		avatar_cache_remove_entry (g_queue_peek_tail (&avatar_cache_lru));
+}
+
 GdkPixbuf *
 empathy_pixbuf_from_avatar_scaled (EmpathyAvatar *avatar,
 				  gint          width,
@@ -476,11 +576,29 @@ empathy_pixbuf_from_avatar_scaled (EmpathyAvatar *avatar,
 	GdkPixbufLoader	 *loader;
 	struct SizeData   data;
 	GError           *error = NULL;
+	gchar            *key;
 
 	if (!avatar) {
 		return NULL;
 	}
 
+	if (avatar->filename != NULL) {
+		key = avatar_cache_key (avatar->filename, width, height);
+	} else if (avatar->token != NULL) {
+		gchar *token = g_strconcat ("token:", avatar->token, NULL);
+
+		key = avatar_cache_key (token, width, height);
+		g_free (token);
+	} else {
+		key = NULL;
+	}
+
+	pixbuf = avatar_cache_lookup (key);
+	if (pixbuf != NULL) {
+		g_free (key);
+		return pixbuf;
+	}
+
 	data.width = width;
 	data.height = height;
 	data.preserve_aspect_ratio = TRUE;
@@ -496,13 +614,19 @@ empathy_pixbuf_from_avatar_scaled (EmpathyAvatar *avatar,
 			   "length:%" G_GSIZE_FORMAT " to pixbuf loader: %s",
 			   avatar->data, avatar->len, error->message);
 		g_error_free (error);
+		g_object_unref (loader);
+		g_free (key);
 		return NULL;
 	}
 
 	gdk_pixbuf_loader_close (loader, NULL);
 	pixbuf = avatar_pixbuf_from_loader (loader);
 
+	if (key != NULL && pixbuf != NULL)
+		avatar_cache_insert (key, pixbuf);
+
 	g_object_unref (loader);
+	g_free (key);
 
 	return pixbuf;
 }
@@ -522,177 +646,168 @@ empathy_pixbuf_avatar_from_contact_scaled (EmpathyContact *contact,
 }
 
 typedef struct {
-	FolksIndividual *individual;
 	GSimpleAsyncResult *result;
-	guint width;
-	guint height;
-	struct SizeData size_data;
-	GdkPixbufLoader *loader;
 	GCancellable *cancellable;
-	guint8 data[512];
-} PixbufAvatarFromIndividualClosure;
+} AvatarDecodeWaiter;
 
-static PixbufAvatarFromIndividualClosure *
-pixbuf_avatar_from_individual_closure_new (FolksIndividual    *individual,
-					   GSimpleAsyncResult *result,
-					   gint                width,
-					   gint                height,
-					   GCancellable       *cancellable)
-{
-	PixbufAvatarFromIndividualClosure *closure;
-
-	g_return_val_if_fail (FOLKS_IS_INDIVIDUAL (individual), NULL);
-	g_return_val_if_fail (G_IS_ASYNC_RESULT (result), NULL);
-
-	closure = g_new0 (PixbufAvatarFromIndividualClosure, 1);
-	closure->individual = g_object_ref (individual);
-	closure->result = g_object_ref (result);
-	closure->width = width;
-	closure->height = height;
-	closure->cancellable = g_object_ref (cancellable);
+/* An avatar being decoded in a thread, and the requests waiting for it */
+typedef struct {
+	gchar *key;
+	GLoadableIcon *icon;
+	gint width;
+	gint height;
+	GdkPixbuf *pixbuf;
+	GList *waiters; /* AvatarDecodeWaiter */
+} AvatarDecode;
 
-	return closure;
-}
+/* Cache key -> AvatarDecode */
+static GHashTable *avatar_decodes = NULL;
 
-static void
-pixbuf_avatar_from_individual_closure_free (
-		PixbufAvatarFromIndividualClosure *closure)
+static gchar *
+avatar_token_from_icon (GLoadableIcon *icon)
 {
-	g_object_unref (closure->cancellable);
-	tp_clear_object (&closure->loader);
-	g_object_unref (closure->individual);
-	g_object_unref (closure->result);
-	g_free (closure);
-}
+	GFile *file;
+	gchar *token;
 
-static void
-avatar_icon_load_close_cb (GObject      *object,
-                           GAsyncResult *result,
-                           gpointer      user_data)
-{
-	GError *error = NULL;
+	/* Telepathy keeps the avatars in files named after their token, which
+	 * is also where EmpathyAvatar's filename points to */
+	if (!G_IS_FILE_ICON (icon))
+		return NULL;
 
-	g_input_stream_close_finish (G_INPUT_STREAM (object), result, &error);
+	file = g_file_icon_get_file (G_FILE_ICON (icon));
+	token = g_file_get_path (file);
+	if (token == NULL)
+		token = g_file_get_uri (file);
 
-	if (error != NULL) {
-		DEBUG ("Failed to close pixbuf stream: %s", error->message);
-		g_error_free (error);
-	}
+	return token;
 }
 
-static void
-avatar_icon_load_read_cb (GObject      *object,
-                          GAsyncResult *result,
-                          gpointer      user_data)
+static GdkPixbuf *
+avatar_pixbuf_from_stream (GInputStream  *stream,
+			   gint           width,
+			   gint           height,
+			   GError       **error)
 {
-	GInputStream *stream = G_INPUT_STREAM (object);
-	PixbufAvatarFromIndividualClosure *closure = user_data;
+	GdkPixbufLoader *loader;
+	GdkPixbuf *pixbuf = NULL;
+	struct SizeData size_data;
+	guint8 data[4096];
 	gssize n_read;
-	GError *error = NULL;
 
-	/* Finish reading this chunk from the stream */
-	n_read = g_input_stream_read_finish (stream, result, &error);
-	if (error != NULL) {
-		DEBUG ("Failed to finish read from pixbuf stream: %s",
-			error->message);
-		g_simple_async_result_set_from_error (closure->result, error);
-		goto out_close;
-	}
+	size_data.width = width;
+	size_data.height = height;
+	size_data.preserve_aspect_ratio = TRUE;
 
-	/* Write the chunk to the pixbuf loader */
-	if (!gdk_pixbuf_loader_write (closure->loader, (guchar *) closure->data,
-			n_read, &error)) {
-		DEBUG ("Failed to write to pixbuf loader: %s",
-			error ? error->message : "No error given");
-		g_simple_async_result_set_from_error (closure->result, error);
-		goto out_close;
-	}
+	loader = gdk_pixbuf_loader_new ();
+	g_signal_connect (loader, "size-prepared",
+			  G_CALLBACK (pixbuf_from_avatar_size_prepared_cb),
+			  &size_data);
 
-	if (n_read == 0) {
-		/* EOF? */
-		if (!gdk_pixbuf_loader_close (closure->loader, &error)) {
-			DEBUG ("Failed to close pixbuf loader: %s",
-				error ? error->message : "No error given");
-			g_simple_async_result_set_from_error (closure->result, error);
+	do {
+		n_read = g_input_stream_read (stream, data, sizeof (data),
+					      NULL, error);
+		if (n_read < 0 ||
+		    !gdk_pixbuf_loader_write (loader, data, n_read, error)) {
+			/* We must close the pixbuf loader before unreffing
+			 * it. */
+			gdk_pixbuf_loader_close (loader, NULL);
 			goto out;
 		}
+	} while (n_read > 0);
 
-		/* We're done. */
-		g_simple_async_result_set_op_res_gpointer (closure->result,
-			avatar_pixbuf_from_loader (closure->loader),
-			g_object_unref);
-
+	if (!gdk_pixbuf_loader_close (loader, error))
 		goto out;
-	} else {
-		/* Loop round and read another chunk. */
-		g_input_stream_read_async (stream, closure->data,
-			G_N_ELEMENTS (closure->data),
-			G_PRIORITY_DEFAULT, closure->cancellable,
-			avatar_icon_load_read_cb, closure);
 
-		return;
-	}
-
-out_close:
-	/* We must close the pixbuf loader before unreffing it. */
-	gdk_pixbuf_loader_close (closure->loader, NULL);
+	if (gdk_pixbuf_loader_get_pixbuf (loader) != NULL)
+		pixbuf = avatar_pixbuf_from_loader (loader);
 
 out:
-	/* Close the file for safety (even though it should be
-	 * automatically closed when the stream is finalised). */
-	g_input_stream_close_async (stream, G_PRIORITY_DEFAULT, NULL,
-		(GAsyncReadyCallback) avatar_icon_load_close_cb, NULL);
-
-	g_simple_async_result_complete (closure->result);
+	g_object_unref (loader);
 
-	g_clear_error (&error);
-	pixbuf_avatar_from_individual_closure_free (closure);
+	return pixbuf;
 }
 
+/* Runs in a thread of GIO's pool; only touches the AvatarDecode, which the
+ * main thread leaves alone until the decode is done */
 static void
-avatar_icon_load_cb (GObject      *object,
-                     GAsyncResult *result,
-                     gpointer      user_data)
+avatar_decode_thread_func (GSimpleAsyncResult *simple,
+			   GObject            *object,
+			   GCancellable       *cancellable)
 {
-	GLoadableIcon *icon = G_LOADABLE_ICON (object);
-	PixbufAvatarFromIndividualClosure *closure = user_data;
+	AvatarDecode *decode = g_simple_async_result_get_op_res_gpointer (simple);
 	GInputStream *stream;
 	GError *error = NULL;
 
-	stream = g_loadable_icon_load_finish (icon, result, NULL, &error);
-	if (error != NULL) {
+	stream = g_loadable_icon_load (decode->icon, decode->width, NULL,
+				       NULL, &error);
+	if (stream == NULL) {
 		DEBUG ("Failed to open avatar stream: %s", error->message);
-		g_simple_async_result_set_from_error (closure->result, error);
-		goto out;
+		g_simple_async_result_set_from_error (simple, error);
+		g_error_free (error);
+		return;
 	}
 
-	closure->size_data.width = closure->width;
-	closure->size_data.height = closure->height;
-	closure->size_data.preserve_aspect_ratio = TRUE;
-
-	/* Load the data into a pixbuf loader in chunks. */
-	closure->loader = gdk_pixbuf_loader_new ();
-
-	g_signal_connect (closure->loader, "size-prepared",
-			  G_CALLBACK (pixbuf_from_avatar_size_prepared_cb),
-	                  &(closure->size_data));
-
-	/* Begin to read the first chunk. */
-	g_input_stream_read_async (stream, closure->data,
-			G_N_ELEMENTS (closure->data),
-			G_PRIORITY_DEFAULT, closure->cancellable,
-			avatar_icon_load_read_cb, closure);
+	decode->pixbuf = avatar_pixbuf_from_stream (stream, decode->width,
+						    decode->height, &error);
+	if (error != NULL) {
+		DEBUG ("Failed to decode avatar: %s", error->message);
+		g_simple_async_result_set_from_error (simple, error);
+		g_error_free (error);
+	}
 
+	g_input_stream_close (stream, NULL, NULL);
 	g_object_unref (stream);
+}
 
-	return;
+static void
+avatar_decode_done_cb (GObject      *source,
+		       GAsyncResult *result,
+		       gpointer      user_data)
+{
+	AvatarDecode *decode = user_data;
+	GError *error = NULL;
+	GList *l;
+
+	g_simple_async_result_propagate_error (G_SIMPLE_ASYNC_RESULT (result),
+					       &error);
+
+	if (decode->key != NULL) {
+		if (decode->pixbuf != NULL)
+			avatar_cache_insert (decode->key, decode->pixbuf);
+		g_hash_table_remove (avatar_decodes, decode->key);
+	}
+
+	for (l = decode->waiters; l != NULL; l = l->next) {
+		AvatarDecodeWaiter *waiter = l->data;
+		GError *cancelled = NULL;
+
+		if (g_cancellable_set_error_if_cancelled (waiter->cancellable,
+							  &cancelled)) {
+			g_simple_async_result_set_from_error (waiter->result,
+							      cancelled);
+			g_error_free (cancelled);
+		} else if (error != NULL) {
+			g_simple_async_result_set_from_error (waiter->result,
+							      error);
+		} else if (decode->pixbuf != NULL) {
+			g_simple_async_result_set_op_res_gpointer (
+				waiter->result, g_object_ref (decode->pixbuf),
+				g_object_unref);
+		}
 
-out:
-	g_simple_async_result_complete (closure->result);
+		g_simple_async_result_complete (waiter->result);
+
+		g_object_unref (waiter->result);
+		tp_clear_object (&waiter->cancellable);
+		g_slice_free (AvatarDecodeWaiter, waiter);
+	}
 
 	g_clear_error (&error);
-	tp_clear_object (&stream);
-	pixbuf_avatar_from_individual_closure_free (closure);
+	g_list_free (decode->waiters);
+	tp_clear_object (&decode->pixbuf);
+	g_object_unref (decode->icon);
+	g_free (decode->key);
+	g_slice_free (AvatarDecode, decode);
 }
 
 void
@@ -706,7 +821,11 @@ empathy_pixbuf_avatar_from_individual_scaled_async (
 {
 	GLoadableIcon *avatar_icon;
 	GSimpleAsyncResult *result;
-	PixbufAvatarFromIndividualClosure *closure;
+	GdkPixbuf *pixbuf;
+	AvatarDecode *decode = NULL;
+	AvatarDecodeWaiter *waiter;
+	gchar *token;
+	gchar *key;
 
 	result = g_simple_async_result_new (G_OBJECT (individual),
 			callback, user_data,
@@ -714,26 +833,94 @@ empathy_pixbuf_avatar_from_individual_scaled_async (
 
 	avatar_icon =
 		folks_avatar_details_get_avatar (FOLKS_AVATAR_DETAILS (individual));
-	if (avatar_icon == NULL)
-		goto out;
+	if (avatar_icon == NULL) {
+		g_simple_async_result_set_op_res_gpointer (result, NULL, NULL);
+		g_simple_async_result_complete (result);
+		g_object_unref (result);
+		return;
+	}
 
-	closure = pixbuf_avatar_from_individual_closure_new (individual, result,
-							     width, height,
-							     cancellable);
-	if (closure == NULL)
-		goto out;
+	token = avatar_token_from_icon (avatar_icon);
+	key = avatar_cache_key (token, width, height);
+	g_free (token);
 
-	g_loadable_icon_load_async (avatar_icon, width, cancellable,
-			avatar_icon_load_cb, closure);
+	pixbuf = avatar_cache_lookup (key);
+	if (pixbuf != NULL) {
+		g_simple_async_result_set_op_res_gpointer (result, pixbuf,
+							   g_object_unref);
+		g_simple_async_result_complete_in_idle (result);
+		g_object_unref (result);
+		g_free (key);
+		return;
+	}
 
-	g_object_unref (result);
+	/* Requests for the same avatar at the same size share one decode */
+	if (key != NULL && avatar_decodes != NULL)
+		decode = g_hash_table_lookup (avatar_decodes, key);
 
-	return;
+	if (decode == NULL) {
+		GSimpleAsyncResult *simple;
 
-out:
-	g_simple_async_result_set_op_res_gpointer (result, NULL, NULL);
-	g_simple_async_result_complete (result);
-	g_object_unref (result);
+		decode = g_slice_new0 (AvatarDecode);
+		decode->key = key;
+		decode->icon = g_object_ref (avatar_icon);
+		decode->width = width;
+		decode->height = height;
+
+		if (key != NULL) {
+			if (avatar_decodes == NULL)
+				avatar_decodes = g_hash_table_new (g_str_hash,
+								   g_str_equal);
+			g_hash_table_insert (avatar_decodes, key, decode);
+		}
+
+		simple = g_simple_async_result_new (NULL,
+				avatar_decode_done_cb, decode,
+				avatar_decode_thread_func);
+		g_simple_async_result_set_op_res_gpointer (simple, decode, NULL);
+		g_simple_async_result_run_in_thread (simple,
+				avatar_decode_thread_func, G_PRIORITY_DEFAULT,
+				NULL);
+		g_object_unref (simple);
+	} else {
+		g_free (key);
+	}
+
+	waiter = g_slice_new (AvatarDecodeWaiter);
+	waiter->result = result;
+	waiter->cancellable = cancellable != NULL ?
+		g_object_ref (cancellable) : NULL;
+	decode->waiters = g_list_prepend (decode->waiters, waiter);
+}
+
+/* Return a ref on the GdkPixbuf if the avatar of @individual at this size is
+ * in the cache, without loading it otherwise */
+GdkPixbuf *
+empathy_pixbuf_avatar_from_individual_scaled_cached (
+		FolksIndividual *individual,
+		gint             width,
+		gint             height)
+{
+	GLoadableIcon *avatar_icon;
+	GdkPixbuf *pixbuf;
+	gchar *token;
+	gchar *key;
+
+	g_return_val_if_fail (FOLKS_IS_INDIVIDUAL (individual), NULL);
+
+	avatar_icon =
+		folks_avatar_details_get_avatar (FOLKS_AVATAR_DETAILS (individual));
+	if (avatar_icon == NULL)
+		return NULL;
+
+	token = avatar_token_from_icon (avatar_icon);
+	key = avatar_cache_key (token, width, height);
+	pixbuf = avatar_cache_lookup (key);
+
+	g_free (token);
+	g_free (key);
+
+	return pixbuf;
 }
 
 /* Return a ref on the GdkPixbuf */
@@ -2032,6 +2219,32 @@ empathy_get_current_action_time (void)
   return (tp_user_action_time_from_x11 (gtk_get_current_event_time ()));
 }
 
+/* Whether @text is a prefix of @id, or @words prefixes of the words of the
+ * part of @id before the '@'. Those are cached on @owner. */
+static gboolean
+individual_match_id (GObject *owner,
+    const gchar *id,
+    const char *text,
+    GPtrArray *words)
+{
+  const gchar *p;
+
+  if (id == NULL)
+    return FALSE;
+
+  /* Accept @id if @text is a full prefix of it; that allows user to find,
+   * say, a jabber contact by typing his JID. */
+  if (g_str_has_prefix (id, text))
+    return TRUE;
+
+  p = strstr (id, "@");
+
+  return empathy_live_search_match_stripped_words (
+      empathy_live_search_get_cached_words (owner, id,
+          p != NULL ? p - id : -1),
+      words);
+}
+
 /* @words = empathy_live_search_strip_utf8_string (@text);
  *
  * User has to pass both so we don't have to compute @words ourself each time
@@ -2043,13 +2256,19 @@ empathy_individual_match_string (FolksIndividual *individual,
 {
   const gchar *str;
   GeeSet *personas;
+  GeeSet *addresses;
   GeeIterator *iter;
+  gchar *number;
   gboolean retval = FALSE;
 
-  /* check alias name */
+  /* check alias name. The stripped words of the alias and of each persona's
+   * ID are cached on the objects, so they are only computed again when they
+   * change rather than for each key stroke. */
   str = folks_alias_details_get_alias (FOLKS_ALIAS_DETAILS (individual));
 
-  if (empathy_live_search_match_words (str, words))
+  if (empathy_live_search_match_stripped_words (
+          empathy_live_search_get_cached_words (G_OBJECT (individual), str, -1),
+          words))
     return TRUE;
 
   personas = folks_individual_get_personas (individual);
@@ -2059,39 +2278,60 @@ empathy_individual_match_string (FolksIndividual *individual,
   while (retval == FALSE && gee_iterator_next (iter))
     {
       FolksPersona *persona = gee_iterator_get (iter);
-      const gchar *p;
 
       if (empathy_folks_persona_is_interesting (persona))
         {
-          str = folks_persona_get_display_id (persona);
-
-          /* Accept the persona if @text is a full prefix of his ID; that allows
-           * user to find, say, a jabber contact by typing his JID. */
-          if (g_str_has_prefix (str, text))
-            {
-              retval = TRUE;
-            }
-          else
-            {
-              gchar *dup_str = NULL;
-              gboolean visible;
-
-              p = strstr (str, "@");
-              if (p != NULL)
-                str = dup_str = g_strndup (str, p - str);
-
-              visible = empathy_live_search_match_words (str, words);
-              g_free (dup_str);
-              if (visible)
-                retval = TRUE;
-            }
+          retval = individual_match_id (G_OBJECT (persona),
+              folks_persona_get_display_id (persona), text, words);
         }
       g_clear_object (&persona);
     }
   g_clear_object (&iter);
 
-  /* FIXME: Add more rules here, we could check phone numbers in
-   * contact's vCard for example. */
+  if (retval)
+    return TRUE;
+
+  /* check e-mail addresses the same way */
+  addresses = folks_email_details_get_email_addresses (
+      FOLKS_EMAIL_DETAILS (individual));
+
+  iter = gee_iterable_iterator (GEE_ITERABLE (addresses));
+  while (retval == FALSE && gee_iterator_next (iter))
+    {
+      FolksAbstractFieldDetails *details = gee_iterator_get (iter);
+
+      retval = individual_match_id (G_OBJECT (details),
+          folks_abstract_field_details_get_value (details), text, words);
+
+      g_clear_object (&details);
+    }
+  g_clear_object (&iter);
+
+  if (retval)
+    return TRUE;
+
+  /* check phone numbers, however they are written */
+  number = empathy_live_search_strip_phone_number (text);
+  if (number == NULL)
+    return FALSE;
+
+  iter = gee_iterable_iterator (GEE_ITERABLE (
+      folks_phone_details_get_phone_numbers (FOLKS_PHONE_DETAILS (individual))));
+  while (retval == FALSE && gee_iterator_next (iter))
+    {
+      FolksPhoneFieldDetails *details = gee_iterator_get (iter);
+      gchar *normalised;
+
+      normalised = folks_phone_field_details_get_normalised (details);
+      retval = g_str_has_prefix (normalised, number);
+
+      g_free (normalised);
+      g_clear_object (&details);
+    }
+  g_clear_object (&iter);
+
+  g_free (number);
+
   return retval;
 }
 
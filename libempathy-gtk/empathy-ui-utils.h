@@ -88,6 +88,10 @@ GdkPixbuf * empathy_pixbuf_avatar_from_individual_scaled_finish (
 							 FolksIndividual  *individual,
 							 GAsyncResult     *result,
 							 GError          **error);
+GdkPixbuf * empathy_pixbuf_avatar_from_individual_scaled_cached (
+							 FolksIndividual  *individual,
+							 gint              width,
+							 gint              height);
 GdkPixbuf *   empathy_pixbuf_from_avatar_scaled         (EmpathyAvatar    *avatar,
 							 gint              width,
 							 gint              height);
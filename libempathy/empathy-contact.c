@@ -59,6 +59,10 @@ typedef struct {
   gchar *alias;
   gchar *logged_alias;
   EmpathyAvatar *avatar;
+  /* Avatar file to load the first time the avatar is asked for, and its
+   * mime type */
+  gchar *avatar_file;
+  gchar *avatar_mime;
   TpConnectionPresenceType presence;
   guint handle;
   EmpathyCapabilities capabilities;
@@ -98,9 +102,14 @@ static void set_capabilities_from_tp_caps (EmpathyContact *self,
 static void contact_set_avatar (EmpathyContact *contact,
     EmpathyAvatar *avatar);
 static void contact_set_avatar_from_tp_contact (EmpathyContact *contact);
-static gboolean contact_load_avatar_cache (EmpathyContact *contact,
+static void contact_load_avatar_cache (EmpathyContact *contact,
     const gchar *token);
 
+/* The avatars mapped from the Telepathy avatar cache, shared by all contacts
+ * having the same one.
+ * Hash: filename -> EmpathyAvatar*, removed when the avatar is freed */
+static GHashTable *mapped_avatars = NULL;
+
 G_DEFINE_TYPE (EmpathyContact, empathy_contact, G_TYPE_OBJECT);
 
 enum
@@ -438,6 +447,8 @@ contact_finalize (GObject *object)
   g_clear_object (&priv->groups);
   g_free (priv->alias);
   g_free (priv->id);
+  g_free (priv->avatar_file);
+  g_free (priv->avatar_mime);
   g_strfreev (priv->client_types);
 
   G_OBJECT_CLASS (empathy_contact_parent_class)->finalize (object);
@@ -887,6 +898,87 @@ empathy_contact_change_group (EmpathyContact *contact, const gchar *group,
   gee_collection_add (GEE_COLLECTION (priv->groups), group);
 }
 
+/* Return a new ref on the avatar stored in @filename, mapping it if it's not
+ * mapped yet, or %NULL if it can't be read */
+static EmpathyAvatar *
+avatar_new_from_file (const gchar *filename,
+                      const gchar *format)
+{
+  EmpathyAvatar *avatar;
+  GMappedFile *mapped_file;
+  GError *error = NULL;
+
+  if (mapped_avatars != NULL)
+    {
+      avatar = g_hash_table_lookup (mapped_avatars, filename);
+      if (avatar != NULL)
+        {
+          if (avatar->format == NULL)
+            avatar->format = g_strdup (format);
+
+          return empathy_avatar_ref (avatar);
+        }
+    }
+
+  /* Telepathy never rewrites an avatar file in place, a new token gets a new
+   * file, so the mapping stays valid */
+  mapped_file = g_mapped_file_new (filename, FALSE, &error);
+  if (mapped_file == NULL)
+    {
+      DEBUG ("Failed to load avatar from %s: %s", filename, error->message);
+      g_error_free (error);
+      return NULL;
+    }
+
+  if (g_mapped_file_get_length (mapped_file) == 0)
+    {
+      g_mapped_file_unref (mapped_file);
+      return NULL;
+    }
+
+  DEBUG ("Avatar mapped from %s", filename);
+
+  avatar = g_slice_new0 (EmpathyAvatar);
+  avatar->data = (guchar *) g_mapped_file_get_contents (mapped_file);
+  avatar->len = g_mapped_file_get_length (mapped_file);
+  avatar->format = g_strdup (format);
+  avatar->filename = g_strdup (filename);
+  avatar->refcount = 1;
+  avatar->mapped_file = mapped_file;
+
+  if (mapped_avatars == NULL)
+    mapped_avatars = g_hash_table_new (g_str_hash, g_str_equal);
+
+  g_hash_table_insert (mapped_avatars, avatar->filename, avatar);
+
+  return avatar;
+}
+
+/* Replace the avatar of @contact by the one stored in @filename, which will
+ * only be read when it's needed */
+static void
+contact_set_avatar_file (EmpathyContact *contact,
+                         const gchar *filename,
+                         const gchar *format)
+{
+  EmpathyContactPriv *priv = GET_PRIV (contact);
+
+  if (priv->avatar != NULL && priv->avatar->mapped_file != NULL &&
+      !tp_strdiff (priv->avatar->filename, filename))
+    return;
+
+  if (!tp_strdiff (priv->avatar_file, filename))
+    return;
+
+  tp_clear_pointer (&priv->avatar, empathy_avatar_unref);
+  g_free (priv->avatar_file);
+  priv->avatar_file = g_strdup (filename);
+  g_free (priv->avatar_mime);
+  priv->avatar_mime = g_strdup (format);
+
+  g_object_notify (G_OBJECT (contact), "avatar");
+}
+
 EmpathyAvatar *
 empathy_contact_get_avatar (EmpathyContact *contact)
 {
@@ -896,6 +988,15 @@ empathy_contact_get_avatar (EmpathyContact *contact)
 
   priv = GET_PRIV (contact);
 
+  if (priv->avatar == NULL && priv->avatar_file != NULL)
+    {
+      priv->avatar = avatar_new_from_file (priv->avatar_file,
+          priv->avatar_mime);
+
+      tp_clear_pointer (&priv->avatar_file, g_free);
+      tp_clear_pointer (&priv->avatar_mime, g_free);
+    }
+
   return priv->avatar;
 }
 
@@ -909,6 +1010,9 @@ contact_set_avatar (EmpathyContact *contact,
 
   priv = GET_PRIV (contact);
 
+  tp_clear_pointer (&priv->avatar_file, g_free);
+  tp_clear_pointer (&priv->avatar_mime, g_free);
+
   if (priv->avatar == avatar)
     return;
 
@@ -1324,70 +1428,63 @@ static gchar *
 contact_get_avatar_filename (EmpathyContact *contact,
                              const gchar *token)
 {
+  /* Hash: "cm/protocol" -> owned directory of its avatars */
+  static GHashTable *avatar_dirs = NULL;
   TpAccount *account;
-  gchar *avatar_path;
+  const gchar *cm, *protocol;
+  const gchar *avatar_path;
+  gchar *key;
   gchar *avatar_file;
   gchar *token_escaped;
 
   if (EMP_STR_EMPTY (empathy_contact_get_id (contact)))
     return NULL;
 
-  token_escaped = tp_escape_as_identifier (token);
   account = empathy_contact_get_account (contact);
+  cm = tp_account_get_connection_manager (account);
+  protocol = tp_account_get_protocol (account);
 
-  avatar_path = g_build_filename (g_get_user_cache_dir (),
-      "telepathy",
-      "avatars",
-      tp_account_get_connection_manager (account),
-      tp_account_get_protocol (account),
-      NULL);
-  g_mkdir_with_parents (avatar_path, 0700);
+  if (avatar_dirs == NULL)
+    avatar_dirs = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+        g_free);
 
-  avatar_file = g_build_filename (avatar_path, token_escaped, NULL);
+  key = g_strdup_printf ("%s/%s", cm, protocol);
+  avatar_path = g_hash_table_lookup (avatar_dirs, key);
+  if (avatar_path == NULL)
+    {
+      /* We only read from there, it's Telepathy which creates it */
+      avatar_path = g_build_filename (g_get_user_cache_dir (),
+          "telepathy", "avatars", cm, protocol, NULL);
+      g_hash_table_insert (avatar_dirs, key, (gchar *) avatar_path);
+    }
+  else
+    {
+      g_free (key);
+    }
 
+  token_escaped = tp_escape_as_identifier (token);
+  avatar_file = g_build_filename (avatar_path, token_escaped, NULL);
   g_free (token_escaped);
-  g_free (avatar_path);
 
   return avatar_file;
 }
 
-static gboolean
+static void
 contact_load_avatar_cache (EmpathyContact *contact,
                            const gchar *token)
 {
-  EmpathyAvatar *avatar = NULL;
   gchar *filename;
-  gchar *data = NULL;
-  gsize len;
-  GError *error = NULL;
 
-  g_return_val_if_fail (EMPATHY_IS_CONTACT (contact), FALSE);
-  g_return_val_if_fail (!EMP_STR_EMPTY (token), FALSE);
+  g_return_if_fail (EMPATHY_IS_CONTACT (contact));
+  g_return_if_fail (!EMP_STR_EMPTY (token));
 
-  /* Load the avatar from file if it exists */
+  /* The file is read the first time the avatar is needed; if it doesn't
+   * exist the contact simply has no avatar */
   filename = contact_get_avatar_filename (contact, token);
-  if (filename && g_file_test (filename, G_FILE_TEST_EXISTS))
-    {
-      if (!g_file_get_contents (filename, &data, &len, &error))
-        {
-          DEBUG ("Failed to load avatar from cache: %s",
-            error ? error->message : "No error given");
-          g_clear_error (&error);
-        }
-    }
+  if (filename != NULL)
+    contact_set_avatar_file (contact, filename, NULL);
 
-  if (data != NULL)
-    {
-      DEBUG ("Avatar loaded from %s", filename);
-      avatar = empathy_avatar_new ((guchar *) data, len, NULL, filename);
-      contact_set_avatar (contact, avatar);
-      empathy_avatar_unref (avatar);
-    }
-
-  g_free (data);
   g_free (filename);
-
-  return data != NULL;
 }
 
 GType
@@ -1442,7 +1539,16 @@ empathy_avatar_unref (EmpathyAvatar *avatar)
   avatar->refcount--;
   if (avatar->refcount == 0)
     {
-      g_free (avatar->data);
+      if (avatar->mapped_file != NULL)
+        {
+          g_hash_table_remove (mapped_avatars, avatar->filename);
+          g_mapped_file_unref (avatar->mapped_file);
+        }
+      else
+        {
+          g_free (avatar->data);
+        }
+
       g_free (avatar->format);
       g_free (avatar->filename);
       g_slice_free (EmpathyAvatar, avatar);
@@ -1808,29 +1914,18 @@ contact_set_avatar_from_tp_contact (EmpathyContact *contact)
 
   if (file != NULL)
     {
-      EmpathyAvatar *avatar;
-      gchar *data;
-      gsize len;
       gchar *path;
-      GError *error = NULL;
 
-      if (!g_file_load_contents (file, NULL, &data, &len, NULL, &error))
+      path = g_file_get_path (file);
+      if (path == NULL)
         {
-          DEBUG ("Failed to load avatar: %s", error->message);
-
-          g_error_free (error);
+          DEBUG ("Avatar file isn't local");
           contact_set_avatar (contact, NULL);
           return;
         }
 
-      path = g_file_get_path (file);
-
-      avatar = empathy_avatar_new ((guchar *) data, len, mime, path);
-
-      contact_set_avatar (contact, avatar);
-      empathy_avatar_unref (avatar);
+      contact_set_avatar_file (contact, path, mime);
       g_free (path);
-      g_free (data);
     }
   else
     {
@@ -59,6 +59,8 @@ typedef struct {
   gchar *token;
   gchar *filename;
   guint refcount;
+  /* private: maps the file data points to, if any */
+  GMappedFile *mapped_file;
 } EmpathyAvatar;
 
 typedef enum {
@@ -29,9 +29,9 @@
 #include <telepathy-glib/interfaces.h>
 
 #include "empathy-ft-handler.h"
+#include "empathy-ft-hash.h"
 #include "empathy-tp-contact-factory.h"
 #include "empathy-marshal.h"
-#include "empathy-time.h"
 #include "empathy-utils.h"
 
 #define DEBUG_FLAG EMPATHY_DEBUG_FT
@@ -74,7 +74,14 @@ G_DEFINE_TYPE (EmpathyFTHandler, empathy_ft_handler, G_TYPE_OBJECT)
 
 #define GET_PRIV(obj) EMPATHY_GET_PRIV (obj, EmpathyFTHandler)
 
-#define BUFFER_SIZE 4096
+/* Default maximum number of ::transfer-progress emissions per second and
+ * per handler, see empathy_ft_handler_set_max_progress_rate() */
+#define PROGRESS_DEFAULT_RATE 4
+
+/* Time constant of the moving average of the speed, and minimum interval
+ * between two samples, in microseconds */
+#define SPEED_TIME_CONSTANT (3 * G_USEC_PER_SEC)
+#define SPEED_MIN_INTERVAL (G_USEC_PER_SEC / 4)
 
 enum {
   PROP_TP_FILE = 1,
@@ -99,16 +106,6 @@ enum {
   LAST_SIGNAL
 };
 
-typedef struct {
-  GInputStream *stream;
-  GError *error /* comment to make the style checker happy */;
-  guchar *buffer;
-  GChecksum *checksum;
-  gssize total_read;
-  guint64 total_bytes;
-  EmpathyFTHandler *handler;
-} HashingData;
-
 typedef struct {
   EmpathyFTHandlerReadyCallback callback;
   gpointer user_data;
@@ -137,19 +134,29 @@ typedef struct {
   guint64 mtime;
   gchar *content_hash;
   TpFileHashType content_hash_type;
+  /* identifies the version of an outgoing file, for the hash cache */
+  gchar *file_id;
 
   /* time and speed */
   gdouble speed;
   guint remaining_time;
+  /* monotonic time and transferred bytes of the last speed sample */
   gint64 last_update_time;
+  guint64 last_update_bytes;
+  /* TRUE if the handler is in progress_pending */
+  gboolean progress_pending;
 
   gboolean is_completed;
 } EmpathyFTHandlerPriv;
 
 static guint signals[LAST_SIGNAL] = { 0 };
 
-static gboolean do_hash_job_incoming (GIOSchedulerJob *job,
-    GCancellable *cancellable, gpointer user_data);
+/* Progress of all the transfers is reported from a single timeout, so
+ * that concurrent transfers are repainted together and at a bounded rate
+ * however often the connection managers report their progress */
+static GList *progress_pending = NULL;
+static guint progress_timeout_id = 0;
+static guint progress_max_rate = PROGRESS_DEFAULT_RATE;
 
 /* GObject implementations */
 static void
@@ -246,6 +253,12 @@ do_dispose (GObject *object)
 
   priv->dispose_run = TRUE;
 
+  if (priv->progress_pending)
+    {
+      progress_pending = g_list_remove (progress_pending, object);
+      priv->progress_pending = FALSE;
+    }
+
   if (priv->contact != NULL) {
     g_object_unref (priv->contact);
     priv->contact = NULL;
@@ -295,6 +308,9 @@ do_finalize (GObject *object)
   g_free (priv->content_hash);
   priv->content_hash = NULL;
 
+  g_free (priv->file_id);
+  priv->file_id = NULL;
+
   G_OBJECT_CLASS (empathy_ft_handler_parent_class)->finalize (object);
 }
 
@@ -468,10 +484,11 @@ empathy_ft_handler_class_init (EmpathyFTHandlerClass *klass)
    * @total_bytes: the total bytes of the handler
    * @remaining_time: the number of seconds remaining for the transfer
    * to be completed
-   * @speed: the current speed of the transfer (in KB/s)
+   * @speed: the current speed of the transfer (in bytes per second)
    *
    * This signal is emitted to notify clients of the progress of the
-   * transfer.
+   * transfer. It is emitted at most a few times per second, see
+   * empathy_ft_handler_set_max_progress_rate().
    */
   signals[TRANSFER_PROGRESS] =
     g_signal_new ("transfer-progress", G_TYPE_FROM_CLASS (klass),
@@ -539,70 +556,56 @@ empathy_ft_handler_init (EmpathyFTHandler *self)
 
 /* private functions */
 
-static void
-hash_data_free (HashingData *data)
-{
-  g_free (data->buffer);
-
-  if (data->stream != NULL)
-    g_object_unref (data->stream);
-
-  if (data->checksum != NULL)
-    g_checksum_free (data->checksum);
+static void ft_handler_hash_ready (EmpathyFTHandler *handler,
+    const gchar *hash);
+static void ft_handler_hash_file_cb (GObject *source,
+    GAsyncResult *result, gpointer user_data);
+static void ft_handler_hash_progress_cb (guint64 hashed_bytes,
+    gpointer user_data);
+static void ft_handler_emit_progress (EmpathyFTHandler *handler);
 
-  if (data->error != NULL)
-    g_error_free (data->error);
-
-  if (data->handler != NULL)
-    g_object_unref (data->handler);
-
-  g_slice_free (HashingData, data);
-}
-
-static GChecksumType
-tp_file_hash_to_g_checksum (TpFileHashType type)
+static void
+ft_handler_start_hashing (EmpathyFTHandler *handler)
 {
-  GChecksumType retval;
+  EmpathyFTHandlerPriv *priv = GET_PRIV (handler);
 
-  switch (type)
-    {
-      case TP_FILE_HASH_TYPE_MD5:
-        retval = G_CHECKSUM_MD5;
-        break;
-      case TP_FILE_HASH_TYPE_SHA1:
-        retval = G_CHECKSUM_SHA1;
-        break;
-      case TP_FILE_HASH_TYPE_SHA256:
-        retval = G_CHECKSUM_SHA256;
-        break;
-      case TP_FILE_HASH_TYPE_NONE:
-      default:
-        g_assert_not_reached ();
-        break;
-    }
+  g_signal_emit (handler, signals[HASHING_STARTED], 0);
 
-  return retval;
+  empathy_ft_hash_file_async (priv->gfile, priv->file_id,
+      priv->content_hash_type, priv->cancellable,
+      ft_handler_hash_progress_cb, g_object_ref (handler), g_object_unref,
+      ft_handler_hash_file_cb, g_object_ref (handler));
 }
 
 static void
 check_hash_incoming (EmpathyFTHandler *handler)
 {
-  HashingData *hash_data;
   EmpathyFTHandlerPriv *priv = GET_PRIV (handler);
+  const gchar *hash;
 
-  if (!EMP_STR_EMPTY (priv->content_hash))
+  if (EMP_STR_EMPTY (priv->content_hash))
+    return;
+
+  if (!empathy_ft_hash_type_is_supported (priv->content_hash_type))
     {
-      hash_data = g_slice_new0 (HashingData);
-      hash_data->total_bytes = priv->total_bytes;
-      hash_data->handler = g_object_ref (handler);
-      hash_data->checksum = g_checksum_new
-        (tp_file_hash_to_g_checksum (priv->content_hash_type));
+      DEBUG ("Can't check hash of type %u, skipping verification",
+          priv->content_hash_type);
+      return;
+    }
 
+  hash = empathy_tp_file_get_received_hash (priv->tpfile);
+  if (hash != NULL)
+    {
+      /* the file was hashed while being received, no need to read it
+       * again */
       g_signal_emit (handler, signals[HASHING_STARTED], 0);
-
-      g_io_scheduler_push_job (do_hash_job_incoming, hash_data, NULL,
-                               G_PRIORITY_DEFAULT, priv->cancellable);
+      ft_handler_hash_ready (handler, hash);
+      return;
     }
+
+  DEBUG ("checking integrity for incoming handler");
+
+  ft_handler_start_hashing (handler);
 }
 
 static void
@@ -629,6 +632,16 @@ ft_transfer_operation_callback (EmpathyTpFile *tp_file,
 
   DEBUG ("Transfer operation callback, error %p", error);
 
+  if (priv->progress_pending)
+    {
+      progress_pending = g_list_remove (progress_pending, handler);
+      priv->progress_pending = FALSE;
+
+      /* let clients see the last progress before the transfer is done */
+      if (error == NULL)
+        ft_handler_emit_progress (handler);
+    }
+
   if (error != NULL)
     {
       emit_error_signal (handler, error);
@@ -653,24 +666,116 @@ update_remaining_time_and_speed (EmpathyFTHandler *handler,
 {
   EmpathyFTHandlerPriv *priv = GET_PRIV (handler);
   gint64 elapsed_time, current_time;
-  guint64 transferred, last_transferred_bytes;
-  gdouble speed;
-  gint remaining_time;
+  gdouble speed, weight;
 
-  last_transferred_bytes = priv->transferred_bytes;
   priv->transferred_bytes = transferred_bytes;
 
-  current_time = empathy_time_get_current ();
+  current_time = g_get_monotonic_time ();
+
+  if (priv->last_update_time == 0 ||
+      transferred_bytes < priv->last_update_bytes)
+    {
+      /* first sample */
+      priv->last_update_time = current_time;
+      priv->last_update_bytes = transferred_bytes;
+      return;
+    }
+
   elapsed_time = current_time - priv->last_update_time;
 
-  if (elapsed_time >= 1)
+  if (elapsed_time < SPEED_MIN_INTERVAL)
+    return;
+
+  speed = (gdouble) (transferred_bytes - priv->last_update_bytes) *
+      G_USEC_PER_SEC / elapsed_time;
+
+  /* exponentially weighted moving average, the weight of the new sample
+   * growing with the time it covers */
+  if (priv->speed <= 0)
     {
-      transferred = transferred_bytes - last_transferred_bytes;
-      speed = (gdouble) transferred / (gdouble) elapsed_time;
-      remaining_time = (priv->total_bytes - priv->transferred_bytes) / speed;
       priv->speed = speed;
-      priv->remaining_time = remaining_time;
-      priv->last_update_time = current_time;
+    }
+  else
+    {
+      weight = (gdouble) elapsed_time / (elapsed_time + SPEED_TIME_CONSTANT);
+      priv->speed += weight * (speed - priv->speed);
+    }
+
+  if (priv->speed > 0)
+    priv->remaining_time = (priv->total_bytes - priv->transferred_bytes) /
+        priv->speed;
+
+  priv->last_update_time = current_time;
+  priv->last_update_bytes = transferred_bytes;
+}
+
+static void
+ft_handler_emit_progress (EmpathyFTHandler *handler)
+{
+  EmpathyFTHandlerPriv *priv = GET_PRIV (handler);
+
+  g_signal_emit (handler, signals[TRANSFER_PROGRESS], 0,
+      priv->transferred_bytes, priv->total_bytes, priv->remaining_time,
+      priv->speed);
+}
+
+static gboolean
+ft_handler_progress_timeout_cb (gpointer user_data)
+{
+  GList *handlers;
+
+  if (progress_pending == NULL)
+    {
+      progress_timeout_id = 0;
+      return FALSE;
+    }
+
+  /* handlers are added back to the list if their progress changes while
+   * being emitted, and kept alive until their turn comes */
+  handlers = progress_pending;
+  progress_pending = NULL;
+
+  g_list_foreach (handlers, (GFunc) g_object_ref, NULL);
+
+  while (handlers != NULL)
+    {
+      EmpathyFTHandler *handler = handlers->data;
+      EmpathyFTHandlerPriv *priv = GET_PRIV (handler);
+
+      handlers = g_list_delete_link (handlers, handlers);
+
+      /* the transfer might have ended since the handler was queued */
+      if (priv->progress_pending)
+        {
+          priv->progress_pending = FALSE;
+          ft_handler_emit_progress (handler);
+        }
+
+      g_object_unref (handler);
+    }
+
+  /* keep ticking, the timeout is removed after an idle period */
+  return TRUE;
+}
+
+static void
+ft_handler_queue_progress (EmpathyFTHandler *handler)
+{
+  EmpathyFTHandlerPriv *priv = GET_PRIV (handler);
+
+  if (priv->progress_pending)
+    return;
+
+  priv->progress_pending = TRUE;
+  progress_pending = g_list_prepend (progress_pending, handler);
+
+  if (progress_timeout_id == 0)
+    {
+      progress_timeout_id = g_timeout_add (1000 / progress_max_rate,
+          ft_handler_progress_timeout_cb, NULL);
+
+      /* nothing was emitted during the last period, do it right away */
+      ft_handler_progress_timeout_cb (NULL);
     }
 }
 
@@ -687,17 +792,15 @@ ft_transfer_progress_callback (EmpathyTpFile *tp_file,
 
   if (transferred_bytes == 0)
     {
-      priv->last_update_time = empathy_time_get_current ();
+      priv->last_update_time = g_get_monotonic_time ();
+      priv->last_update_bytes = 0;
       g_signal_emit (handler, signals[TRANSFER_STARTED], 0, tp_file);
     }
 
   if (priv->transferred_bytes != transferred_bytes)
     {
       update_remaining_time_and_speed (handler, transferred_bytes);
-
-      g_signal_emit (handler, signals[TRANSFER_PROGRESS], 0,
-          transferred_bytes, priv->total_bytes, priv->remaining_time,
-          priv->speed);
+      ft_handler_queue_progress (handler);
     }
 }
 
@@ -790,46 +893,34 @@ ft_handler_populate_outgoing_request (EmpathyFTHandler *handler)
   g_free (uri);
 }
 
-static gboolean
-hash_job_done (gpointer user_data)
+static void
+ft_handler_hash_ready (EmpathyFTHandler *handler,
+    const gchar *hash)
 {
-  HashingData *hash_data = user_data;
-  EmpathyFTHandler *handler = hash_data->handler;
-  EmpathyFTHandlerPriv *priv;
-  GError *error = NULL;
-
-  DEBUG ("Closing stream after hashing.");
-
-  priv = GET_PRIV (handler);
-
-  if (hash_data->error != NULL)
-    {
-      error = hash_data->error;
-      hash_data->error = NULL;
-      goto cleanup;
-    }
+  EmpathyFTHandlerPriv *priv = GET_PRIV (handler);
 
-  DEBUG ("Got file hash %s", g_checksum_get_string (hash_data->checksum));
+  DEBUG ("Got file hash %s", hash);
 
   if (empathy_ft_handler_is_incoming (handler))
     {
-      if (g_strcmp0 (g_checksum_get_string (hash_data->checksum),
-                     priv->content_hash))
+      if (g_strcmp0 (hash, priv->content_hash))
         {
+          GError *error;
+
           DEBUG ("Hash mismatch when checking incoming handler: "
-                 "received %s, calculated %s", priv->content_hash,
-                 g_checksum_get_string (hash_data->checksum));
+                 "received %s, calculated %s", priv->content_hash, hash);
 
           error = g_error_new_literal (EMPATHY_FT_ERROR_QUARK,
               EMPATHY_FT_ERROR_HASH_MISMATCH,
               _("File transfer completed, but the file was corrupted"));
-          goto cleanup;
+          emit_error_signal (handler, error);
+          g_error_free (error);
+          return;
         }
       else
         {
           DEBUG ("Hash verification matched, received %s, calculated %s",
-                 priv->content_hash,
-                 g_checksum_get_string (hash_data->checksum));
+                 priv->content_hash, hash);
         }
     }
   else
@@ -838,153 +929,49 @@ hash_job_done (gpointer user_data)
        * org.freedesktop.Telepathy.Channel.Type.FileTransfer.ContentHash
        */
       tp_asv_set_string (priv->request,
-          TP_PROP_CHANNEL_TYPE_FILE_TRANSFER_CONTENT_HASH,
-          g_checksum_get_string (hash_data->checksum));
+          TP_PROP_CHANNEL_TYPE_FILE_TRANSFER_CONTENT_HASH, hash);
     }
 
-cleanup:
+  g_signal_emit (handler, signals[HASHING_DONE], 0);
 
-  if (error != NULL)
-    {
-      emit_error_signal (handler, error);
-      g_clear_error (&error);
-    }
-  else
-    {
-      g_signal_emit (handler, signals[HASHING_DONE], 0);
-
-      if (!empathy_ft_handler_is_incoming (handler))
-        /* the request is complete now, push it to the dispatcher */
-        ft_handler_push_to_dispatcher (handler);
-    }
-
-  hash_data_free (hash_data);
-
-  return FALSE;
-}
-
-static gboolean
-emit_hashing_progress (gpointer user_data)
-{
-  HashingData *hash_data = user_data;
-
-  g_signal_emit (hash_data->handler, signals[HASHING_PROGRESS], 0,
-      (guint64) hash_data->total_read, (guint64) hash_data->total_bytes);
-
-  return FALSE;
+  if (!empathy_ft_handler_is_incoming (handler))
+    /* the request is complete now, push it to the dispatcher */
+    ft_handler_push_to_dispatcher (handler);
 }
 
-static gboolean
-do_hash_job (GIOSchedulerJob *job,
-    GCancellable *cancellable,
+static void
+ft_handler_hash_file_cb (GObject *source,
+    GAsyncResult *result,
     gpointer user_data)
 {
-  HashingData *hash_data = user_data;
-  gssize bytes_read;
+  EmpathyFTHandler *handler = user_data;
   GError *error = NULL;
+  gchar *hash;
 
-again:
-  if (hash_data->buffer == NULL)
-    hash_data->buffer = g_malloc0 (BUFFER_SIZE);
-
-  bytes_read = g_input_stream_read (hash_data->stream, hash_data->buffer,
-                                    BUFFER_SIZE, cancellable, &error);
-  if (error != NULL)
-    goto out;
-
-  hash_data->total_read += bytes_read;
-
-  /* we now have the chunk */
-  if (bytes_read > 0)
+  hash = empathy_ft_hash_file_finish (G_FILE (source), result, &error);
+  if (hash == NULL)
     {
-      g_checksum_update (hash_data->checksum, hash_data->buffer, bytes_read);
-      g_io_scheduler_job_send_to_mainloop_async (job, emit_hashing_progress,
-          hash_data, NULL);
-
-      g_free (hash_data->buffer);
-      hash_data->buffer = NULL;
-
-      goto again;
+      emit_error_signal (handler, error);
+      g_clear_error (&error);
     }
   else
-  {
-    g_input_stream_close (hash_data->stream, cancellable, &error);
-  }
-
-out:
-  if (error != NULL)
-    hash_data->error = error;
-
-  g_io_scheduler_job_send_to_mainloop_async (job, hash_job_done,
-      hash_data, NULL);
-
-  return FALSE;
-}
-
-static gboolean
-do_hash_job_incoming (GIOSchedulerJob *job,
-    GCancellable *cancellable,
-    gpointer user_data)
-{
-  HashingData *hash_data = user_data;
-  EmpathyFTHandler *handler = hash_data->handler;
-  EmpathyFTHandlerPriv *priv = GET_PRIV (handler);
-  GError *error = NULL;
-
-  DEBUG ("checking integrity for incoming handler");
-
-  /* need to get the stream first */
-  hash_data->stream =
-    G_INPUT_STREAM (g_file_read (priv->gfile, cancellable, &error));
-
-  if (error != NULL)
     {
-      hash_data->error = error;
-      g_io_scheduler_job_send_to_mainloop_async (job, hash_job_done,
-          hash_data, NULL);
-      return FALSE;
+      ft_handler_hash_ready (handler, hash);
+      g_free (hash);
     }
 
-  return do_hash_job (job, cancellable, user_data);
+  g_object_unref (handler);
 }
 
 static void
-ft_handler_read_async_cb (GObject *source,
-    GAsyncResult *res,
+ft_handler_hash_progress_cb (guint64 hashed_bytes,
     gpointer user_data)
 {
-  GFileInputStream *stream;
-  GError *error = NULL;
-  HashingData *hash_data;
   EmpathyFTHandler *handler = user_data;
   EmpathyFTHandlerPriv *priv = GET_PRIV (handler);
 
-  DEBUG ("GFile read async CB.");
-
-  stream = g_file_read_finish (priv->gfile, res, &error);
-  if (error != NULL)
-    {
-      emit_error_signal (handler, error);
-      g_clear_error (&error);
-
-      return;
-    }
-
-  hash_data = g_slice_new0 (HashingData);
-  hash_data->stream = G_INPUT_STREAM (stream);
-  hash_data->total_bytes = priv->total_bytes;
-  hash_data->handler = g_object_ref (handler);
-  /* FIXME: MD5 is the only ContentHashType supported right now */
-  hash_data->checksum = g_checksum_new (G_CHECKSUM_MD5);
-
-  tp_asv_set_uint32 (priv->request,
-      TP_PROP_CHANNEL_TYPE_FILE_TRANSFER_CONTENT_HASH_TYPE,
-      TP_FILE_HASH_TYPE_MD5);
-
-  g_signal_emit (handler, signals[HASHING_STARTED], 0);
-
-  g_io_scheduler_push_job (do_hash_job, hash_data, NULL,
-      G_PRIORITY_DEFAULT, priv->cancellable);
+  g_signal_emit (handler, signals[HASHING_PROGRESS], 0, hashed_bytes,
+      priv->total_bytes);
 }
 
 static void
@@ -1054,23 +1041,24 @@ set_content_hash_type_from_classes (EmpathyFTHandler *handler,
       goto out;
     }
 
-  priv->use_hash = TRUE;
+  /* order the array and pick the first one we can compute, so that MD5
+   * is the preferred value.
+   */
+  g_array_sort (possible_values, empathy_uint_compare);
 
-  if (possible_values->len == 1)
-    {
-      priv->content_hash_type = g_array_index (possible_values, guint, 0);
-    }
-  else
+  priv->use_hash = FALSE;
+  priv->content_hash_type = TP_FILE_HASH_TYPE_NONE;
+
+  for (i = 0; i < possible_values->len; i++)
     {
-      /* order the array and pick the first non zero, so that MD5
-       * is the preferred value.
-       */
-      g_array_sort (possible_values, empathy_uint_compare);
+      value = g_array_index (possible_values, guint, i);
 
-      if (g_array_index (possible_values, guint, 0) == 0)
-        priv->content_hash_type = g_array_index (possible_values, guint, 1);
-      else
-        priv->content_hash_type = g_array_index (possible_values, guint, 0);
+      if (empathy_ft_hash_type_is_supported (value))
+        {
+          priv->use_hash = TRUE;
+          priv->content_hash_type = value;
+          break;
+        }
     }
 
 out:
@@ -1135,9 +1123,14 @@ ft_handler_complete_request (EmpathyFTHandler *handler)
   ft_handler_populate_outgoing_request (handler);
 
   if (priv->use_hash)
-    /* start hashing the file */
-    g_file_read_async (priv->gfile, G_PRIORITY_DEFAULT,
-        priv->cancellable, ft_handler_read_async_cb, handler);
+    {
+      tp_asv_set_uint32 (priv->request,
+          TP_PROP_CHANNEL_TYPE_FILE_TRANSFER_CONTENT_HASH_TYPE,
+          priv->content_hash_type);
+
+      /* start hashing the file */
+      ft_handler_start_hashing (handler);
+    }
   else
     /* push directly the handler to the dispatcher */
     ft_handler_push_to_dispatcher (handler);
@@ -1181,6 +1174,7 @@ ft_handler_gfile_ready_cb (GObject *source,
   priv->filename = g_strdup (g_file_info_get_display_name (info));
   g_file_info_get_modification_time (info, &mtime);
   priv->mtime = mtime.tv_sec;
+  priv->file_id = empathy_ft_hash_file_id_from_info (info);
   priv->transferred_bytes = 0;
   priv->description = NULL;
 
@@ -1323,7 +1317,7 @@ empathy_ft_handler_new_outgoing (EmpathyContact *contact,
       G_FILE_ATTRIBUTE_STANDARD_SIZE ","
       G_FILE_ATTRIBUTE_STANDARD_CONTENT_TYPE ","
       G_FILE_ATTRIBUTE_STANDARD_TYPE ","
-      G_FILE_ATTRIBUTE_TIME_MODIFIED,
+      EMPATHY_FT_HASH_FILE_ID_ATTRIBUTES,
       G_FILE_QUERY_INFO_NONE, G_PRIORITY_DEFAULT,
       NULL, (GAsyncReadyCallback) ft_handler_gfile_ready_cb, data);
 }
@@ -1387,6 +1381,10 @@ empathy_ft_handler_start_transfer (EmpathyFTHandler *handler)
     }
   else
     {
+      /* hash the file as it is received */
+      if (priv->use_hash)
+        empathy_tp_file_set_hash_type (priv->tpfile, priv->content_hash_type);
+
       /* TODO: add support for resume. */
       empathy_tp_file_accept (priv->tpfile, 0, priv->gfile, priv->cancellable,
           ft_transfer_progress_callback, handler,
@@ -1446,7 +1444,7 @@ empathy_ft_handler_incoming_set_destination (EmpathyFTHandler *handler,
    * anyway, so that clients won't be expecting us to checksum.
    */
   if (EMP_STR_EMPTY (priv->content_hash) ||
-      priv->content_hash_type == TP_FILE_HASH_TYPE_NONE)
+      !empathy_ft_hash_type_is_supported (priv->content_hash_type))
     priv->use_hash = FALSE;
   else
     priv->use_hash = TRUE;
@@ -1660,3 +1658,24 @@ empathy_ft_handler_is_cancelled (EmpathyFTHandler *handler)
 
   return g_cancellable_is_cancelled (priv->cancellable);
 }
+
+/**
+ * empathy_ft_handler_set_max_progress_rate:
+ * @rate: the maximum number of progress updates per second, or 0 to use
+ * the default
+ *
+ * Sets how often the #EmpathyFTHandler::transfer-progress signal can be
+ * emitted for each handler. The progress of all the ongoing transfers is
+ * reported at the same time, so this also bounds the rate at which a view
+ * showing them has to be updated.
+ */
+void
+empathy_ft_handler_set_max_progress_rate (guint rate)
+{
+  if (rate == 0)
+    rate = PROGRESS_DEFAULT_RATE;
+
+  progress_max_rate = MIN (rate, 1000);
+
+  /* the new rate is used when the timeout is next started */
+}
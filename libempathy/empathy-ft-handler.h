@@ -95,6 +95,8 @@ guint64 empathy_ft_handler_get_total_bytes (EmpathyFTHandler *handler);
 gboolean empathy_ft_handler_is_completed (EmpathyFTHandler *handler);
 gboolean empathy_ft_handler_is_cancelled (EmpathyFTHandler *handler);
 
+void empathy_ft_handler_set_max_progress_rate (guint rate);
+
 G_END_DECLS
 
 #endif /* __EMPATHY_FT_HANDLER_H__ */
@@ -0,0 +1,831 @@
+/*
+ * empathy-ft-hash.c - Source for file transfer hashing
+ * Copyright (C) 2012 Collabora Ltd.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <config.h>
+
+#include <sys/stat.h>
+
+#include <telepathy-glib/util.h>
+
+#include "empathy-ft-hash.h"
+#include "empathy-utils.h"
+
+#define DEBUG_FLAG EMPATHY_DEBUG_FT
+#include "empathy-debug.h"
+
+/* Files are read in large chunks: the checksum itself runs at several
+ * hundreds of MB/s, so small reads would make the syscalls dominate */
+#define HASH_BUFFER_SIZE (1024 * 1024)
+
+/* Minimum time between two progress reports, in microseconds */
+#define HASH_PROGRESS_INTERVAL (G_USEC_PER_SEC / 10)
+
+/* Hashes of the files we sent are kept in the cache directory, so sending
+ * the same file again doesn't need to hash it again */
+#define HASH_CACHE_FILENAME "file-hashes.ini"
+#define HASH_CACHE_KEY "hash"
+#define HASH_CACHE_MAX_ENTRIES 256
+
+/* One pass over a file, shared by all the callers asking for the hash of
+ * the same file at the same time */
+typedef struct {
+  volatile gint ref_count;
+  TpFileHashType type;
+  /* cache key, or NULL if the result is not to be cached */
+  gchar *key;
+  /* cancelled once all the waiters are */
+  GCancellable *cancellable;
+  volatile gint n_active;
+  /* owned HashWaiter */
+  GList *waiters;
+  gchar *hash;
+  GError *error /* comment to make the style checker happy */;
+} HashPass;
+
+typedef struct {
+  HashPass *pass;
+  GSimpleAsyncResult *result;
+  /* the thread-default main context of the caller, or NULL */
+  GMainContext *context;
+  GCancellable *cancellable;
+  gulong cancelled_id;
+  /* protected by the waiters lock: the idle completing the waiter once it
+   * is cancelled, and whether it has been completed already */
+  GSource *cancelled_source;
+  gboolean completed;
+  EmpathyFTHashProgressFunc progress_func;
+  gpointer progress_user_data;
+  GDestroyNotify progress_destroy;
+} HashWaiter;
+
+typedef struct {
+  HashPass *pass;
+  guint64 hashed_bytes;
+} HashProgress;
+
+/* cache key -> HashPass being run */
+static GHashTable *passes = NULL;
+
+/* Waiters can be cancelled from any thread */
+G_LOCK_DEFINE_STATIC (waiters);
+
+/* One buffer is kept around between hashing operations, so hashing files
+ * one after the other doesn't allocate anything */
+G_LOCK_DEFINE_STATIC (spare_buffer);
+static guchar *spare_buffer = NULL;
+
+static guchar *
+hash_buffer_take (void)
+{
+  guchar *buffer;
+
+  G_LOCK (spare_buffer);
+  buffer = spare_buffer;
+  spare_buffer = NULL;
+  G_UNLOCK (spare_buffer);
+
+  if (buffer == NULL)
+    buffer = g_malloc (HASH_BUFFER_SIZE);
+
+  return buffer;
+}
+
+static void
+hash_buffer_release (guchar *buffer)
+{
+  G_LOCK (spare_buffer);
+  if (spare_buffer == NULL)
+    {
+      spare_buffer = buffer;
+      buffer = NULL;
+    }
+  G_UNLOCK (spare_buffer);
+
+  g_free (buffer);
+}
+
+gboolean
+empathy_ft_hash_type_is_supported (TpFileHashType type)
+{
+  switch (type)
+    {
+      case TP_FILE_HASH_TYPE_MD5:
+      case TP_FILE_HASH_TYPE_SHA1:
+      case TP_FILE_HASH_TYPE_SHA256:
+        return TRUE;
+      case TP_FILE_HASH_TYPE_NONE:
+      default:
+        return FALSE;
+    }
+}
+
+GChecksumType
+empathy_ft_hash_type_to_checksum_type (TpFileHashType type)
+{
+  GChecksumType retval;
+
+  switch (type)
+    {
+      case TP_FILE_HASH_TYPE_MD5:
+        retval = G_CHECKSUM_MD5;
+        break;
+      case TP_FILE_HASH_TYPE_SHA1:
+        retval = G_CHECKSUM_SHA1;
+        break;
+      case TP_FILE_HASH_TYPE_SHA256:
+        retval = G_CHECKSUM_SHA256;
+        break;
+      case TP_FILE_HASH_TYPE_NONE:
+      default:
+        g_assert_not_reached ();
+        break;
+    }
+
+  return retval;
+}
+
+/**
+ * empathy_ft_hash_stream:
+ * @stream: a #GInputStream
+ * @type: the #TpFileHashType to compute, which must be supported
+ * @cancellable: a #GCancellable, or %NULL
+ * @progress_func: a function to report the progress with, or %NULL
+ * @progress_user_data: user data for @progress_func
+ * @error: a #GError to fill, or %NULL
+ *
+ * Synchronously reads @stream until its end, without closing it, and
+ * computes the hash of its content. This blocks, so it is meant to be
+ * called from a thread.
+ *
+ * Returns: a newly allocated string containing the hash in hexadecimal, or
+ * %NULL if reading the stream failed
+ */
+gchar *
+empathy_ft_hash_stream (GInputStream *stream,
+    TpFileHashType type,
+    GCancellable *cancellable,
+    EmpathyFTHashProgressFunc progress_func,
+    gpointer progress_user_data,
+    GError **error)
+{
+  GChecksum *checksum;
+  guchar *buffer;
+  gssize bytes_read;
+  guint64 hashed_bytes = 0;
+  gint64 last_progress = 0;
+  gchar *retval = NULL;
+
+  g_return_val_if_fail (G_IS_INPUT_STREAM (stream), NULL);
+  g_return_val_if_fail (empathy_ft_hash_type_is_supported (type), NULL);
+
+  checksum = g_checksum_new (empathy_ft_hash_type_to_checksum_type (type));
+  buffer = hash_buffer_take ();
+
+  while ((bytes_read = g_input_stream_read (stream, buffer,
+              HASH_BUFFER_SIZE, cancellable, error)) > 0)
+    {
+      gint64 now;
+
+      g_checksum_update (checksum, buffer, bytes_read);
+      hashed_bytes += bytes_read;
+
+      if (progress_func == NULL)
+        continue;
+
+      now = g_get_monotonic_time ();
+      if (now - last_progress >= HASH_PROGRESS_INTERVAL)
+        {
+          progress_func (hashed_bytes, progress_user_data);
+          last_progress = now;
+        }
+    }
+
+  if (bytes_read == 0)
+    {
+      if (progress_func != NULL)
+        progress_func (hashed_bytes, progress_user_data);
+
+      retval = g_strdup (g_checksum_get_string (checksum));
+    }
+
+  hash_buffer_release (buffer);
+  g_checksum_free (checksum);
+
+  return retval;
+}
+
+static GKeyFile *hash_cache = NULL;
+static guint hash_cache_store_id = 0;
+
+static gchar *
+hash_cache_get_filename (void)
+{
+  return g_build_filename (g_get_user_cache_dir (), PACKAGE_NAME,
+      HASH_CACHE_FILENAME, NULL);
+}
+
+static GKeyFile *
+hash_cache_get_key_file (void)
+{
+  gchar *filename;
+
+  if (hash_cache != NULL)
+    return hash_cache;
+
+  filename = hash_cache_get_filename ();
+
+  hash_cache = g_key_file_new ();
+  g_key_file_load_from_file (hash_cache, filename, G_KEY_FILE_NONE, NULL);
+  g_free (filename);
+
+  return hash_cache;
+}
+
+static gboolean
+hash_cache_store_cb (gpointer user_data)
+{
+  gchar *filename, *dir;
+  gchar *content;
+  gsize length;
+  GError *error = NULL;
+
+  hash_cache_store_id = 0;
+
+  content = g_key_file_to_data (hash_cache, &length, NULL);
+
+  filename = hash_cache_get_filename ();
+  dir = g_path_get_dirname (filename);
+  g_mkdir_with_parents (dir, S_IRUSR | S_IWUSR | S_IXUSR);
+
+  if (!g_file_set_contents (filename, content, length, &error))
+    {
+      DEBUG ("Failed to save the hash cache: %s", error->message);
+      g_error_free (error);
+    }
+
+  g_free (dir);
+  g_free (filename);
+  g_free (content);
+
+  return FALSE;
+}
+
+static gchar *
+hash_cache_lookup (const gchar *key)
+{
+  return g_key_file_get_string (hash_cache_get_key_file (), key,
+      HASH_CACHE_KEY, NULL);
+}
+
+static void
+hash_cache_insert (const gchar *key,
+    const gchar *hash)
+{
+  GKeyFile *key_file = hash_cache_get_key_file ();
+  gchar **groups;
+  gsize n_groups, i;
+
+  /* New groups are appended, so the first ones are the oldest */
+  groups = g_key_file_get_groups (key_file, &n_groups);
+  for (i = 0; i + HASH_CACHE_MAX_ENTRIES <= n_groups; i++)
+    g_key_file_remove_group (key_file, groups[i], NULL);
+  g_strfreev (groups);
+
+  g_key_file_set_string (key_file, key, HASH_CACHE_KEY, hash);
+
+  if (hash_cache_store_id == 0)
+    hash_cache_store_id = g_timeout_add_seconds (1, hash_cache_store_cb,
+        NULL);
+}
+
+/**
+ * empathy_ft_hash_file_id_from_info:
+ * @info: a #GFileInfo queried with at least
+ * %EMPATHY_FT_HASH_FILE_ID_ATTRIBUTES
+ *
+ * Builds an identifier of the content of a file for
+ * empathy_ft_hash_file_async(): it changes whenever the file is replaced
+ * or modified.
+ *
+ * Returns: a newly allocated string, or %NULL if @info doesn't have the
+ * needed attributes
+ */
+gchar *
+empathy_ft_hash_file_id_from_info (GFileInfo *info)
+{
+  g_return_val_if_fail (G_IS_FILE_INFO (info), NULL);
+
+  if (!g_file_info_has_attribute (info, G_FILE_ATTRIBUTE_UNIX_DEVICE) ||
+      !g_file_info_has_attribute (info, G_FILE_ATTRIBUTE_UNIX_INODE) ||
+      !g_file_info_has_attribute (info, G_FILE_ATTRIBUTE_TIME_MODIFIED))
+    return NULL;
+
+  return g_strdup_printf ("%u:%" G_GUINT64_FORMAT ":%" G_GUINT64_FORMAT
+      ":%" G_GUINT64_FORMAT ".%06u",
+      g_file_info_get_attribute_uint32 (info, G_FILE_ATTRIBUTE_UNIX_DEVICE),
+      g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_UNIX_INODE),
+      (guint64) g_file_info_get_size (info),
+      g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED),
+      g_file_info_get_attribute_uint32 (info,
+          G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC));
+}
+
+static HashPass *
+hash_pass_ref (HashPass *pass)
+{
+  g_atomic_int_inc (&pass->ref_count);
+
+  return pass;
+}
+
+static void
+hash_pass_unref (HashPass *pass)
+{
+  if (!g_atomic_int_dec_and_test (&pass->ref_count))
+    return;
+
+  g_assert (pass->waiters == NULL);
+
+  g_free (pass->key);
+  g_object_unref (pass->cancellable);
+  g_free (pass->hash);
+  if (pass->error != NULL)
+    g_error_free (pass->error);
+
+  g_slice_free (HashPass, pass);
+}
+
+static void
+hash_waiter_free (HashWaiter *waiter)
+{
+  if (waiter->progress_destroy != NULL)
+    waiter->progress_destroy (waiter->progress_user_data);
+
+  g_object_unref (waiter->result);
+  tp_clear_object (&waiter->cancellable);
+  if (waiter->context != NULL)
+    g_main_context_unref (waiter->context);
+
+  g_slice_free (HashWaiter, waiter);
+}
+
+static void
+hash_waiter_complete (HashWaiter *waiter,
+    const gchar *hash,
+    const GError *error)
+{
+  GError *cancelled = NULL;
+
+  G_LOCK (waiters);
+  waiter->completed = TRUE;
+  if (waiter->cancelled_source != NULL)
+    {
+      g_source_destroy (waiter->cancelled_source);
+      g_source_unref (waiter->cancelled_source);
+      waiter->cancelled_source = NULL;
+    }
+  G_UNLOCK (waiters);
+
+  if (waiter->cancelled_id != 0)
+    g_cancellable_disconnect (waiter->cancellable, waiter->cancelled_id);
+
+  if (g_cancellable_set_error_if_cancelled (waiter->cancellable, &cancelled))
+    g_simple_async_result_take_error (waiter->result, cancelled);
+  else if (error != NULL)
+    g_simple_async_result_set_from_error (waiter->result, error);
+  else
+    g_simple_async_result_set_op_res_gpointer (waiter->result,
+        g_strdup (hash), g_free);
+
+  g_simple_async_result_complete (waiter->result);
+
+  hash_waiter_free (waiter);
+}
+
+/* Completes a cancelled waiter without waiting for the other waiters of
+ * its pass, and stops the pass if nobody is waiting for it any more */
+static gboolean
+hash_waiter_cancelled_idle_cb (gpointer user_data)
+{
+  HashWaiter *waiter = user_data;
+  HashPass *pass = waiter->pass;
+
+  pass->waiters = g_list_remove (pass->waiters, waiter);
+
+  /* the source is destroyed when returning */
+  G_LOCK (waiters);
+  g_source_unref (waiter->cancelled_source);
+  waiter->cancelled_source = NULL;
+  G_UNLOCK (waiters);
+
+  hash_waiter_complete (waiter, NULL, NULL);
+
+  if (g_atomic_int_dec_and_test (&pass->n_active))
+    {
+      DEBUG ("Nobody is waiting for the hash any more, stop hashing");
+      g_cancellable_cancel (pass->cancellable);
+    }
+
+  return FALSE;
+}
+
+/* Called in whichever thread cancels the waiter's cancellable */
+static void
+hash_waiter_cancelled_cb (GCancellable *cancellable,
+    gpointer user_data)
+{
+  HashWaiter *waiter = user_data;
+
+  G_LOCK (waiters);
+
+  if (!waiter->completed && waiter->cancelled_source == NULL)
+    {
+      waiter->cancelled_source = g_idle_source_new ();
+      g_source_set_callback (waiter->cancelled_source,
+          hash_waiter_cancelled_idle_cb, waiter, NULL);
+      g_source_attach (waiter->cancelled_source, waiter->context);
+    }
+
+  G_UNLOCK (waiters);
+}
+
+static void
+hash_progress_free (HashProgress *progress)
+{
+  hash_pass_unref (progress->pass);
+
+  g_slice_free (HashProgress, progress);
+}
+
+static gboolean
+hash_progress_idle_cb (gpointer user_data)
+{
+  HashProgress *progress = user_data;
+  GList *l;
+
+  for (l = progress->pass->waiters; l != NULL; l = l->next)
+    {
+      HashWaiter *waiter = l->data;
+
+      if (waiter->progress_func != NULL &&
+          !g_cancellable_is_cancelled (waiter->cancellable))
+        waiter->progress_func (progress->hashed_bytes,
+            waiter->progress_user_data);
+    }
+
+  return FALSE;
+}
+
+/* Called in the hashing thread; the progress functions are called in the
+ * main loop */
+static void
+hash_pass_progress_cb (guint64 hashed_bytes,
+    gpointer user_data)
+{
+  HashPass *pass = user_data;
+  HashProgress *progress;
+
+  progress = g_slice_new (HashProgress);
+  progress->pass = hash_pass_ref (pass);
+  progress->hashed_bytes = hashed_bytes;
+
+  g_idle_add_full (G_PRIORITY_DEFAULT, hash_progress_idle_cb, progress,
+      (GDestroyNotify) hash_progress_free);
+}
+
+static void
+hash_pass_thread_func (GSimpleAsyncResult *result,
+    GObject *object,
+    GCancellable *cancellable)
+{
+  HashPass *pass = g_simple_async_result_get_op_res_gpointer (result);
+  GFileInputStream *stream;
+
+  stream = g_file_read (G_FILE (object), cancellable, &pass->error);
+  if (stream == NULL)
+    return;
+
+  pass->hash = empathy_ft_hash_stream (G_INPUT_STREAM (stream), pass->type,
+      cancellable, hash_pass_progress_cb, pass, &pass->error);
+
+  g_input_stream_close (G_INPUT_STREAM (stream), NULL, NULL);
+  g_object_unref (stream);
+}
+
+static void
+hash_pass_done_cb (GObject *source,
+    GAsyncResult *result,
+    gpointer user_data)
+{
+  HashPass *pass = user_data;
+  GList *waiters;
+
+  if (pass->key != NULL)
+    {
+      /* a new pass could have been started if this one was cancelled */
+      if (g_hash_table_lookup (passes, pass->key) == pass)
+        g_hash_table_remove (passes, pass->key);
+
+      if (pass->hash != NULL)
+        hash_cache_insert (pass->key, pass->hash);
+    }
+
+  waiters = pass->waiters;
+  pass->waiters = NULL;
+
+  while (waiters != NULL)
+    {
+      hash_waiter_complete (waiters->data, pass->hash, pass->error);
+      waiters = g_list_delete_link (waiters, waiters);
+    }
+
+  hash_pass_unref (pass);
+}
+
+/**
+ * empathy_ft_hash_file_async:
+ * @file: the #GFile to hash
+ * @file_id: the identifier of the content of @file returned by
+ * empathy_ft_hash_file_id_from_info(), or %NULL
+ * @type: the #TpFileHashType to compute, which must be supported
+ * @cancellable: a #GCancellable, or %NULL
+ * @progress_func: a function to report the progress with, or %NULL
+ * @progress_user_data: user data for @progress_func
+ * @progress_destroy: a function to free @progress_user_data with once the
+ * operation is over, or %NULL
+ * @callback: a #GAsyncReadyCallback to call when the hash is computed
+ * @user_data: user data for @callback
+ *
+ * Asynchronously computes the hash of the content of @file, in a thread.
+ * @progress_func is called in the main loop, and not after @cancellable
+ * has been cancelled. Once @cancellable is cancelled, @callback is called
+ * right away with %G_IO_ERROR_CANCELLED, even if other callers are still
+ * waiting for the same pass.
+ *
+ * If @file_id is given, the hash is remembered across sessions for this
+ * version of the file, and callers asking for the same file while it is
+ * being hashed share the same pass over it.
+ */
+void
+empathy_ft_hash_file_async (GFile *file,
+    const gchar *file_id,
+    TpFileHashType type,
+    GCancellable *cancellable,
+    EmpathyFTHashProgressFunc progress_func,
+    gpointer progress_user_data,
+    GDestroyNotify progress_destroy,
+    GAsyncReadyCallback callback,
+    gpointer user_data)
+{
+  HashWaiter *waiter;
+  HashPass *pass = NULL;
+  gchar *key = NULL;
+
+  g_return_if_fail (G_IS_FILE (file));
+  g_return_if_fail (empathy_ft_hash_type_is_supported (type));
+
+  waiter = g_slice_new0 (HashWaiter);
+  waiter->result = g_simple_async_result_new (G_OBJECT (file), callback,
+      user_data, empathy_ft_hash_file_async);
+  waiter->cancellable = cancellable != NULL ? g_object_ref (cancellable) :
+      g_cancellable_new ();
+  waiter->context = g_main_context_get_thread_default ();
+  if (waiter->context != NULL)
+    g_main_context_ref (waiter->context);
+  waiter->progress_func = progress_func;
+  waiter->progress_user_data = progress_user_data;
+  waiter->progress_destroy = progress_destroy;
+
+  if (file_id != NULL)
+    {
+      gchar *hash;
+
+      key = g_strdup_printf ("%s:%u", file_id, type);
+
+      hash = hash_cache_lookup (key);
+      if (hash != NULL)
+        {
+          DEBUG ("Hash of %s found in the cache: %s", key, hash);
+
+          g_simple_async_result_set_op_res_gpointer (waiter->result, hash,
+              g_free);
+          g_simple_async_result_complete_in_idle (waiter->result);
+          hash_waiter_free (waiter);
+          g_free (key);
+          return;
+        }
+
+      if (passes == NULL)
+        passes = g_hash_table_new (g_str_hash, g_str_equal);
+
+      pass = g_hash_table_lookup (passes, key);
+
+      /* don't join a pass which is being stopped */
+      if (pass != NULL && g_cancellable_is_cancelled (pass->cancellable))
+        pass = NULL;
+    }
+
+  if (pass == NULL)
+    {
+      GSimpleAsyncResult *result;
+
+      pass = g_slice_new0 (HashPass);
+      pass->ref_count = 1;
+      pass->type = type;
+      pass->key = key;
+      pass->cancellable = g_cancellable_new ();
+
+      if (key != NULL)
+        g_hash_table_replace (passes, key, pass);
+
+      result = g_simple_async_result_new (G_OBJECT (file), hash_pass_done_cb,
+          pass, empathy_ft_hash_file_async);
+      g_simple_async_result_set_op_res_gpointer (result, pass, NULL);
+      g_simple_async_result_run_in_thread (result, hash_pass_thread_func,
+          G_PRIORITY_DEFAULT, pass->cancellable);
+      g_object_unref (result);
+    }
+  else
+    {
+      DEBUG ("%s is already being hashed", key);
+      g_free (key);
+    }
+
+  waiter->pass = pass;
+  pass->waiters = g_list_prepend (pass->waiters, waiter);
+
+  g_atomic_int_inc (&pass->n_active);
+  waiter->cancelled_id = g_cancellable_connect (waiter->cancellable,
+      G_CALLBACK (hash_waiter_cancelled_cb), waiter, NULL);
+}
+
+/**
+ * empathy_ft_hash_file_finish:
+ * @file: the #GFile passed to empathy_ft_hash_file_async()
+ * @result: the #GAsyncResult passed to the callback
+ * @error: a #GError to fill, or %NULL
+ *
+ * Returns: a newly allocated string containing the hash of the file in
+ * hexadecimal, or %NULL if an error occurred
+ */
+gchar *
+empathy_ft_hash_file_finish (GFile *file,
+    GAsyncResult *result,
+    GError **error)
+{
+  GSimpleAsyncResult *simple = G_SIMPLE_ASYNC_RESULT (result);
+
+  g_return_val_if_fail (g_simple_async_result_is_valid (result,
+          G_OBJECT (file), empathy_ft_hash_file_async), NULL);
+
+  if (g_simple_async_result_propagate_error (simple, error))
+    return NULL;
+
+  return g_strdup (g_simple_async_result_get_op_res_gpointer (simple));
+}
+
+/* EmpathyFTHashInputStream: hashes the data as it is read from the base
+ * stream, so a file can be checked while it is being received rather than
+ * read again from the disk afterwards. */
+
+#define GET_PRIV(obj) EMPATHY_GET_PRIV (obj, EmpathyFTHashInputStream)
+
+typedef struct {
+  GChecksum *checksum;
+  /* TRUE once the end of the base stream has been reached */
+  gboolean eof;
+} EmpathyFTHashInputStreamPriv;
+
+G_DEFINE_TYPE (EmpathyFTHashInputStream, empathy_ft_hash_input_stream,
+    G_TYPE_FILTER_INPUT_STREAM);
+
+/* Called in whichever thread reads the stream; the splice of
+ * EmpathyTpFile runs in a GIO worker thread */
+static gssize
+ft_hash_input_stream_read (GInputStream *stream,
+    void *buffer,
+    gsize count,
+    GCancellable *cancellable,
+    GError **error)
+{
+  EmpathyFTHashInputStreamPriv *priv = GET_PRIV (stream);
+  GInputStream *base_stream;
+  gssize bytes_read;
+
+  base_stream = g_filter_input_stream_get_base_stream (
+      G_FILTER_INPUT_STREAM (stream));
+
+  bytes_read = g_input_stream_read (base_stream, buffer, count, cancellable,
+      error);
+
+  if (bytes_read > 0)
+    g_checksum_update (priv->checksum, buffer, bytes_read);
+  else if (bytes_read == 0 && count > 0)
+    priv->eof = TRUE;
+
+  return bytes_read;
+}
+
+static void
+ft_hash_input_stream_finalize (GObject *object)
+{
+  EmpathyFTHashInputStreamPriv *priv = GET_PRIV (object);
+
+  if (priv->checksum != NULL)
+    g_checksum_free (priv->checksum);
+
+  G_OBJECT_CLASS (empathy_ft_hash_input_stream_parent_class)->finalize (
+      object);
+}
+
+static void
+empathy_ft_hash_input_stream_class_init (EmpathyFTHashInputStreamClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+  GInputStreamClass *stream_class = G_INPUT_STREAM_CLASS (klass);
+
+  object_class->finalize = ft_hash_input_stream_finalize;
+  stream_class->read_fn = ft_hash_input_stream_read;
+
+  g_type_class_add_private (object_class,
+      sizeof (EmpathyFTHashInputStreamPriv));
+}
+
+static void
+empathy_ft_hash_input_stream_init (EmpathyFTHashInputStream *self)
+{
+  self->priv = G_TYPE_INSTANCE_GET_PRIVATE (self,
+      EMPATHY_TYPE_FT_HASH_INPUT_STREAM, EmpathyFTHashInputStreamPriv);
+}
+
+/**
+ * empathy_ft_hash_input_stream_new:
+ * @base_stream: the #GInputStream to read from
+ * @type: the #TpFileHashType to compute, which must be supported
+ *
+ * Creates a stream reading from @base_stream and computing the hash of
+ * everything read through it.
+ *
+ * Returns: a new #GInputStream
+ */
+GInputStream *
+empathy_ft_hash_input_stream_new (GInputStream *base_stream,
+    TpFileHashType type)
+{
+  EmpathyFTHashInputStream *self;
+  EmpathyFTHashInputStreamPriv *priv;
+
+  g_return_val_if_fail (G_IS_INPUT_STREAM (base_stream), NULL);
+  g_return_val_if_fail (empathy_ft_hash_type_is_supported (type), NULL);
+
+  self = g_object_new (EMPATHY_TYPE_FT_HASH_INPUT_STREAM,
+      "base-stream", base_stream,
+      NULL);
+
+  priv = GET_PRIV (self);
+  priv->checksum = g_checksum_new (
+      empathy_ft_hash_type_to_checksum_type (type));
+
+  return G_INPUT_STREAM (self);
+}
+
+/**
+ * empathy_ft_hash_input_stream_get_hash:
+ * @self: an #EmpathyFTHashInputStream
+ *
+ * Returns the hash of the data read from the stream, once all of it has
+ * been read. Only call this once nothing reads the stream anymore.
+ *
+ * Returns: the hash in hexadecimal, or %NULL if the end of the base stream
+ * hasn't been reached
+ */
+const gchar *
+empathy_ft_hash_input_stream_get_hash (EmpathyFTHashInputStream *self)
+{
+  EmpathyFTHashInputStreamPriv *priv;
+
+  g_return_val_if_fail (EMPATHY_IS_FT_HASH_INPUT_STREAM (self), NULL);
+
+  priv = GET_PRIV (self);
+
+  if (!priv->eof)
+    return NULL;
+
+  return g_checksum_get_string (priv->checksum);
+}
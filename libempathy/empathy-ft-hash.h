@@ -0,0 +1,102 @@
+/*
+ * empathy-ft-hash.h - Header for file transfer hashing
+ * Copyright (C) 2012 Collabora Ltd.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef __EMPATHY_FT_HASH_H__
+#define __EMPATHY_FT_HASH_H__
+
+#include <gio/gio.h>
+#include <telepathy-glib/enums.h>
+
+G_BEGIN_DECLS
+
+#define EMPATHY_TYPE_FT_HASH_INPUT_STREAM         (empathy_ft_hash_input_stream_get_type ())
+#define EMPATHY_FT_HASH_INPUT_STREAM(o)           (G_TYPE_CHECK_INSTANCE_CAST ((o), EMPATHY_TYPE_FT_HASH_INPUT_STREAM, EmpathyFTHashInputStream))
+#define EMPATHY_FT_HASH_INPUT_STREAM_CLASS(k)     (G_TYPE_CHECK_CLASS_CAST ((k), EMPATHY_TYPE_FT_HASH_INPUT_STREAM, EmpathyFTHashInputStreamClass))
+#define EMPATHY_IS_FT_HASH_INPUT_STREAM(o)        (G_TYPE_CHECK_INSTANCE_TYPE ((o), EMPATHY_TYPE_FT_HASH_INPUT_STREAM))
+#define EMPATHY_IS_FT_HASH_INPUT_STREAM_CLASS(k)  (G_TYPE_CHECK_CLASS_TYPE ((k), EMPATHY_TYPE_FT_HASH_INPUT_STREAM))
+#define EMPATHY_FT_HASH_INPUT_STREAM_GET_CLASS(o) (G_TYPE_INSTANCE_GET_CLASS ((o), EMPATHY_TYPE_FT_HASH_INPUT_STREAM, EmpathyFTHashInputStreamClass))
+
+typedef struct _EmpathyFTHashInputStream      EmpathyFTHashInputStream;
+typedef struct _EmpathyFTHashInputStreamClass EmpathyFTHashInputStreamClass;
+
+struct _EmpathyFTHashInputStream {
+  GFilterInputStream parent;
+
+  /*<private>*/
+  gpointer priv;
+};
+
+struct _EmpathyFTHashInputStreamClass {
+  GFilterInputStreamClass parent_class;
+};
+
+/* The attributes empathy_ft_hash_file_id_from_info() needs */
+#define EMPATHY_FT_HASH_FILE_ID_ATTRIBUTES \
+    G_FILE_ATTRIBUTE_STANDARD_SIZE "," \
+    G_FILE_ATTRIBUTE_TIME_MODIFIED "," \
+    G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC "," \
+    G_FILE_ATTRIBUTE_UNIX_DEVICE "," \
+    G_FILE_ATTRIBUTE_UNIX_INODE
+
+/**
+ * EmpathyFTHashProgressFunc:
+ * @hashed_bytes: the number of bytes hashed so far
+ * @user_data: user data passed along with the function
+ *
+ * Reports the progress of a hashing operation. It is called at most a few
+ * times per second, not once per chunk read.
+ */
+typedef void (*EmpathyFTHashProgressFunc) (guint64 hashed_bytes,
+    gpointer user_data);
+
+gboolean empathy_ft_hash_type_is_supported (TpFileHashType type);
+GChecksumType empathy_ft_hash_type_to_checksum_type (TpFileHashType type);
+
+gchar *empathy_ft_hash_stream (GInputStream *stream,
+    TpFileHashType type,
+    GCancellable *cancellable,
+    EmpathyFTHashProgressFunc progress_func,
+    gpointer progress_user_data,
+    GError **error);
+
+gchar *empathy_ft_hash_file_id_from_info (GFileInfo *info);
+
+void empathy_ft_hash_file_async (GFile *file,
+    const gchar *file_id,
+    TpFileHashType type,
+    GCancellable *cancellable,
+    EmpathyFTHashProgressFunc progress_func,
+    gpointer progress_user_data,
+    GDestroyNotify progress_destroy,
+    GAsyncReadyCallback callback,
+    gpointer user_data);
+gchar *empathy_ft_hash_file_finish (GFile *file,
+    GAsyncResult *result,
+    GError **error);
+
+GType empathy_ft_hash_input_stream_get_type (void) G_GNUC_CONST;
+
+GInputStream *empathy_ft_hash_input_stream_new (GInputStream *base_stream,
+    TpFileHashType type);
+const gchar *empathy_ft_hash_input_stream_get_hash (
+    EmpathyFTHashInputStream *self);
+
+G_END_DECLS
+
+#endif /* __EMPATHY_FT_HASH_H__ */
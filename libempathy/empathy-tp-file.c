@@ -21,11 +21,15 @@
  *          Cosimo Cecchi <cosimo.cecchi@collabora.co.uk>
  */
 
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE /* for splice() */
+#endif
 #include <config.h>
 
 #include <string.h>
 #include <unistd.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <arpa/inet.h>
 #include <sys/types.h>
 #include <sys/socket.h>
@@ -35,6 +39,7 @@
 #include <glib/gi18n-lib.h>
 
 #include <gio/gio.h>
+#include <gio/gfiledescriptorbased.h>
 #include <gio/gunixinputstream.h>
 #include <gio/gunixoutputstream.h>
 
@@ -44,6 +49,7 @@
 #include <telepathy-glib/interfaces.h>
 
 #include "empathy-tp-file.h"
+#include "empathy-ft-hash.h"
 #include "empathy-marshal.h"
 #include "empathy-time.h"
 #include "empathy-utils.h"
@@ -51,6 +57,12 @@
 #define DEBUG_FLAG EMPATHY_DEBUG_FT
 #include "empathy-debug.h"
 
+#if defined (HAVE_SYS_SENDFILE_H) && defined (HAVE_SENDFILE) && \
+    defined (HAVE_SPLICE)
+#include <sys/sendfile.h>
+#define ZERO_COPY 1
+#endif
+
 /**
  * SECTION:empathy-tp-file
  * @title: EmpathyTpFile
@@ -84,6 +96,12 @@ struct _EmpathyTpFilePrivate {
   guint port;
   guint64 offset;
 
+  /* incoming data is hashed while it is received, if hash_type is set */
+  TpFileHashType hash_type;
+  GInputStream *hash_stream;
+  /* TRUE once all the data has been written to out_stream */
+  gboolean splice_done;
+
   /* GCancellable we're passed when offering/accepting the transfer */
   GCancellable *cancellable;
 
@@ -226,6 +244,29 @@ ft_operation_close_with_error (EmpathyTpFile *self,
     self->priv->op_callback (self, error, self->priv->op_user_data);
 }
 
+/* Called once all the data went through the socket, or failed to */
+static void
+tp_file_data_transferred (EmpathyTpFile *self,
+    GError *error)
+{
+  if (error != NULL)
+    {
+      /* an incoming transfer completed on the channel is still waiting
+       * for us */
+      if (!self->priv->is_closing ||
+          self->priv->state == TP_FILE_TRANSFER_STATE_COMPLETED)
+        ft_operation_close_with_error (self, error);
+
+      return;
+    }
+
+  self->priv->splice_done = TRUE;
+
+  if (self->priv->incoming &&
+      self->priv->state == TP_FILE_TRANSFER_STATE_COMPLETED)
+    ft_operation_close_clean (self);
+}
+
 static void
 splice_stream_ready_cb (GObject *source,
     GAsyncResult *res,
@@ -238,12 +279,418 @@ splice_stream_ready_cb (GObject *source,
 
   DEBUG ("Splice stream ready cb, error %p", error);
 
-  if (error != NULL && !self->priv->is_closing)
+  tp_file_data_transferred (self, error);
+  g_clear_error (&error);
+}
+
+/* Moves the data between the file and the socket with GIO, taking the
+ * ownership of fd */
+static void
+tp_file_splice_streams (EmpathyTpFile *self,
+    gint fd)
+{
+  if (self->priv->incoming)
     {
-      ft_operation_close_with_error (self, error);
-      g_clear_error (&error);
+      GInputStream *socket_stream;
+
+      socket_stream = g_unix_input_stream_new (fd, TRUE);
+
+      if (empathy_ft_hash_type_is_supported (self->priv->hash_type) &&
+          self->priv->offset == 0)
+        {
+          self->priv->hash_stream = empathy_ft_hash_input_stream_new (
+              socket_stream, self->priv->hash_type);
+
+          g_object_unref (socket_stream);
+          socket_stream = g_object_ref (self->priv->hash_stream);
+        }
+
+      g_output_stream_splice_async (self->priv->out_stream, socket_stream,
+          G_OUTPUT_STREAM_SPLICE_CLOSE_SOURCE |
+          G_OUTPUT_STREAM_SPLICE_CLOSE_TARGET,
+          G_PRIORITY_DEFAULT, self->priv->cancellable,
+          splice_stream_ready_cb, self);
+
+      g_object_unref (socket_stream);
+    }
+  else
+    {
+      GOutputStream *socket_stream;
+
+      socket_stream = g_unix_output_stream_new (fd, TRUE);
+
+      g_output_stream_splice_async (socket_stream, self->priv->in_stream,
+          G_OUTPUT_STREAM_SPLICE_CLOSE_SOURCE |
+          G_OUTPUT_STREAM_SPLICE_CLOSE_TARGET,
+          G_PRIORITY_DEFAULT, self->priv->cancellable,
+          splice_stream_ready_cb, self);
+
+      g_object_unref (socket_stream);
+    }
+}
+
+#ifdef ZERO_COPY
+
+/* Zero-copy data path: the kernel moves the data between the file and the
+ * socket, with sendfile() for outgoing transfers and splice() through a
+ * pipe for incoming ones, from a thread. If the kernel can't do that for
+ * these file descriptors, the transfer goes back to the GIO data path. */
+
+/* Maximum size moved by a single sendfile() or splice() call */
+#define ZERO_COPY_CHUNK_SIZE (1024 * 1024)
+
+typedef struct {
+  gint socket_fd;
+  /* the GFileInputStream or GFileOutputStream of the file */
+  GObject *file_stream;
+  gint in_fd;
+  gint out_fd;
+  /* the kernel refused to move the data before any of it was moved, the
+   * transfer can go through GIO instead */
+  gboolean unsupported;
+} ZeroCopyData;
+
+static void
+zero_copy_data_free (ZeroCopyData *data)
+{
+  if (data->socket_fd >= 0)
+    close (data->socket_fd);
+
+  g_object_unref (data->file_stream);
+
+  g_slice_free (ZeroCopyData, data);
+}
+
+static void
+zero_copy_set_error (GError **error,
+    gint code)
+{
+  g_set_error_literal (error, G_IO_ERROR, g_io_error_from_errno (code),
+      g_strerror (code));
+}
+
+/* Blocks until fd is ready for events or the operation is cancelled */
+static gboolean
+zero_copy_wait (gint fd,
+    gushort events,
+    GCancellable *cancellable,
+    GError **error)
+{
+  GPollFD fds[2];
+  guint n_fds = 1;
+  gint res;
+
+  fds[0].fd = fd;
+  fds[0].events = events | G_IO_HUP | G_IO_ERR;
+
+  if (g_cancellable_make_pollfd (cancellable, &fds[1]))
+    n_fds++;
+
+  do
+    res = g_poll (fds, n_fds, -1);
+  while (res < 0 && errno == EINTR);
+
+  if (res < 0)
+    zero_copy_set_error (error, errno);
+
+  if (n_fds > 1)
+    g_cancellable_release_fd (cancellable);
+
+  if (res < 0)
+    return FALSE;
+
+  return !g_cancellable_set_error_if_cancelled (cancellable, error);
+}
+
+/* Whether errno means that the file descriptors can't be used with
+ * sendfile() or splice() */
+static gboolean
+zero_copy_errno_is_unsupported (gint code)
+{
+  return code == EINVAL || code == ENOSYS || code == EOPNOTSUPP;
+}
+
+static gboolean zero_copy_splice (gint in_fd, gint out_fd,
+    gboolean *unsupported, GCancellable *cancellable, GError **error);
+
+static gboolean
+zero_copy_sendfile (gint in_fd,
+    gint out_fd,
+    gboolean *unsupported,
+    GCancellable *cancellable,
+    GError **error)
+{
+  gboolean started = FALSE;
+
+  while (!g_cancellable_set_error_if_cancelled (cancellable, error))
+    {
+      gssize res;
+
+      res = sendfile (out_fd, in_fd, NULL, ZERO_COPY_CHUNK_SIZE);
+      if (res == 0)
+        return TRUE;
+
+      if (res > 0)
+        {
+          started = TRUE;
+          continue;
+        }
+
+      if (errno == EINTR)
+        continue;
+
+      /* not all file systems support sendfile() */
+      if (!started && zero_copy_errno_is_unsupported (errno))
+        return zero_copy_splice (in_fd, out_fd, unsupported, cancellable,
+            error);
+
+      if (errno != EAGAIN)
+        {
+          zero_copy_set_error (error, errno);
+          return FALSE;
+        }
+
+      if (!zero_copy_wait (out_fd, G_IO_OUT, cancellable, error))
+        return FALSE;
+    }
+
+  return FALSE;
+}
+
+static gboolean
+zero_copy_splice (gint in_fd,
+    gint out_fd,
+    gboolean *unsupported,
+    GCancellable *cancellable,
+    GError **error)
+{
+  gint pipe_fds[2];
+  gboolean started = FALSE;
+  gboolean retval = FALSE;
+
+  if (pipe (pipe_fds) < 0)
+    {
+      zero_copy_set_error (error, errno);
+      return FALSE;
+    }
+
+#ifdef F_SETPIPE_SZ
+  /* the default pipe size is 64 KiB, larger chunks mean fewer syscalls */
+  fcntl (pipe_fds[1], F_SETPIPE_SZ, ZERO_COPY_CHUNK_SIZE);
+#endif
+
+  while (!g_cancellable_set_error_if_cancelled (cancellable, error))
+    {
+      gssize in_pipe;
+
+      in_pipe = splice (in_fd, NULL, pipe_fds[1], NULL, ZERO_COPY_CHUNK_SIZE,
+          SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+
+      if (in_pipe == 0)
+        {
+          retval = TRUE;
+          break;
+        }
+
+      if (in_pipe < 0)
+        {
+          if (errno == EINTR)
+            continue;
+
+          /* not all sockets support splice(), nothing was read from in_fd
+           * yet so the caller can move the data by other means */
+          if (!started && zero_copy_errno_is_unsupported (errno))
+            {
+              *unsupported = TRUE;
+              break;
+            }
+
+          if (errno != EAGAIN)
+            {
+              zero_copy_set_error (error, errno);
+              break;
+            }
+
+          if (!zero_copy_wait (in_fd, G_IO_IN, cancellable, error))
+            break;
+
+          continue;
+        }
+
+      started = TRUE;
+
+      while (in_pipe > 0)
+        {
+          gssize res;
+
+          res = splice (pipe_fds[0], NULL, out_fd, NULL, in_pipe,
+              SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+
+          if (res > 0)
+            {
+              in_pipe -= res;
+              continue;
+            }
+
+          if (res < 0 && errno == EINTR)
+            continue;
+
+          if (res == 0 || errno != EAGAIN)
+            {
+              zero_copy_set_error (error, res == 0 ? EPIPE : errno);
+              goto out;
+            }
+
+          if (!zero_copy_wait (out_fd, G_IO_OUT, cancellable, error))
+            goto out;
+        }
+    }
+
+out:
+  close (pipe_fds[0]);
+  close (pipe_fds[1]);
+
+  return retval;
+}
+
+static void
+zero_copy_thread_func (GSimpleAsyncResult *result,
+    GObject *object,
+    GCancellable *cancellable)
+{
+  EmpathyTpFile *self = EMPATHY_TP_FILE (object);
+  ZeroCopyData *data = g_simple_async_result_get_op_res_gpointer (result);
+  GError *error = NULL;
+  gboolean success;
+
+  if (self->priv->incoming)
+    success = zero_copy_splice (data->in_fd, data->out_fd,
+        &data->unsupported, cancellable, &error);
+  else
+    /* sendfile() needs a source it can mmap(), so only a file */
+    success = zero_copy_sendfile (data->in_fd, data->out_fd,
+        &data->unsupported, cancellable, &error);
+
+  /* the streams are still needed to move the data through GIO */
+  if (data->unsupported)
+    return;
+
+  /* like g_output_stream_splice() with G_OUTPUT_STREAM_SPLICE_CLOSE_*,
+   * closing the stream of g_file_replace() is what moves the file in
+   * place */
+  if (G_IS_OUTPUT_STREAM (data->file_stream))
+    g_output_stream_close (G_OUTPUT_STREAM (data->file_stream), NULL,
+        success ? &error : NULL);
+  else
+    g_input_stream_close (G_INPUT_STREAM (data->file_stream), NULL, NULL);
+
+  if (error != NULL)
+    g_simple_async_result_take_error (result, error);
+}
+
+static void
+zero_copy_ready_cb (GObject *source,
+    GAsyncResult *res,
+    gpointer user_data)
+{
+  EmpathyTpFile *self = EMPATHY_TP_FILE (source);
+  ZeroCopyData *data;
+  GError *error = NULL;
+  gint flags;
+
+  data = g_simple_async_result_get_op_res_gpointer (
+      G_SIMPLE_ASYNC_RESULT (res));
+
+  if (data->unsupported)
+    {
+      DEBUG ("Zero-copy data path not supported, using GIO");
+
+      flags = fcntl (data->socket_fd, F_GETFL);
+      if (flags >= 0)
+        fcntl (data->socket_fd, F_SETFL, flags & ~O_NONBLOCK);
+
+      tp_file_splice_streams (self, data->socket_fd);
+      data->socket_fd = -1;
+
       return;
     }
+
+  g_simple_async_result_propagate_error (G_SIMPLE_ASYNC_RESULT (res),
+      &error);
+
+  DEBUG ("Zero-copy transfer done, error %p", error);
+
+  tp_file_data_transferred (self, error);
+  g_clear_error (&error);
+}
+
+static gint
+stream_get_fd (gpointer stream)
+{
+  if (stream == NULL || !G_IS_FILE_DESCRIPTOR_BASED (stream))
+    return -1;
+
+  return g_file_descriptor_based_get_fd (G_FILE_DESCRIPTOR_BASED (stream));
+}
+
+#endif /* ZERO_COPY */
+
+/* Moves the data between the file and the socket with the zero-copy data
+ * path if possible, taking the ownership of fd in that case */
+static gboolean
+tp_file_start_zero_copy (EmpathyTpFile *self,
+    gint fd)
+{
+#ifdef ZERO_COPY
+  GSimpleAsyncResult *result;
+  ZeroCopyData *data;
+  GObject *file_stream;
+  gint file_fd;
+  gint flags;
+
+  /* hashing needs to see the data */
+  if (self->priv->incoming &&
+      empathy_ft_hash_type_is_supported (self->priv->hash_type))
+    return FALSE;
+
+  if (self->priv->incoming)
+    file_stream = G_OBJECT (self->priv->out_stream);
+  else
+    file_stream = G_OBJECT (self->priv->in_stream);
+
+  /* only local files can be used */
+  file_fd = stream_get_fd (file_stream);
+  if (file_fd < 0)
+    return FALSE;
+
+  /* the thread polls the socket, so that it can be cancelled */
+  flags = fcntl (fd, F_GETFL);
+  if (flags < 0 || fcntl (fd, F_SETFL, flags | O_NONBLOCK) < 0)
+    return FALSE;
+
+  DEBUG ("Using the zero-copy data path");
+
+  data = g_slice_new (ZeroCopyData);
+  data->socket_fd = fd;
+  data->file_stream = g_object_ref (file_stream);
+  data->in_fd = self->priv->incoming ? fd : file_fd;
+  data->out_fd = self->priv->incoming ? file_fd : fd;
+  data->unsupported = FALSE;
+
+  result = g_simple_async_result_new (G_OBJECT (self), zero_copy_ready_cb,
+      NULL, tp_file_start_zero_copy);
+  g_simple_async_result_set_op_res_gpointer (result, data,
+      (GDestroyNotify) zero_copy_data_free);
+
+  g_simple_async_result_run_in_thread (result, zero_copy_thread_func,
+      G_PRIORITY_DEFAULT, self->priv->cancellable);
+
+  g_object_unref (result);
+
+  return TRUE;
+#else
+  return FALSE;
+#endif
 }
 
 static void
@@ -343,34 +790,10 @@ tp_file_start_transfer (EmpathyTpFile *self)
   if (self->priv->progress_callback != NULL)
     self->priv->progress_callback (self, 0, self->priv->progress_user_data);
 
-  if (self->priv->incoming)
-    {
-      GInputStream *socket_stream;
-
-      socket_stream = g_unix_input_stream_new (fd, TRUE);
-
-      g_output_stream_splice_async (self->priv->out_stream, socket_stream,
-          G_OUTPUT_STREAM_SPLICE_CLOSE_SOURCE |
-          G_OUTPUT_STREAM_SPLICE_CLOSE_TARGET,
-          G_PRIORITY_DEFAULT, self->priv->cancellable,
-          splice_stream_ready_cb, self);
-
-      g_object_unref (socket_stream);
-    }
-  else
-    {
-      GOutputStream *socket_stream;
-
-      socket_stream = g_unix_output_stream_new (fd, TRUE);
-
-      g_output_stream_splice_async (socket_stream, self->priv->in_stream,
-          G_OUTPUT_STREAM_SPLICE_CLOSE_SOURCE |
-          G_OUTPUT_STREAM_SPLICE_CLOSE_TARGET,
-          G_PRIORITY_DEFAULT, self->priv->cancellable,
-          splice_stream_ready_cb, self);
+  if (tp_file_start_zero_copy (self, fd))
+    return;
 
-      g_object_unref (socket_stream);
-    }
+  tp_file_splice_streams (self, fd);
 }
 
 static GError *
@@ -444,7 +867,12 @@ tp_file_state_changed_cb (TpChannel *proxy,
       self->priv->socket_address != NULL)
     tp_file_start_transfer (EMPATHY_TP_FILE (weak_object));
 
-  if (state == TP_FILE_TRANSFER_STATE_COMPLETED)
+  /* The connection manager can be done with the transfer before we have
+   * read everything from the socket; incoming transfers are then completed
+   * in splice_stream_ready_cb(). */
+  if (state == TP_FILE_TRANSFER_STATE_COMPLETED &&
+      (!self->priv->incoming || self->priv->splice_done ||
+       self->priv->out_stream == NULL))
     ft_operation_close_clean (EMPATHY_TP_FILE (weak_object));
 
   if (state == TP_FILE_TRANSFER_STATE_CANCELLED)
@@ -709,6 +1137,7 @@ do_dispose (GObject *object)
 
   tp_clear_object (&self->priv->in_stream);
   tp_clear_object (&self->priv->out_stream);
+  tp_clear_object (&self->priv->hash_stream);
   tp_clear_object (&self->priv->cancellable);
 
   G_OBJECT_CLASS (empathy_tp_file_parent_class)->dispose (object);
@@ -956,6 +1385,47 @@ empathy_tp_file_offer (EmpathyTpFile *self,
       file_read_async_cb, self);
 }
 
+/**
+ * empathy_tp_file_set_hash_type:
+ * @self: an incoming #EmpathyTpFile
+ * @hash_type: the #TpFileHashType of the hash the sender provided
+ *
+ * Makes @self compute the hash of the data as it is received, so it can be
+ * checked with empathy_tp_file_get_received_hash() once the transfer is
+ * done. This must be called before empathy_tp_file_accept().
+ */
+void
+empathy_tp_file_set_hash_type (EmpathyTpFile *self,
+    TpFileHashType hash_type)
+{
+  g_return_if_fail (EMPATHY_IS_TP_FILE (self));
+  g_return_if_fail (self->priv->incoming);
+
+  self->priv->hash_type = hash_type;
+}
+
+/**
+ * empathy_tp_file_get_received_hash:
+ * @self: an incoming #EmpathyTpFile
+ *
+ * Returns the hash of the data received, computed while receiving it as
+ * requested with empathy_tp_file_set_hash_type().
+ *
+ * Return value: the hash in hexadecimal, or %NULL if the whole file hasn't
+ * been hashed
+ */
+const gchar *
+empathy_tp_file_get_received_hash (EmpathyTpFile *self)
+{
+  g_return_val_if_fail (EMPATHY_IS_TP_FILE (self), NULL);
+
+  if (self->priv->hash_stream == NULL || !self->priv->splice_done)
+    return NULL;
+
+  return empathy_ft_hash_input_stream_get_hash (
+      EMPATHY_FT_HASH_INPUT_STREAM (self->priv->hash_stream));
+}
+
 /**
  * empathy_tp_file_is_incoming:
  * @self: an #EmpathyTpFile
@@ -28,6 +28,7 @@
 #include <glib.h>
 
 #include <telepathy-glib/channel.h>
+#include <telepathy-glib/enums.h>
 
 G_BEGIN_DECLS
 
@@ -115,6 +116,10 @@ void empathy_tp_file_offer (EmpathyTpFile *tp_file,
     EmpathyTpFileOperationCallback op_callback,
     gpointer op_user_data);
 
+void empathy_tp_file_set_hash_type (EmpathyTpFile *tp_file,
+    TpFileHashType hash_type);
+const gchar *empathy_tp_file_get_received_hash (EmpathyTpFile *tp_file);
+
 void empathy_tp_file_cancel (EmpathyTpFile *tp_file);
 void empathy_tp_file_close (EmpathyTpFile *tp_file);
 
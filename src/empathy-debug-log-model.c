@@ -0,0 +1,539 @@
+/*
+ * Copyright (C) 2011 Collabora Ltd.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <config.h>
+
+#include <string.h>
+
+#include <gtk/gtk.h>
+
+#include <telepathy-glib/enums.h>
+
+#include "empathy-debug-log-model.h"
+
+/* A flat GtkTreeModel for the debug window. Messages are stored column by
+ * column rather than as one row struct each, domains and categories are
+ * split once and stored as IDs, and the rows passing the level filter are
+ * kept in a separate index array. The GValues the view asks for are only
+ * built when it actually renders a row. */
+
+struct _EmpathyDebugLogModelPrivate
+{
+  /* Row columns, all of the same length */
+  GArray *timestamps;     /* gdouble */
+  GArray *domains;        /* guint, index in names */
+  GArray *categories;     /* guint, index in names */
+  GArray *levels;         /* guint8, TpDebugLevel */
+  GPtrArray *messages;    /* borrowed from messages_chunk */
+  GStringChunk *messages_chunk;
+
+  /* Domain and category names. Kept around when clearing the model as
+   * there are only a handful of them */
+  GPtrArray *names;       /* borrowed from names_chunk */
+  GStringChunk *names_chunk;
+  /* owned "domain/category" string => GUINT_TO_POINTER (domain_id |
+   * category_id << 16) */
+  GHashTable *domain_category_ids;
+
+  /* guint, indexes in the row columns of the rows shown */
+  GArray *visible;
+  /* bit n is set if TpDebugLevel n is shown */
+  guint level_mask;
+
+  gint stamp;
+};
+
+static void debug_log_model_iface_init (GtkTreeModelIface *iface);
+
+G_DEFINE_TYPE_WITH_CODE (EmpathyDebugLogModel, empathy_debug_log_model,
+    G_TYPE_OBJECT,
+    G_IMPLEMENT_INTERFACE (GTK_TYPE_TREE_MODEL, debug_log_model_iface_init));
+
+static const gchar *
+log_level_to_string (guint level)
+{
+  switch (level)
+    {
+    case TP_DEBUG_LEVEL_ERROR:
+      return "Error";
+      break;
+    case TP_DEBUG_LEVEL_CRITICAL:
+      return "Critical";
+      break;
+    case TP_DEBUG_LEVEL_WARNING:
+      return "Warning";
+      break;
+    case TP_DEBUG_LEVEL_MESSAGE:
+      return "Message";
+      break;
+    case TP_DEBUG_LEVEL_INFO:
+      return "Info";
+      break;
+    case TP_DEBUG_LEVEL_DEBUG:
+      return "Debug";
+      break;
+    default:
+      g_assert_not_reached ();
+      break;
+    }
+}
+
+static guint
+debug_log_model_level_mask (guint max_level)
+{
+  if (max_level >= NUM_TP_DEBUG_LEVELS - 1)
+    return (1 << NUM_TP_DEBUG_LEVELS) - 1;
+
+  return (1 << (max_level + 1)) - 1;
+}
+
+static guint
+debug_log_model_intern_name (EmpathyDebugLogModel *self,
+    const gchar *name)
+{
+  EmpathyDebugLogModelPrivate *priv = self->priv;
+  guint i;
+
+  /* There are very few distinct names so a linear scan is fine; it only
+   * happens the first time we see a domain/category pair anyway */
+  for (i = 0; i < priv->names->len; i++)
+    {
+      if (!strcmp (g_ptr_array_index (priv->names, i), name))
+        return i;
+    }
+
+  g_ptr_array_add (priv->names,
+      g_string_chunk_insert (priv->names_chunk, name));
+
+  return priv->names->len - 1;
+}
+
+static void
+debug_log_model_lookup_domain_category (EmpathyDebugLogModel *self,
+    const gchar *domain_category,
+    guint *domain_id,
+    guint *category_id)
+{
+  EmpathyDebugLogModelPrivate *priv = self->priv;
+  gpointer ids;
+
+  if (!g_hash_table_lookup_extended (priv->domain_category_ids,
+          domain_category, NULL, &ids))
+    {
+      const gchar *slash = strchr (domain_category, '/');
+      guint domain, category;
+
+      if (slash != NULL)
+        {
+          gchar *tmp = g_strndup (domain_category, slash - domain_category);
+
+          domain = debug_log_model_intern_name (self, tmp);
+          category = debug_log_model_intern_name (self, slash + 1);
+          g_free (tmp);
+        }
+      else
+        {
+          domain = debug_log_model_intern_name (self, domain_category);
+          category = debug_log_model_intern_name (self, "");
+        }
+
+      ids = GUINT_TO_POINTER (domain | (category << 16));
+      g_hash_table_insert (priv->domain_category_ids,
+          g_strdup (domain_category), ids);
+    }
+
+  *domain_id = GPOINTER_TO_UINT (ids) & 0xffff;
+  *category_id = GPOINTER_TO_UINT (ids) >> 16;
+}
+
+static void
+empathy_debug_log_model_init (EmpathyDebugLogModel *self)
+{
+  EmpathyDebugLogModelPrivate *priv = G_TYPE_INSTANCE_GET_PRIVATE (self,
+      EMPATHY_TYPE_DEBUG_LOG_MODEL, EmpathyDebugLogModelPrivate);
+
+  self->priv = priv;
+
+  priv->timestamps = g_array_new (FALSE, FALSE, sizeof (gdouble));
+  priv->domains = g_array_new (FALSE, FALSE, sizeof (guint));
+  priv->categories = g_array_new (FALSE, FALSE, sizeof (guint));
+  priv->levels = g_array_new (FALSE, FALSE, sizeof (guint8));
+  priv->messages = g_ptr_array_new ();
+  priv->messages_chunk = g_string_chunk_new (64 * 1024);
+
+  priv->names = g_ptr_array_new ();
+  priv->names_chunk = g_string_chunk_new (256);
+  priv->domain_category_ids = g_hash_table_new_full (g_str_hash,
+      g_str_equal, g_free, NULL);
+
+  priv->visible = g_array_new (FALSE, FALSE, sizeof (guint));
+  priv->level_mask = debug_log_model_level_mask (TP_DEBUG_LEVEL_DEBUG);
+
+  priv->stamp = g_random_int ();
+}
+
+static void
+debug_log_model_finalize (GObject *object)
+{
+  EmpathyDebugLogModelPrivate *priv = EMPATHY_DEBUG_LOG_MODEL (object)->priv;
+
+  g_array_free (priv->timestamps, TRUE);
+  g_array_free (priv->domains, TRUE);
+  g_array_free (priv->categories, TRUE);
+  g_array_free (priv->levels, TRUE);
+  g_ptr_array_free (priv->messages, TRUE);
+  g_string_chunk_free (priv->messages_chunk);
+
+  g_ptr_array_free (priv->names, TRUE);
+  g_string_chunk_free (priv->names_chunk);
+  g_hash_table_destroy (priv->domain_category_ids);
+
+  g_array_free (priv->visible, TRUE);
+
+  G_OBJECT_CLASS (empathy_debug_log_model_parent_class)->finalize (object);
+}
+
+static void
+empathy_debug_log_model_class_init (EmpathyDebugLogModelClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  object_class->finalize = debug_log_model_finalize;
+
+  g_type_class_add_private (object_class,
+      sizeof (EmpathyDebugLogModelPrivate));
+}
+
+/* GtkTreeModel implementation. iter->user_data is the index of the row in
+ * priv->visible. */
+
+static GtkTreeModelFlags
+debug_log_model_get_flags (GtkTreeModel *model)
+{
+  return GTK_TREE_MODEL_LIST_ONLY;
+}
+
+static gint
+debug_log_model_get_n_columns (GtkTreeModel *model)
+{
+  return EMPATHY_DEBUG_LOG_MODEL_COL_COUNT;
+}
+
+static GType
+debug_log_model_get_column_type (GtkTreeModel *model,
+    gint column)
+{
+  switch (column)
+    {
+      case EMPATHY_DEBUG_LOG_MODEL_COL_TIMESTAMP:
+        return G_TYPE_DOUBLE;
+      case EMPATHY_DEBUG_LOG_MODEL_COL_DOMAIN:
+      case EMPATHY_DEBUG_LOG_MODEL_COL_CATEGORY:
+      case EMPATHY_DEBUG_LOG_MODEL_COL_LEVEL_STRING:
+      case EMPATHY_DEBUG_LOG_MODEL_COL_MESSAGE:
+        return G_TYPE_STRING;
+      case EMPATHY_DEBUG_LOG_MODEL_COL_LEVEL_VALUE:
+        return G_TYPE_UINT;
+      default:
+        g_return_val_if_reached (G_TYPE_INVALID);
+    }
+}
+
+static gboolean
+debug_log_model_set_iter (EmpathyDebugLogModel *self,
+    GtkTreeIter *iter,
+    guint n)
+{
+  EmpathyDebugLogModelPrivate *priv = self->priv;
+
+  if (n >= priv->visible->len)
+    {
+      iter->stamp = 0;
+      return FALSE;
+    }
+
+  iter->stamp = priv->stamp;
+  iter->user_data = GUINT_TO_POINTER (n);
+  return TRUE;
+}
+
+static gboolean
+debug_log_model_get_iter (GtkTreeModel *model,
+    GtkTreeIter *iter,
+    GtkTreePath *path)
+{
+  if (gtk_tree_path_get_depth (path) != 1)
+    return FALSE;
+
+  return debug_log_model_set_iter (EMPATHY_DEBUG_LOG_MODEL (model), iter,
+      gtk_tree_path_get_indices (path)[0]);
+}
+
+static GtkTreePath *
+debug_log_model_get_path (GtkTreeModel *model,
+    GtkTreeIter *iter)
+{
+  EmpathyDebugLogModelPrivate *priv = EMPATHY_DEBUG_LOG_MODEL (model)->priv;
+
+  g_return_val_if_fail (iter->stamp == priv->stamp, NULL);
+
+  return gtk_tree_path_new_from_indices (GPOINTER_TO_UINT (iter->user_data),
+      -1);
+}
+
+static void
+debug_log_model_get_value (GtkTreeModel *model,
+    GtkTreeIter *iter,
+    gint column,
+    GValue *value)
+{
+  EmpathyDebugLogModelPrivate *priv = EMPATHY_DEBUG_LOG_MODEL (model)->priv;
+  guint row;
+
+  g_return_if_fail (iter->stamp == priv->stamp);
+
+  row = g_array_index (priv->visible, guint,
+      GPOINTER_TO_UINT (iter->user_data));
+
+  g_value_init (value, debug_log_model_get_column_type (model, column));
+
+  switch (column)
+    {
+      case EMPATHY_DEBUG_LOG_MODEL_COL_TIMESTAMP:
+        g_value_set_double (value,
+            g_array_index (priv->timestamps, gdouble, row));
+        break;
+      case EMPATHY_DEBUG_LOG_MODEL_COL_DOMAIN:
+        g_value_set_static_string (value, g_ptr_array_index (priv->names,
+                g_array_index (priv->domains, guint, row)));
+        break;
+      case EMPATHY_DEBUG_LOG_MODEL_COL_CATEGORY:
+        g_value_set_static_string (value, g_ptr_array_index (priv->names,
+                g_array_index (priv->categories, guint, row)));
+        break;
+      case EMPATHY_DEBUG_LOG_MODEL_COL_LEVEL_STRING:
+        g_value_set_static_string (value, log_level_to_string (
+                g_array_index (priv->levels, guint8, row)));
+        break;
+      case EMPATHY_DEBUG_LOG_MODEL_COL_MESSAGE:
+        g_value_set_string (value, g_ptr_array_index (priv->messages, row));
+        break;
+      case EMPATHY_DEBUG_LOG_MODEL_COL_LEVEL_VALUE:
+        g_value_set_uint (value, g_array_index (priv->levels, guint8, row));
+        break;
+      default:
+        g_return_if_reached ();
+    }
+}
+
+static gboolean
+debug_log_model_iter_next (GtkTreeModel *model,
+    GtkTreeIter *iter)
+{
+  EmpathyDebugLogModel *self = EMPATHY_DEBUG_LOG_MODEL (model);
+
+  g_return_val_if_fail (iter->stamp == self->priv->stamp, FALSE);
+
+  return debug_log_model_set_iter (self, iter,
+      GPOINTER_TO_UINT (iter->user_data) + 1);
+}
+
+static gboolean
+debug_log_model_iter_children (GtkTreeModel *model,
+    GtkTreeIter *iter,
+    GtkTreeIter *parent)
+{
+  if (parent != NULL)
+    return FALSE;
+
+  return debug_log_model_set_iter (EMPATHY_DEBUG_LOG_MODEL (model), iter, 0);
+}
+
+static gboolean
+debug_log_model_iter_has_child (GtkTreeModel *model,
+    GtkTreeIter *iter)
+{
+  return FALSE;
+}
+
+static gint
+debug_log_model_iter_n_children (GtkTreeModel *model,
+    GtkTreeIter *iter)
+{
+  EmpathyDebugLogModelPrivate *priv = EMPATHY_DEBUG_LOG_MODEL (model)->priv;
+
+  if (iter != NULL)
+    return 0;
+
+  return priv->visible->len;
+}
+
+static gboolean
+debug_log_model_iter_nth_child (GtkTreeModel *model,
+    GtkTreeIter *iter,
+    GtkTreeIter *parent,
+    gint n)
+{
+  if (parent != NULL || n < 0)
+    return FALSE;
+
+  return debug_log_model_set_iter (EMPATHY_DEBUG_LOG_MODEL (model), iter, n);
+}
+
+static gboolean
+debug_log_model_iter_parent (GtkTreeModel *model,
+    GtkTreeIter *iter,
+    GtkTreeIter *child)
+{
+  return FALSE;
+}
+
+static void
+debug_log_model_iface_init (GtkTreeModelIface *iface)
+{
+  iface->get_flags = debug_log_model_get_flags;
+  iface->get_n_columns = debug_log_model_get_n_columns;
+  iface->get_column_type = debug_log_model_get_column_type;
+  iface->get_iter = debug_log_model_get_iter;
+  iface->get_path = debug_log_model_get_path;
+  iface->get_value = debug_log_model_get_value;
+  iface->iter_next = debug_log_model_iter_next;
+  iface->iter_children = debug_log_model_iter_children;
+  iface->iter_has_child = debug_log_model_iter_has_child;
+  iface->iter_n_children = debug_log_model_iter_n_children;
+  iface->iter_nth_child = debug_log_model_iter_nth_child;
+  iface->iter_parent = debug_log_model_iter_parent;
+}
+
+EmpathyDebugLogModel *
+empathy_debug_log_model_new (void)
+{
+  return g_object_new (EMPATHY_TYPE_DEBUG_LOG_MODEL, NULL);
+}
+
+void
+empathy_debug_log_model_append (EmpathyDebugLogModel *self,
+    gdouble timestamp,
+    const gchar *domain_category,
+    guint level,
+    const gchar *message)
+{
+  EmpathyDebugLogModelPrivate *priv;
+  guint domain, category, row;
+  guint8 level8;
+  gsize len;
+
+  g_return_if_fail (EMPATHY_IS_DEBUG_LOG_MODEL (self));
+  g_return_if_fail (level < NUM_TP_DEBUG_LEVELS);
+
+  priv = self->priv;
+
+  debug_log_model_lookup_domain_category (self, domain_category,
+      &domain, &category);
+
+  /* Same as g_strchomp(), without having to copy the message first */
+  len = strlen (message);
+  if (len > 0 && message[len - 1] == '\n')
+    {
+      while (len > 0 && g_ascii_isspace (message[len - 1]))
+        len--;
+    }
+
+  level8 = level;
+  row = priv->timestamps->len;
+
+  g_array_append_val (priv->timestamps, timestamp);
+  g_array_append_val (priv->domains, domain);
+  g_array_append_val (priv->categories, category);
+  g_array_append_val (priv->levels, level8);
+  g_ptr_array_add (priv->messages,
+      g_string_chunk_insert_len (priv->messages_chunk, message, len));
+
+  if (priv->level_mask & (1 << level))
+    {
+      GtkTreeIter iter;
+      GtkTreePath *path;
+
+      g_array_append_val (priv->visible, row);
+
+      debug_log_model_set_iter (self, &iter, priv->visible->len - 1);
+      path = gtk_tree_path_new_from_indices (priv->visible->len - 1, -1);
+      gtk_tree_model_row_inserted (GTK_TREE_MODEL (self), path, &iter);
+      gtk_tree_path_free (path);
+    }
+}
+
+void
+empathy_debug_log_model_clear (EmpathyDebugLogModel *self)
+{
+  EmpathyDebugLogModelPrivate *priv;
+
+  g_return_if_fail (EMPATHY_IS_DEBUG_LOG_MODEL (self));
+
+  priv = self->priv;
+
+  g_array_set_size (priv->timestamps, 0);
+  g_array_set_size (priv->domains, 0);
+  g_array_set_size (priv->categories, 0);
+  g_array_set_size (priv->levels, 0);
+  g_ptr_array_set_size (priv->messages, 0);
+  g_string_chunk_clear (priv->messages_chunk);
+
+  g_array_set_size (priv->visible, 0);
+
+  priv->stamp++;
+}
+
+void
+empathy_debug_log_model_set_max_level (EmpathyDebugLogModel *self,
+    guint max_level)
+{
+  EmpathyDebugLogModelPrivate *priv;
+  const guint8 *levels;
+  guint *visible;
+  guint mask, n_rows, n_visible, i;
+
+  g_return_if_fail (EMPATHY_IS_DEBUG_LOG_MODEL (self));
+
+  priv = self->priv;
+  mask = debug_log_model_level_mask (max_level);
+
+  if (mask == priv->level_mask)
+    return;
+
+  priv->level_mask = mask;
+
+  n_rows = priv->levels->len;
+  g_array_set_size (priv->visible, n_rows);
+
+  levels = (const guint8 *) priv->levels->data;
+  visible = (guint *) priv->visible->data;
+  n_visible = 0;
+
+  /* Branchless so the compiler can keep this loop tight: every row index is
+   * written, but only kept if its level bit is in the mask */
+  for (i = 0; i < n_rows; i++)
+    {
+      visible[n_visible] = i;
+      n_visible += (mask >> levels[i]) & 1;
+    }
+
+  g_array_set_size (priv->visible, n_visible);
+
+  priv->stamp++;
+}
@@ -0,0 +1,79 @@
+/*
+ * Copyright (C) 2011 Collabora Ltd.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef __EMPATHY_DEBUG_LOG_MODEL_H__
+#define __EMPATHY_DEBUG_LOG_MODEL_H__
+
+#include <glib-object.h>
+#include <gtk/gtk.h>
+
+G_BEGIN_DECLS
+
+#define EMPATHY_TYPE_DEBUG_LOG_MODEL         (empathy_debug_log_model_get_type ())
+#define EMPATHY_DEBUG_LOG_MODEL(o)           (G_TYPE_CHECK_INSTANCE_CAST ((o), EMPATHY_TYPE_DEBUG_LOG_MODEL, EmpathyDebugLogModel))
+#define EMPATHY_DEBUG_LOG_MODEL_CLASS(k)     (G_TYPE_CHECK_CLASS_CAST((k), EMPATHY_TYPE_DEBUG_LOG_MODEL, EmpathyDebugLogModelClass))
+#define EMPATHY_IS_DEBUG_LOG_MODEL(o)        (G_TYPE_CHECK_INSTANCE_TYPE ((o), EMPATHY_TYPE_DEBUG_LOG_MODEL))
+#define EMPATHY_IS_DEBUG_LOG_MODEL_CLASS(k)  (G_TYPE_CHECK_CLASS_TYPE ((k), EMPATHY_TYPE_DEBUG_LOG_MODEL))
+#define EMPATHY_DEBUG_LOG_MODEL_GET_CLASS(o) (G_TYPE_INSTANCE_GET_CLASS ((o), EMPATHY_TYPE_DEBUG_LOG_MODEL, EmpathyDebugLogModelClass))
+
+typedef struct _EmpathyDebugLogModel        EmpathyDebugLogModel;
+typedef struct _EmpathyDebugLogModelPrivate EmpathyDebugLogModelPrivate;
+typedef struct _EmpathyDebugLogModelClass   EmpathyDebugLogModelClass;
+
+typedef enum
+{
+  EMPATHY_DEBUG_LOG_MODEL_COL_TIMESTAMP,
+  EMPATHY_DEBUG_LOG_MODEL_COL_DOMAIN,
+  EMPATHY_DEBUG_LOG_MODEL_COL_CATEGORY,
+  EMPATHY_DEBUG_LOG_MODEL_COL_LEVEL_STRING,
+  EMPATHY_DEBUG_LOG_MODEL_COL_MESSAGE,
+  EMPATHY_DEBUG_LOG_MODEL_COL_LEVEL_VALUE,
+  EMPATHY_DEBUG_LOG_MODEL_COL_COUNT,
+} EmpathyDebugLogModelCol;
+
+struct _EmpathyDebugLogModel
+{
+  GObject parent;
+  EmpathyDebugLogModelPrivate *priv;
+};
+
+struct _EmpathyDebugLogModelClass
+{
+  GObjectClass parent_class;
+};
+
+GType empathy_debug_log_model_get_type (void) G_GNUC_CONST;
+
+EmpathyDebugLogModel * empathy_debug_log_model_new (void);
+
+void empathy_debug_log_model_append (EmpathyDebugLogModel *self,
+    gdouble timestamp,
+    const gchar *domain_category,
+    guint level,
+    const gchar *message);
+
+/* These two don't emit a signal per affected row; detach the model from
+ * its view before calling them. */
+void empathy_debug_log_model_clear (EmpathyDebugLogModel *self);
+
+void empathy_debug_log_model_set_max_level (EmpathyDebugLogModel *self,
+    guint max_level);
+
+G_END_DECLS
+
+#endif /* __EMPATHY_DEBUG_LOG_MODEL_H__ */
@@ -43,6 +43,7 @@
 #include "extensions/extensions.h"
 
 #include "empathy-debug-window.h"
+#include "empathy-debug-log-model.h"
 
 G_DEFINE_TYPE (EmpathyDebugWindow, empathy_debug_window,
     GTK_TYPE_WINDOW)
@@ -55,13 +56,12 @@ typedef enum
 
 enum
 {
-  COL_DEBUG_TIMESTAMP = 0,
-  COL_DEBUG_DOMAIN,
-  COL_DEBUG_CATEGORY,
-  COL_DEBUG_LEVEL_STRING,
-  COL_DEBUG_MESSAGE,
-  COL_DEBUG_LEVEL_VALUE,
-  NUM_DEBUG_COLS
+  COL_DEBUG_TIMESTAMP = EMPATHY_DEBUG_LOG_MODEL_COL_TIMESTAMP,
+  COL_DEBUG_DOMAIN = EMPATHY_DEBUG_LOG_MODEL_COL_DOMAIN,
+  COL_DEBUG_CATEGORY = EMPATHY_DEBUG_LOG_MODEL_COL_CATEGORY,
+  COL_DEBUG_LEVEL_STRING = EMPATHY_DEBUG_LOG_MODEL_COL_LEVEL_STRING,
+  COL_DEBUG_MESSAGE = EMPATHY_DEBUG_LOG_MODEL_COL_MESSAGE,
+  COL_DEBUG_LEVEL_VALUE = EMPATHY_DEBUG_LOG_MODEL_COL_LEVEL_VALUE,
 };
 
 enum
@@ -95,8 +95,7 @@ typedef struct
   GHashTable *cache;
 
   /* TreeView */
-  GtkListStore *store;
-  GtkTreeModel *store_filter;
+  EmpathyDebugLogModel *store;
   GtkWidget *view;
   GtkWidget *scrolled_win;
   GtkWidget *not_supported_label;
@@ -123,75 +122,130 @@ typedef struct
   TpAccountManager *am;
 } EmpathyDebugWindowPriv;
 
-static const gchar *
-log_level_to_string (guint level)
-{
-  switch (level)
-    {
-    case TP_DEBUG_LEVEL_ERROR:
-      return "Error";
-      break;
-    case TP_DEBUG_LEVEL_CRITICAL:
-      return "Critical";
-      break;
-    case TP_DEBUG_LEVEL_WARNING:
-      return "Warning";
-      break;
-    case TP_DEBUG_LEVEL_MESSAGE:
-      return "Message";
-      break;
-    case TP_DEBUG_LEVEL_INFO:
-      return "Info";
-      break;
-    case TP_DEBUG_LEVEL_DEBUG:
-      return "Debug";
-      break;
-    default:
-      g_assert_not_reached ();
-      break;
-    }
-}
+/* Upper bounds on what we keep around for each service. Once either is
+ * reached the oldest messages are dropped to make room for new ones, so a
+ * chatty CM can't make the cache grow forever. */
+#define DEBUG_CACHE_MAX_MESSAGES 50000
+#define DEBUG_CACHE_MAX_BYTES (16 * 1024 * 1024)
 
 typedef struct
 {
   gdouble timestamp;
-  gchar *domain;
+  /* interned */
+  const gchar *domain;
   guint level;
   gchar *message;
 } DebugMessage;
 
-static DebugMessage *
-debug_message_new (gdouble timestamp,
-    const gchar *domain,
-    guint level,
-    const gchar *message)
+/* Fixed-capacity ring buffer of DebugMessage. The backing array is grown on
+ * demand up to max_messages, after that appending overwrites the oldest
+ * message. */
+typedef struct
+{
+  DebugMessage *messages;
+  /* number of slots allocated in messages */
+  guint allocated;
+  /* index of the oldest message */
+  guint head;
+  guint len;
+  gsize bytes;
+
+  guint max_messages;
+  gsize max_bytes;
+} DebugMessageCache;
+
+static DebugMessageCache *
+debug_message_cache_new (guint max_messages,
+    gsize max_bytes)
 {
-  DebugMessage *retval = g_slice_new0 (DebugMessage);
+  DebugMessageCache *cache = g_slice_new0 (DebugMessageCache);
 
-  retval->timestamp = timestamp;
-  retval->domain = g_strdup (domain);
-  retval->level = level;
-  retval->message = g_strdup (message);
+  cache->max_messages = MAX (max_messages, 1);
+  cache->max_bytes = max_bytes;
 
-  return retval;
+  return cache;
+}
+
+static DebugMessage *
+debug_message_cache_nth (DebugMessageCache *cache,
+    guint n)
+{
+  return &cache->messages[(cache->head + n) % cache->allocated];
 }
 
 static void
-debug_message_free (DebugMessage *dm)
+debug_message_cache_drop_oldest (DebugMessageCache *cache)
 {
-  g_free (dm->domain);
+  DebugMessage *dm = debug_message_cache_nth (cache, 0);
+
+  cache->bytes -= strlen (dm->message);
   g_free (dm->message);
+  dm->message = NULL;
+
+  cache->head = (cache->head + 1) % cache->allocated;
+  cache->len--;
+}
+
+static void
+debug_message_cache_grow (DebugMessageCache *cache)
+{
+  DebugMessage *messages;
+  guint allocated, i;
+
+  allocated = MIN (MAX (cache->allocated * 2, 64), cache->max_messages);
+  messages = g_new (DebugMessage, allocated);
+
+  /* Unwrap the ring while copying so the oldest message is at index 0 */
+  for (i = 0; i < cache->len; i++)
+    messages[i] = *debug_message_cache_nth (cache, i);
+
+  g_free (cache->messages);
+  cache->messages = messages;
+  cache->allocated = allocated;
+  cache->head = 0;
+}
 
-  g_slice_free (DebugMessage, dm);
+static void
+debug_message_cache_append (DebugMessageCache *cache,
+    gdouble timestamp,
+    const gchar *domain,
+    guint level,
+    const gchar *message)
+{
+  DebugMessage *dm;
+  gsize size = strlen (message);
+
+  while (cache->len > 0 && cache->bytes + size > cache->max_bytes)
+    debug_message_cache_drop_oldest (cache);
+
+  if (cache->len == cache->allocated)
+    {
+      if (cache->allocated < cache->max_messages)
+        debug_message_cache_grow (cache);
+      else
+        debug_message_cache_drop_oldest (cache);
+    }
+
+  dm = debug_message_cache_nth (cache, cache->len);
+  dm->timestamp = timestamp;
+  dm->domain = g_intern_string (domain);
+  dm->level = level;
+  dm->message = g_strdup (message);
+
+  cache->len++;
+  cache->bytes += size;
 }
 
 static void
-debug_message_list_free (gpointer data)
+debug_message_cache_free (gpointer data)
 {
-  GList *list = data;
+  DebugMessageCache *cache = data;
+
+  while (cache->len > 0)
+    debug_message_cache_drop_oldest (cache);
 
-  g_list_foreach (list, (GFunc) debug_message_free, NULL);
-  g_list_free (list);
+  g_free (cache->messages);
+  g_slice_free (DebugMessageCache, cache);
 }
 
 static gchar *
@@ -218,17 +272,36 @@ debug_window_cache_new_message (EmpathyDebugWindow *debug_window,
     const gchar *message)
 {
   EmpathyDebugWindowPriv *priv = GET_PRIV (debug_window);
-  GList *messages;
-  DebugMessage *dm;
+  DebugMessageCache *cache;
   char *name;
 
   name = get_active_service_name (debug_window);
-  messages = g_hash_table_lookup (priv->cache, name);
+  cache = g_hash_table_lookup (priv->cache, name);
 
-  dm = debug_message_new (timestamp, domain, level, message);
-  messages = g_list_append (messages, dm);
+  if (cache == NULL)
+    {
+      cache = debug_message_cache_new (DEBUG_CACHE_MAX_MESSAGES,
+          DEBUG_CACHE_MAX_BYTES);
+      g_hash_table_insert (priv->cache, name, cache);
+    }
+  else
+    {
+      g_free (name);
+    }
 
-  g_hash_table_insert (priv->cache, name, messages);
+  debug_message_cache_append (cache, timestamp, domain, level, message);
+}
+
+static void
+debug_window_clear (EmpathyDebugWindow *debug_window)
+{
+  EmpathyDebugWindowPriv *priv = GET_PRIV (debug_window);
+
+  /* The model doesn't signal each row it removes */
+  gtk_tree_view_set_model (GTK_TREE_VIEW (priv->view), NULL);
+  empathy_debug_log_model_clear (priv->store);
+  gtk_tree_view_set_model (GTK_TREE_VIEW (priv->view),
+      GTK_TREE_MODEL (priv->store));
 }
 
 static void
@@ -240,46 +313,13 @@ debug_window_add_message (EmpathyDebugWindow *debug_window,
     const gchar *message)
 {
   EmpathyDebugWindowPriv *priv = GET_PRIV (debug_window);
-  gchar *domain, *category;
-  GtkTreeIter iter;
-  gchar *string;
 
   if (should_cache)
     debug_window_cache_new_message (debug_window, timestamp, domain_category,
         level, message);
 
-  if (g_strrstr (domain_category, "/"))
-    {
-      gchar **parts = g_strsplit (domain_category, "/", 2);
-      domain = g_strdup (parts[0]);
-      category = g_strdup (parts[1]);
-      g_strfreev (parts);
-    }
-  else
-    {
-      domain = g_strdup (domain_category);
-      category = g_strdup ("");
-    }
-
-  if (g_str_has_suffix (message, "\n"))
-    string = g_strchomp (g_strdup (message));
-  else
-    string = g_strdup (message);
-
-
-  gtk_list_store_append (priv->store, &iter);
-  gtk_list_store_set (priv->store, &iter,
-      COL_DEBUG_TIMESTAMP, timestamp,
-      COL_DEBUG_DOMAIN, domain,
-      COL_DEBUG_CATEGORY, category,
-      COL_DEBUG_LEVEL_STRING, log_level_to_string (level),
-      COL_DEBUG_MESSAGE, string,
-      COL_DEBUG_LEVEL_VALUE, level,
-      -1);
-
-  g_free (string);
-  g_free (domain);
-  g_free (category);
+  empathy_debug_log_model_append (priv->store, timestamp, domain_category,
+      level, message);
 }
 
 static void
@@ -354,7 +394,6 @@ debug_window_get_messages_cb (TpProxy *proxy,
   EmpathyDebugWindow *debug_window = (EmpathyDebugWindow *) user_data;
   EmpathyDebugWindowPriv *priv = GET_PRIV (debug_window);
   gchar *name;
-  GList *old_messages;
   guint i;
 
   if (error != NULL)
@@ -367,17 +406,13 @@ debug_window_get_messages_cb (TpProxy *proxy,
   debug_window_set_toolbar_sensitivity (debug_window, TRUE);
 
   name = get_active_service_name (debug_window);
-  old_messages = g_hash_table_lookup (priv->cache, name);
 
   /* we call get_messages either when a new CM is added or
    * when a CM that we've already seen re-appears; in both cases
    * we don't need our old cache anymore.
    */
-  if (old_messages != NULL)
-    {
-      g_hash_table_remove (priv->cache, name);
-      debug_message_list_free (old_messages);
-    }
+  g_hash_table_remove (priv->cache, name);
+  g_free (name);
 
   for (i = 0; i < messages->len; i++)
     {
@@ -403,24 +438,31 @@ static void
 debug_window_add_log_messages_from_cache (EmpathyDebugWindow *debug_window,
     const gchar *name)
 {
-  GList *messages, *l;
-  DebugMessage *dm;
   EmpathyDebugWindowPriv *priv = GET_PRIV (debug_window);
+  DebugMessageCache *cache;
+  guint i;
 
   DEBUG ("Adding logs from cache for CM %s", name);
 
-  messages = g_hash_table_lookup (priv->cache, name);
+  cache = g_hash_table_lookup (priv->cache, name);
 
-  if (messages == NULL)
+  if (cache == NULL)
     return;
 
-  for (l = messages; l != NULL; l = l->next)
+  /* Detach the view while replaying so it doesn't have to process each
+   * row-inserted on its own */
+  gtk_tree_view_set_model (GTK_TREE_VIEW (priv->view), NULL);
+
+  for (i = 0; i < cache->len; i++)
     {
-      dm = l->data;
+      DebugMessage *dm = debug_message_cache_nth (cache, i);
 
-      debug_window_add_message (debug_window, FALSE, dm->timestamp,
+      empathy_debug_log_model_append (priv->store, dm->timestamp,
           dm->domain, dm->level, dm->message);
     }
+
+  gtk_tree_view_set_model (GTK_TREE_VIEW (priv->view),
+      GTK_TREE_MODEL (priv->store));
 }
 
 static void
@@ -459,7 +501,7 @@ debug_window_service_chooser_changed_cb (GtkComboBox *chooser,
       return;
     }
 
-  gtk_list_store_clear (priv->store);
+  debug_window_clear (debug_window);
 
   gtk_tree_model_get (GTK_TREE_MODEL (priv->service_store), &iter,
       COL_NAME, &name, COL_GONE, &gone, -1);
@@ -938,48 +980,32 @@ debug_window_pause_toggled_cb (GtkToggleToolButton *pause_,
   debug_window_set_enabled (debug_window, !priv->paused);
 }
 
-static gboolean
-debug_window_visible_func (GtkTreeModel *model,
-    GtkTreeIter *iter,
-    gpointer user_data)
-{
-  EmpathyDebugWindow *debug_window = (EmpathyDebugWindow *) user_data;
-  EmpathyDebugWindowPriv *priv = GET_PRIV (debug_window);
-  guint filter_value, level;
-  GtkTreeModel *filter_model;
-  GtkTreeIter filter_iter;
-
-  filter_model = gtk_combo_box_get_model (GTK_COMBO_BOX (priv->level_filter));
-  gtk_combo_box_get_active_iter (GTK_COMBO_BOX (priv->level_filter),
-      &filter_iter);
-
-  gtk_tree_model_get (model, iter, COL_DEBUG_LEVEL_VALUE, &level, -1);
-  gtk_tree_model_get (filter_model, &filter_iter,
-      COL_LEVEL_VALUE, &filter_value, -1);
-
-  if (level <= filter_value)
-    return TRUE;
-
-  return FALSE;
-}
-
 static void
 debug_window_filter_changed_cb (GtkComboBox *filter,
     EmpathyDebugWindow *debug_window)
 {
   EmpathyDebugWindowPriv *priv = GET_PRIV (debug_window);
+  GtkTreeIter iter;
+  guint max_level;
+
+  if (!gtk_combo_box_get_active_iter (filter, &iter))
+    return;
 
-  gtk_tree_model_filter_refilter (
-      GTK_TREE_MODEL_FILTER (priv->store_filter));
+  gtk_tree_model_get (gtk_combo_box_get_model (filter), &iter,
+      COL_LEVEL_VALUE, &max_level, -1);
+
+  /* The model doesn't signal each row it hides or shows */
+  gtk_tree_view_set_model (GTK_TREE_VIEW (priv->view), NULL);
+  empathy_debug_log_model_set_max_level (priv->store, max_level);
+  gtk_tree_view_set_model (GTK_TREE_VIEW (priv->view),
+      GTK_TREE_MODEL (priv->store));
 }
 
 static void
 debug_window_clear_clicked_cb (GtkToolButton *clear_button,
     EmpathyDebugWindow *debug_window)
 {
-  EmpathyDebugWindowPriv *priv = GET_PRIV (debug_window);
-
-  gtk_list_store_clear (priv->store);
+  debug_window_clear (debug_window);
 }
 
 static void
@@ -1002,9 +1028,9 @@ debug_window_menu_copy_activate_cb (GtkMenuItem *menu_item,
       return;
     }
 
-  gtk_tree_model_get_iter (priv->store_filter, &iter, path);
+  gtk_tree_model_get_iter (GTK_TREE_MODEL (priv->store), &iter, path);
 
-  gtk_tree_model_get (priv->store_filter, &iter,
+  gtk_tree_model_get (GTK_TREE_MODEL (priv->store), &iter,
       COL_DEBUG_MESSAGE, &message,
       -1);
 
@@ -1199,7 +1225,7 @@ debug_window_save_file_chooser_response_cb (GtkDialog *dialog,
       goto OUT;
     }
 
-  gtk_tree_model_foreach (priv->store_filter,
+  gtk_tree_model_foreach (GTK_TREE_MODEL (priv->store),
       debug_window_store_filter_foreach, output_stream);
 
 OUT:
@@ -1317,7 +1343,7 @@ debug_window_copy_clicked_cb (GtkToolButton *tool_button,
 
   text = g_strdup ("");
 
-  gtk_tree_model_foreach (priv->store_filter,
+  gtk_tree_model_foreach (GTK_TREE_MODEL (priv->store),
       debug_window_copy_model_foreach, &text);
 
   clipboard = gtk_clipboard_get_for_display (
@@ -1609,18 +1635,10 @@ am_prepared_cb (GObject *am,
   gtk_tree_view_insert_column_with_attributes (GTK_TREE_VIEW (priv->view),
       -1, _("Message"), renderer, "text", COL_DEBUG_MESSAGE, NULL);
 
-  priv->store = gtk_list_store_new (NUM_DEBUG_COLS, G_TYPE_DOUBLE,
-      G_TYPE_STRING, G_TYPE_STRING, G_TYPE_STRING, G_TYPE_STRING,
-      G_TYPE_UINT);
+  priv->store = empathy_debug_log_model_new ();
 
-  priv->store_filter = gtk_tree_model_filter_new (
-      GTK_TREE_MODEL (priv->store), NULL);
-
-  gtk_tree_model_filter_set_visible_func (
-      GTK_TREE_MODEL_FILTER (priv->store_filter),
-      debug_window_visible_func, object, NULL);
-
-  gtk_tree_view_set_model (GTK_TREE_VIEW (priv->view), priv->store_filter);
+  gtk_tree_view_set_model (GTK_TREE_VIEW (priv->view),
+      GTK_TREE_MODEL (priv->store));
 
   gtk_tree_view_set_search_column (GTK_TREE_VIEW (priv->view),
       COL_DEBUG_MESSAGE);
@@ -1672,7 +1690,7 @@ empathy_debug_window_init (EmpathyDebugWindow *empathy_debug_window)
 
   priv->dispose_run = FALSE;
   priv->cache = g_hash_table_new_full (g_str_hash, g_str_equal,
-      g_free, NULL);
+      g_free, debug_message_cache_free);
 }
 
 static void
@@ -1707,20 +1725,9 @@ static void
 debug_window_finalize (GObject *object)
 {
   EmpathyDebugWindowPriv *priv = GET_PRIV (object);
-  GHashTableIter iter;
-  char *key;
-  GList *values;
 
   g_free (priv->select_name);
 
-  g_hash_table_iter_init (&iter, priv->cache);
-
-  while (g_hash_table_iter_next (&iter, (gpointer *) &key,
-          (gpointer *) &values))
-    {
-      debug_message_list_free (values);
-    }
-
   g_hash_table_destroy (priv->cache);
 
   (G_OBJECT_CLASS (empathy_debug_window_parent_class)->finalize) (object);
@@ -62,6 +62,14 @@
 /* The time interval in milliseconds between 2 incoming rings */
 #define MS_BETWEEN_RING 500
 
+/* Presence notifications are rate limited so that an account coming back
+ * with thousands of contacts doesn't flood the notification area: at most
+ * PRESENCE_EVENTS_MAX events are shown per PRESENCE_EVENTS_WINDOW and at
+ * most one presence sound is played every PRESENCE_SOUND_INTERVAL. */
+#define PRESENCE_EVENTS_MAX 5
+#define PRESENCE_EVENTS_WINDOW (10 * G_USEC_PER_SEC)
+#define PRESENCE_SOUND_INTERVAL (G_USEC_PER_SEC)
+
 typedef struct {
   EmpathyEventManager *manager;
   TpChannelDispatchOperation *operation;
@@ -92,8 +100,22 @@ typedef struct {
   GSettings *gsettings_ui;
 
   EmpathySoundManager *sound_mgr;
+
+  /* owned EmpathyContact -> owned PresenceChange */
+  GHashTable *presence_changes;
+  guint presence_changes_idle_id;
+  gint64 presence_events_window;
+  guint presence_events_count;
+  gint64 presence_sound_time;
 } EmpathyEventManagerPriv;
 
+typedef struct {
+  /* presence before the first change of the batch */
+  TpConnectionPresenceType previous;
+  /* presence after the last change of the batch */
+  TpConnectionPresenceType current;
+} PresenceChange;
+
 typedef struct _EventPriv EventPriv;
 typedef void (*EventFunc) (EventPriv *event);
 
@@ -1203,70 +1225,158 @@ event_manager_pendings_changed_cb (EmpathyContactList  *list,
   g_free (header);
 }
 
-static void
-event_manager_presence_changed_cb (EmpathyContact *contact,
-    TpConnectionPresenceType current,
-    TpConnectionPresenceType previous,
-    EmpathyEventManager *manager)
+static gboolean
+event_manager_presence_event_allowed (EmpathyEventManager *manager,
+    gint64 now)
 {
   EmpathyEventManagerPriv *priv = GET_PRIV (manager);
-  TpAccount *account;
+
+  if (now - priv->presence_events_window > PRESENCE_EVENTS_WINDOW)
+    {
+      priv->presence_events_window = now;
+      priv->presence_events_count = 0;
+    }
+
+  if (priv->presence_events_count >= PRESENCE_EVENTS_MAX)
+    return FALSE;
+
+  priv->presence_events_count++;
+  return TRUE;
+}
+
+static gboolean
+event_manager_presence_changes_cb (gpointer user_data)
+{
+  EmpathyEventManager *manager = user_data;
+  EmpathyEventManagerPriv *priv = GET_PRIV (manager);
   EmpathyPresenceManager *presence_mgr;
-  GtkWidget *window = empathy_main_window_dup ();
+  GtkWidget *window;
+  GHashTableIter iter;
+  gpointer key, value;
+  gboolean notify_signout, notify_signin;
+  EmpathySound sound = LAST_EMPATHY_SOUND;
+  guint n_changes, n_events = 0;
+  gint64 now;
+
+  priv->presence_changes_idle_id = 0;
 
-  account = empathy_contact_get_account (contact);
+  n_changes = g_hash_table_size (priv->presence_changes);
+  DEBUG ("Processing %u presence changes", n_changes);
+
+  window = empathy_main_window_dup ();
   presence_mgr = empathy_presence_manager_dup_singleton ();
+  now = g_get_monotonic_time ();
 
-  if (empathy_presence_manager_account_is_just_connected (presence_mgr, account))
-    goto out;
+  notify_signout = g_settings_get_boolean (priv->gsettings_notif,
+      EMPATHY_PREFS_NOTIFICATIONS_CONTACT_SIGNOUT);
+  notify_signin = g_settings_get_boolean (priv->gsettings_notif,
+      EMPATHY_PREFS_NOTIFICATIONS_CONTACT_SIGNIN);
 
-  if (tp_connection_presence_type_cmp_availability (previous,
-        TP_CONNECTION_PRESENCE_TYPE_OFFLINE) > 0)
+  g_hash_table_iter_init (&iter, priv->presence_changes);
+  while (g_hash_table_iter_next (&iter, &key, &value))
     {
-      /* contact was online */
-      if (tp_connection_presence_type_cmp_availability (current,
-          TP_CONNECTION_PRESENCE_TYPE_OFFLINE) <= 0)
+      EmpathyContact *contact = key;
+      PresenceChange *change = value;
+      gboolean was_online, is_online;
+
+      was_online = tp_connection_presence_type_cmp_availability (
+          change->previous, TP_CONNECTION_PRESENCE_TYPE_OFFLINE) > 0;
+      is_online = tp_connection_presence_type_cmp_availability (
+          change->current, TP_CONNECTION_PRESENCE_TYPE_OFFLINE) > 0;
+
+      /* Contacts flapping within the batch cancel out */
+      if (was_online == is_online)
+        continue;
+
+      if (empathy_presence_manager_account_is_just_connected (presence_mgr,
+            empathy_contact_get_account (contact)))
+        continue;
+
+      if (was_online)
         {
           /* someone is logging off */
-          empathy_sound_manager_play (priv->sound_mgr, window,
-              EMPATHY_SOUND_CONTACT_DISCONNECTED);
+          sound = EMPATHY_SOUND_CONTACT_DISCONNECTED;
 
-          if (g_settings_get_boolean (priv->gsettings_notif,
-                EMPATHY_PREFS_NOTIFICATIONS_CONTACT_SIGNOUT))
+          if (notify_signout && event_manager_presence_event_allowed (manager,
+                now))
             {
               event_manager_add (manager, NULL, contact,
                   EMPATHY_EVENT_TYPE_PRESENCE_OFFLINE,
                   EMPATHY_IMAGE_AVATAR_DEFAULT,
                   empathy_contact_get_alias (contact), _("Disconnected"),
                   NULL, NULL, NULL);
+              n_events++;
             }
         }
-    }
-  else
-    {
-      /* contact was offline */
-      if (tp_connection_presence_type_cmp_availability (current,
-            TP_CONNECTION_PRESENCE_TYPE_OFFLINE) > 0)
+      else
         {
           /* someone is logging in */
-          empathy_sound_manager_play (priv->sound_mgr, window,
-              EMPATHY_SOUND_CONTACT_CONNECTED);
+          sound = EMPATHY_SOUND_CONTACT_CONNECTED;
 
-          if (g_settings_get_boolean (priv->gsettings_notif,
-                EMPATHY_PREFS_NOTIFICATIONS_CONTACT_SIGNIN))
+          if (notify_signin && event_manager_presence_event_allowed (manager,
+                now))
             {
               event_manager_add (manager, NULL, contact,
                   EMPATHY_EVENT_TYPE_PRESENCE_ONLINE,
                   EMPATHY_IMAGE_AVATAR_DEFAULT,
                   empathy_contact_get_alias (contact), _("Connected"),
                   NULL, NULL, NULL);
+              n_events++;
             }
         }
     }
 
-out:
+  /* One sound for the whole batch, reflecting the last change seen */
+  if (sound != LAST_EMPATHY_SOUND &&
+      now - priv->presence_sound_time >= PRESENCE_SOUND_INTERVAL)
+    {
+      empathy_sound_manager_play (priv->sound_mgr, window, sound);
+      priv->presence_sound_time = now;
+    }
+
+  if (n_changes > n_events)
+    DEBUG ("%u presence changes didn't raise an event", n_changes - n_events);
+
+  g_hash_table_remove_all (priv->presence_changes);
+
   g_object_unref (presence_mgr);
   g_object_unref (window);
+
+  return FALSE;
+}
+
+static void
+event_manager_presence_changed_cb (EmpathyContact *contact,
+    TpConnectionPresenceType current,
+    TpConnectionPresenceType previous,
+    EmpathyEventManager *manager)
+{
+  EmpathyEventManagerPriv *priv = GET_PRIV (manager);
+  PresenceChange *change;
+
+  /* Presence changes tend to come in storms (typically when an account
+   * reconnects), so gather everything arriving in the same main loop
+   * iteration and process it in one go. */
+  change = g_hash_table_lookup (priv->presence_changes, contact);
+  if (change == NULL)
+    {
+      change = g_slice_new (PresenceChange);
+      change->previous = previous;
+      g_hash_table_insert (priv->presence_changes, g_object_ref (contact),
+          change);
+    }
+
+  change->current = current;
+
+  if (priv->presence_changes_idle_id == 0)
+    priv->presence_changes_idle_id = g_idle_add (
+        event_manager_presence_changes_cb, manager);
+}
+
+static void
+presence_change_free (PresenceChange *change)
+{
+  g_slice_free (PresenceChange, change);
 }
 
 static void
@@ -1282,8 +1392,13 @@ event_manager_members_changed_cb (EmpathyContactList  *list,
     g_signal_connect (contact, "presence-changed",
         G_CALLBACK (event_manager_presence_changed_cb), manager);
   else
-    g_signal_handlers_disconnect_by_func (contact,
-        event_manager_presence_changed_cb, manager);
+    {
+      EmpathyEventManagerPriv *priv = GET_PRIV (manager);
+
+      g_signal_handlers_disconnect_by_func (contact,
+          event_manager_presence_changed_cb, manager);
+      g_hash_table_remove (priv->presence_changes, contact);
+    }
 }
 
 static GObject *
@@ -1314,6 +1429,10 @@ event_manager_finalize (GObject *object)
   if (priv->ringing > 0)
     empathy_sound_manager_stop (priv->sound_mgr, EMPATHY_SOUND_PHONE_INCOMING);
 
+  if (priv->presence_changes_idle_id != 0)
+    g_source_remove (priv->presence_changes_idle_id);
+  g_hash_table_unref (priv->presence_changes);
+
   g_slist_foreach (priv->events, (GFunc) event_free, NULL);
   g_slist_free (priv->events);
   g_slist_foreach (priv->approvals, (GFunc) event_manager_approval_free, NULL);
@@ -1380,6 +1499,9 @@ empathy_event_manager_init (EmpathyEventManager *manager)
 
   priv->sound_mgr = empathy_sound_manager_dup_singleton ();
 
+  priv->presence_changes = g_hash_table_new_full (NULL, NULL,
+      g_object_unref, (GDestroyNotify) presence_change_free);
+
   priv->contact_manager = empathy_contact_manager_dup_singleton ();
   g_signal_connect (priv->contact_manager, "pendings-changed",
     G_CALLBACK (event_manager_pendings_changed_cb), manager);
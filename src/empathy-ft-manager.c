@@ -79,6 +79,9 @@ G_DEFINE_TYPE (EmpathyFTManager, empathy_ft_manager, G_TYPE_OBJECT);
 
 #define GET_PRIV(obj) EMPATHY_GET_PRIV (obj, EmpathyFTManager)
 
+/* How many times per second the rows of ongoing transfers are updated */
+#define FT_MANAGER_MAX_UPDATES_PER_SECOND 4
+
 static EmpathyFTManager *manager_singleton = NULL;
 
 static void ft_handler_hashing_started_cb (EmpathyFTHandler *handler,
@@ -1101,6 +1104,8 @@ empathy_ft_manager_init (EmpathyFTManager *manager)
       g_direct_equal, (GDestroyNotify) g_object_unref,
       (GDestroyNotify) gtk_tree_row_reference_free);
 
+  empathy_ft_handler_set_max_progress_rate (FT_MANAGER_MAX_UPDATES_PER_SECOND);
+
   ft_manager_build_ui (manager);
 }
 
@@ -183,97 +183,86 @@ main_window_flash_stop (EmpathyMainWindow *window)
 	priv->flash_on = FALSE;
 }
 
-typedef struct {
-	EmpathyEvent       *event;
-	gboolean            on;
-	EmpathyMainWindow  *window;
-} FlashForeachData;
-
-static gboolean
-main_window_flash_foreach (GtkTreeModel *model,
-			   GtkTreePath  *path,
-			   GtkTreeIter  *iter,
-			   gpointer      user_data)
+static void
+main_window_flash_rows (EmpathyMainWindow *window,
+			EmpathyEvent      *event,
+			gboolean           on)
 {
-	FlashForeachData *data = (FlashForeachData *) user_data;
-	FolksIndividual *individual;
-	EmpathyContact   *contact;
-	const gchar      *icon_name;
-	GtkTreePath      *parent_path = NULL;
-	GtkTreeIter       parent_iter;
-	GdkPixbuf        *pixbuf = NULL;
-
-	gtk_tree_model_get (model, iter,
-			    EMPATHY_INDIVIDUAL_STORE_COL_INDIVIDUAL, &individual,
-			    -1);
+	EmpathyMainWindowPriv *priv = GET_PRIV (window);
+	GtkTreeModel     *model = GTK_TREE_MODEL (priv->individual_store);
+	GList            *iters, *l;
 
-	if (individual == NULL)
-		return FALSE;
+	iters = empathy_individual_store_find_contact (priv->individual_store,
+						       event->contact);
 
-	contact = empathy_contact_dup_from_folks_individual (individual);
-	if (contact != data->event->contact)
-		goto out;
+	for (l = iters; l != NULL; l = l->next) {
+		GtkTreeIter      *iter = l->data;
+		FolksIndividual  *individual;
+		GtkTreePath      *parent_path = NULL;
+		GtkTreeIter       parent_iter;
+		GdkPixbuf        *pixbuf = NULL;
 
-	if (data->on) {
-		icon_name = data->event->icon_name;
-		pixbuf = empathy_pixbuf_from_icon_name (icon_name, GTK_ICON_SIZE_MENU);
-	} else {
-		pixbuf = empathy_individual_store_get_individual_status_icon (
-						GET_PRIV (data->window)->individual_store,
-						individual);
-		if (pixbuf != NULL)
-			g_object_ref (pixbuf);
-	}
+		gtk_tree_model_get (model, iter,
+				    EMPATHY_INDIVIDUAL_STORE_COL_INDIVIDUAL, &individual,
+				    -1);
 
-	gtk_tree_store_set (GTK_TREE_STORE (model), iter,
-			    EMPATHY_INDIVIDUAL_STORE_COL_ICON_STATUS, pixbuf,
-			    -1);
+		if (individual == NULL)
+			continue;
 
-	/* To make sure the parent is shown correctly, we emit
-	 * the row-changed signal on the parent so it prompts
-	 * it to be refreshed by the filter func.
-	 */
-	if (gtk_tree_model_iter_parent (model, &parent_iter, iter)) {
-		parent_path = gtk_tree_model_get_path (model, &parent_iter);
-	}
-	if (parent_path) {
-		gtk_tree_model_row_changed (model, parent_path, &parent_iter);
-		gtk_tree_path_free (parent_path);
-	}
+		if (on) {
+			pixbuf = empathy_pixbuf_from_icon_name (event->icon_name,
+								GTK_ICON_SIZE_MENU);
+		} else {
+			pixbuf = empathy_individual_store_get_individual_status_icon (
+							priv->individual_store,
+							individual);
+			if (pixbuf != NULL)
+				g_object_ref (pixbuf);
+		}
 
-out:
-	g_object_unref (individual);
-	tp_clear_object (&contact);
-	tp_clear_object (&pixbuf);
+		gtk_tree_store_set (GTK_TREE_STORE (model), iter,
+				    EMPATHY_INDIVIDUAL_STORE_COL_ICON_STATUS, pixbuf,
+				    -1);
+
+		/* To make sure the parent is shown correctly, we emit
+		 * the row-changed signal on the parent so it prompts
+		 * it to be refreshed by the filter func.
+		 */
+		if (gtk_tree_model_iter_parent (model, &parent_iter, iter)) {
+			parent_path = gtk_tree_model_get_path (model, &parent_iter);
+		}
+		if (parent_path) {
+			gtk_tree_model_row_changed (model, parent_path, &parent_iter);
+			gtk_tree_path_free (parent_path);
+		}
 
-	return FALSE;
+		g_object_unref (individual);
+		tp_clear_object (&pixbuf);
+	}
+
+	g_list_foreach (iters, (GFunc) gtk_tree_iter_free, NULL);
+	g_list_free (iters);
 }
 
 static gboolean
 main_window_flash_cb (EmpathyMainWindow *window)
 {
 	EmpathyMainWindowPriv *priv = GET_PRIV (window);
-	GtkTreeModel     *model;
 	GSList           *events, *l;
 	gboolean          found_event = FALSE;
-	FlashForeachData  data;
 
 	priv->flash_on = !priv->flash_on;
-	data.on = priv->flash_on;
-	model = GTK_TREE_MODEL (priv->individual_store);
 
 	events = empathy_event_manager_get_events (priv->event_manager);
 	for (l = events; l; l = l->next) {
-		data.event = l->data;
-		data.window = window;
-		if (!data.event->contact || !data.event->must_ack) {
+		EmpathyEvent *event = l->data;
+
+		if (!event->contact || !event->must_ack) {
 			continue;
 		}
 
 		found_event = TRUE;
-		gtk_tree_model_foreach (model,
-					main_window_flash_foreach,
-					&data);
+		main_window_flash_rows (window, event, priv->flash_on);
 	}
 
 	if (!found_event) {
@@ -432,83 +421,47 @@ main_window_auth_display (EmpathyMainWindow *window,
 }
 
 static void
-modify_event_count (GtkTreeModel *model,
-		    GtkTreeIter *iter,
+modify_event_count (EmpathyMainWindow *self,
 		    EmpathyEvent *event,
 		    gboolean increase)
 {
-	FolksIndividual *individual;
-	EmpathyContact *contact;
-	guint count;
+	EmpathyMainWindowPriv *priv = GET_PRIV (self);
+	GtkTreeModel *model = GTK_TREE_MODEL (priv->individual_store);
+	GList *iters, *l;
 
-	gtk_tree_model_get (model, iter,
-			    EMPATHY_INDIVIDUAL_STORE_COL_INDIVIDUAL, &individual,
-			    EMPATHY_INDIVIDUAL_STORE_COL_EVENT_COUNT, &count,
-			    -1);
+	iters = empathy_individual_store_find_contact (priv->individual_store,
+						       event->contact);
 
-	if (individual == NULL)
-		return;
+	for (l = iters; l != NULL; l = l->next) {
+		GtkTreeIter *iter = l->data;
+		guint count;
+
+		gtk_tree_model_get (model, iter,
+				    EMPATHY_INDIVIDUAL_STORE_COL_EVENT_COUNT, &count,
+				    -1);
 
-	increase ? count++ : count--;
+		increase ? count++ : count--;
 
-	contact = empathy_contact_dup_from_folks_individual (individual);
-	if (contact == event->contact) {
 		gtk_tree_store_set (GTK_TREE_STORE (model), iter,
 				    EMPATHY_INDIVIDUAL_STORE_COL_EVENT_COUNT, count, -1);
 	}
 
-	tp_clear_object (&contact);
-	g_object_unref (individual);
-}
-
-static gboolean
-increase_event_count_foreach (GtkTreeModel *model,
-			      GtkTreePath *path,
-			      GtkTreeIter *iter,
-			      gpointer user_data)
-{
-	EmpathyEvent *event = user_data;
-
-	modify_event_count (model, iter, event, TRUE);
-
-	return FALSE;
+	g_list_foreach (iters, (GFunc) gtk_tree_iter_free, NULL);
+	g_list_free (iters);
 }
 
 static void
 increase_event_count (EmpathyMainWindow *self,
 		      EmpathyEvent *event)
 {
-	EmpathyMainWindowPriv *priv = GET_PRIV (self);
-	GtkTreeModel *model;
-
-	model = GTK_TREE_MODEL (priv->individual_store);
-
-	gtk_tree_model_foreach (model, increase_event_count_foreach, event);
-}
-
-static gboolean
-decrease_event_count_foreach (GtkTreeModel *model,
-			      GtkTreePath *path,
-			      GtkTreeIter *iter,
-			      gpointer user_data)
-{
-	EmpathyEvent *event = user_data;
-
-	modify_event_count (model, iter, event, FALSE);
-
-	return FALSE;
+	modify_event_count (self, event, TRUE);
 }
 
 static void
 decrease_event_count (EmpathyMainWindow *self,
 		      EmpathyEvent *event)
 {
-	EmpathyMainWindowPriv *priv = GET_PRIV (self);
-	GtkTreeModel *model;
-
-	model = GTK_TREE_MODEL (priv->individual_store);
-
-	gtk_tree_model_foreach (model, decrease_event_count_foreach, event);
+	modify_event_count (self, event, FALSE);
 }
 
 static void
@@ -530,9 +483,6 @@ main_window_event_removed_cb (EmpathyEventManager *manager,
 			      EmpathyEvent        *event,
 			      EmpathyMainWindow   *window)
 {
-	EmpathyMainWindowPriv *priv = GET_PRIV (window);
-	FlashForeachData data;
-
 	if (event->type == EMPATHY_EVENT_TYPE_AUTH) {
 		main_window_remove_auth (window, event);
 		return;
@@ -543,13 +493,7 @@ main_window_event_removed_cb (EmpathyEventManager *manager,
 	}
 
 	decrease_event_count (window, event);
-
-	data.on = FALSE;
-	data.event = event;
-	data.window = window;
-	gtk_tree_model_foreach (GTK_TREE_MODEL (priv->individual_store),
-				main_window_flash_foreach,
-				&data);
+	main_window_flash_rows (window, event, FALSE);
 }
 
 static void
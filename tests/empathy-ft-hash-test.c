@@ -0,0 +1,101 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "test-helper.h"
+
+#include <libempathy/empathy-ft-hash.h>
+
+/* Large enough to be read in several chunks */
+#define DATA_SIZE (5 * 1024 * 1024 / 2)
+
+typedef struct
+{
+  guint64 last;
+  guint n_calls;
+} Progress;
+
+static void
+progress_cb (guint64 hashed_bytes,
+    gpointer user_data)
+{
+  Progress *progress = user_data;
+
+  g_assert_cmpuint (hashed_bytes, >=, progress->last);
+
+  progress->last = hashed_bytes;
+  progress->n_calls++;
+}
+
+static void
+check_hash_stream (TpFileHashType type,
+    const guchar *data,
+    gsize len)
+{
+  GInputStream *stream;
+  Progress progress = { 0, 0 };
+  GError *error = NULL;
+  gchar *hash, *expected;
+
+  stream = g_memory_input_stream_new_from_data (data, len, NULL);
+
+  hash = empathy_ft_hash_stream (stream, type, NULL, progress_cb, &progress,
+      &error);
+  g_assert_no_error (error);
+
+  expected = g_compute_checksum_for_data (
+      empathy_ft_hash_type_to_checksum_type (type), data, len);
+  g_assert_cmpstr (hash, ==, expected);
+
+  /* The last progress report is for the whole stream */
+  g_assert_cmpuint (progress.n_calls, >, 0);
+  g_assert_cmpuint (progress.last, ==, len);
+
+  g_free (hash);
+  g_free (expected);
+  g_object_unref (stream);
+}
+
+static void
+test_ft_hash_stream (void)
+{
+  TpFileHashType types[] = {
+      TP_FILE_HASH_TYPE_MD5,
+      TP_FILE_HASH_TYPE_SHA1,
+      TP_FILE_HASH_TYPE_SHA256,
+  };
+  guchar *data;
+  guint i;
+
+  data = g_malloc (DATA_SIZE);
+  for (i = 0; i < DATA_SIZE; i++)
+    data[i] = g_test_rand_int_range (0, 256);
+
+  g_assert (!empathy_ft_hash_type_is_supported (TP_FILE_HASH_TYPE_NONE));
+
+  for (i = 0; i < G_N_ELEMENTS (types); i++)
+    {
+      g_assert (empathy_ft_hash_type_is_supported (types[i]));
+
+      check_hash_stream (types[i], data, 0);
+      check_hash_stream (types[i], data, 1);
+      check_hash_stream (types[i], data, DATA_SIZE);
+    }
+
+  g_free (data);
+}
+
+int
+main (int argc,
+    char **argv)
+{
+  int result;
+
+  test_init (argc, argv);
+
+  g_test_add_func ("/ft-hash/stream", test_ft_hash_stream);
+
+  result = g_test_run ();
+  test_deinit ();
+
+  return result;
+}
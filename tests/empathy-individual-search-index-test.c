@@ -0,0 +1,198 @@
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "test-helper.h"
+
+#include <libempathy-gtk/empathy-individual-search-index-private.h>
+#include <libempathy-gtk/empathy-live-search.h>
+
+typedef struct
+{
+  EmpathyIndividualSearchIndex *index;
+  /* owned GObject -> owned stripped words, what the index was given */
+  GHashTable *items;
+} Fixture;
+
+static void
+words_free (GPtrArray *words)
+{
+  if (words != NULL)
+    g_ptr_array_unref (words);
+}
+
+static void
+setup (Fixture *f,
+    gconstpointer data)
+{
+  f->index = empathy_individual_search_index_new_unbound ();
+  f->items = g_hash_table_new_full (NULL, NULL, g_object_unref,
+      (GDestroyNotify) words_free);
+}
+
+static void
+teardown (Fixture *f,
+    gconstpointer data)
+{
+  g_object_unref (f->index);
+  g_hash_table_unref (f->items);
+}
+
+static GObject *
+add_item (Fixture *f,
+    const gchar *name)
+{
+  GObject *item = g_object_new (G_TYPE_OBJECT, NULL);
+  GPtrArray *words = empathy_live_search_strip_utf8_string (name);
+
+  empathy_individual_search_index_set_words (f->index, item, words);
+  g_hash_table_insert (f->items, item, words);
+
+  return item;
+}
+
+static void
+change_item (Fixture *f,
+    GObject *item,
+    const gchar *name)
+{
+  GPtrArray *words = empathy_live_search_strip_utf8_string (name);
+
+  empathy_individual_search_index_set_words (f->index, item, words);
+  g_hash_table_insert (f->items, g_object_ref (item), words);
+}
+
+static void
+remove_item (Fixture *f,
+    GObject *item)
+{
+  empathy_individual_search_index_remove (f->index, item);
+  g_hash_table_remove (f->items, item);
+}
+
+/* Looks @text up, and checks that every item matching it is a candidate */
+static GHashTable *
+lookup (Fixture *f,
+    const gchar *text)
+{
+  GHashTable *candidates = g_hash_table_new (NULL, NULL);
+  GPtrArray *words = empathy_live_search_strip_utf8_string (text);
+  GHashTableIter iter;
+  gpointer item, item_words;
+
+  empathy_individual_search_index_lookup (f->index, text, words, candidates);
+
+  g_hash_table_iter_init (&iter, f->items);
+  while (g_hash_table_iter_next (&iter, &item, &item_words))
+    {
+      if (empathy_live_search_match_stripped_words (item_words, words))
+        g_assert (g_hash_table_lookup_extended (candidates, item,
+              NULL, NULL));
+    }
+
+  if (words != NULL)
+    g_ptr_array_unref (words);
+
+  return candidates;
+}
+
+/* Checks that looking @text up gives the @n_expected items which follow */
+static void
+check_lookup (Fixture *f,
+    const gchar *text,
+    guint n_expected,
+    ...)
+{
+  GHashTable *candidates = lookup (f, text);
+  va_list args;
+  guint i;
+
+  g_assert_cmpuint (g_hash_table_size (candidates), ==, n_expected);
+
+  va_start (args, n_expected);
+  for (i = 0; i < n_expected; i++)
+    g_assert (g_hash_table_lookup_extended (candidates,
+          va_arg (args, GObject *), NULL, NULL));
+  va_end (args);
+
+  g_hash_table_unref (candidates);
+}
+
+static void
+test_search_index_lookup (Fixture *f,
+    gconstpointer data)
+{
+  GObject *john, *jo, *gaetan, *x;
+
+  john = add_item (f, "John Smith");
+  jo = add_item (f, "Jo Smith");
+  gaetan = add_item (f, "Gaëtan Élève");
+  x = add_item (f, "X");
+
+  /* The keys are the first 1, 2 and 3 chars, longer search words are
+   * looked up by their first 3 chars */
+  check_lookup (f, "j", 2, john, jo);
+  check_lookup (f, "jo", 2, john, jo);
+  check_lookup (f, "joh", 1, john);
+  check_lookup (f, "john", 1, john);
+  check_lookup (f, "x", 1, x);
+  check_lookup (f, "xy", 0);
+  check_lookup (f, "q", 0);
+
+  /* Any word, and a search word going on with the next word */
+  check_lookup (f, "smi", 2, john, jo);
+  check_lookup (f, "johns", 1, john);
+  check_lookup (f, "josm", 1, jo);
+
+  /* Only the first search word is looked up */
+  check_lookup (f, "smith jo", 2, john, jo);
+
+  /* Non-ASCII words are indexed stripped */
+  check_lookup (f, "gae", 1, gaetan);
+  check_lookup (f, "GAË", 1, gaetan);
+  check_lookup (f, "élè", 1, gaetan);
+  check_lookup (f, "e\xcc\x81le", 1, gaetan);
+}
+
+static void
+test_search_index_change (Fixture *f,
+    gconstpointer data)
+{
+  GObject *john, *jo;
+
+  john = add_item (f, "John Smith");
+  jo = add_item (f, "Jo Smith");
+
+  change_item (f, john, "Alice Jones");
+  check_lookup (f, "joh", 0);
+  check_lookup (f, "smi", 1, jo);
+  check_lookup (f, "ali", 1, john);
+  check_lookup (f, "jo", 2, john, jo);
+
+  change_item (f, john, "");
+  check_lookup (f, "ali", 0);
+  check_lookup (f, "jo", 1, jo);
+
+  remove_item (f, jo);
+  check_lookup (f, "jo", 0);
+  check_lookup (f, "smi", 0);
+}
+
+int
+main (int argc,
+    char **argv)
+{
+  int result;
+
+  test_init (argc, argv);
+
+  g_test_add ("/individual-search-index/lookup", Fixture, NULL,
+      setup, test_search_index_lookup, teardown);
+  g_test_add ("/individual-search-index/change", Fixture, NULL,
+      setup, test_search_index_change, teardown);
+
+  result = g_test_run ();
+  test_deinit ();
+
+  return result;
+}
@@ -46,6 +46,11 @@ test_live_search (void)
       { "Foo Bar Baz", "   b  ", TRUE },
       { "Foo Bar Baz", "bar bazz", FALSE },
 
+      /* A word can go on with the next one */
+      { "John Smith", "johns", TRUE },
+      { "Hello World", "hellow", TRUE },
+      { "Hello World", "hellowx", FALSE },
+
       { NULL, NULL, FALSE }
     };
   guint i;
@@ -53,6 +58,7 @@ test_live_search (void)
   DEBUG ("Started");
   for (i = 0; tests[i].string != NULL; i ++)
     {
+      GPtrArray *string_words, *words;
       gboolean match;
       gboolean ok;
 
@@ -64,6 +70,186 @@ test_live_search (void)
           ok ? "OK" : "FAILED");
 
       g_assert (ok);
+
+      /* Matching pre-stripped words must give the same result */
+      string_words = empathy_live_search_strip_utf8_string (tests[i].string);
+      words = empathy_live_search_strip_utf8_string (tests[i].prefix);
+
+      match = empathy_live_search_match_stripped_words (string_words, words);
+      g_assert (match == tests[i].should_match);
+
+      if (string_words != NULL)
+        g_ptr_array_unref (string_words);
+      if (words != NULL)
+        g_ptr_array_unref (words);
+    }
+}
+
+/* The stripping code as it was before it used lookup tables, to check the
+ * tables against. */
+static gunichar
+reference_stripped_char (gunichar ch)
+{
+  gunichar retval = 0;
+  gunichar *decomp;
+  gsize dlen;
+
+  switch (g_unichar_type (ch))
+    {
+    case G_UNICODE_CONTROL:
+    case G_UNICODE_FORMAT:
+    case G_UNICODE_UNASSIGNED:
+    case G_UNICODE_NON_SPACING_MARK:
+    case G_UNICODE_COMBINING_MARK:
+    case G_UNICODE_ENCLOSING_MARK:
+      break;
+    default:
+      ch = g_unichar_tolower (ch);
+      decomp = g_unicode_canonical_decomposition (ch, &dlen);
+      if (decomp != NULL)
+        {
+          retval = decomp[0];
+          g_free (decomp);
+        }
+    }
+
+  return retval;
+}
+
+static GPtrArray *
+reference_strip_utf8_string (const gchar *string)
+{
+  GPtrArray *word_array = NULL;
+  GString *word = NULL;
+  const gchar *p;
+
+  for (p = string; *p != '\0'; p = g_utf8_next_char (p))
+    {
+      gunichar sc = reference_stripped_char (g_utf8_get_char (p));
+
+      if (sc == 0)
+        continue;
+
+      if (g_unichar_isalnum (sc))
+        {
+          if (word == NULL)
+            word = g_string_new (NULL);
+          g_string_append_unichar (word, sc);
+          continue;
+        }
+
+      if (word != NULL)
+        {
+          if (word_array == NULL)
+            word_array = g_ptr_array_new_with_free_func (g_free);
+          g_ptr_array_add (word_array, g_string_free (word, FALSE));
+          word = NULL;
+        }
+    }
+
+  if (word != NULL)
+    {
+      if (word_array == NULL)
+        word_array = g_ptr_array_new_with_free_func (g_free);
+      g_ptr_array_add (word_array, g_string_free (word, FALSE));
+    }
+
+  return word_array;
+}
+
+static void
+check_strip (const gchar *string)
+{
+  GPtrArray *words, *expected;
+  guint i;
+
+  words = empathy_live_search_strip_utf8_string (string);
+  expected = reference_strip_utf8_string (string);
+
+  if (expected == NULL)
+    {
+      g_assert (words == NULL);
+      return;
+    }
+
+  g_assert (words != NULL);
+  g_assert_cmpuint (words->len, ==, expected->len);
+
+  for (i = 0; i < words->len; i++)
+    g_assert_cmpstr (g_ptr_array_index (words, i), ==,
+        g_ptr_array_index (expected, i));
+
+  g_ptr_array_unref (words);
+  g_ptr_array_unref (expected);
+}
+
+static void
+test_live_search_strip (void)
+{
+  const gchar *strings[] =
+    {
+      "Hello World",
+      "  Foo\tBar-Baz!! ",
+      "Jörgen Gaëtan élève AzaÏs",
+      "Jo\xcc\x88rgen",
+      "Ελληνικά Кириллица Ỳêś",
+      "a\x01" "b\x7f" "c",
+      NULL
+    };
+  gunichar ch;
+  guint i;
+
+  for (i = 0; strings[i] != NULL; i++)
+    check_strip (strings[i]);
+
+  /* Every char, between two letters so it's seen as a separator, an
+   * ignored char or part of the word */
+  for (ch = 1; ch <= 0x10FFFF; ch++)
+    {
+      gchar string[8];
+      gint len;
+
+      /* Surrogates can't be encoded in UTF-8 */
+      if (ch >= 0xD800 && ch < 0xE000)
+        continue;
+
+      string[0] = 'x';
+      len = g_unichar_to_utf8 (ch, string + 1);
+      string[len + 1] = 'y';
+      string[len + 2] = '\0';
+
+      check_strip (string);
+    }
+}
+
+static void
+test_live_search_phone_number (void)
+{
+  struct
+    {
+      const gchar *string;
+      const gchar *number;
+    } tests[] =
+    {
+      { "0123456789", "0123456789" },
+      { "+33 1 23-45.67 (89)", "+33123456789" },
+      { "  12", "12" },
+      { "1+2", NULL },
+      { "+", NULL },
+      { "- ()", NULL },
+      { "call 123", NULL },
+      { "", NULL },
+      { NULL, NULL }
+    };
+  guint i;
+
+  for (i = 0; tests[i].string != NULL; i++)
+    {
+      gchar *number;
+
+      number = empathy_live_search_strip_phone_number (tests[i].string);
+      g_assert_cmpstr (number, ==, tests[i].number);
+      g_free (number);
     }
 }
 
@@ -76,6 +262,9 @@ main (int argc,
   test_init (argc, argv);
 
   g_test_add_func ("/live-search", test_live_search);
+  g_test_add_func ("/live-search/strip", test_live_search_strip);
+  g_test_add_func ("/live-search/phone-number",
+      test_live_search_phone_number);
 
   result = g_test_run ();
   test_deinit ();
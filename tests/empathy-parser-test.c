@@ -77,10 +77,14 @@ test_parsers (void)
       "a:)b", "a[:)]b",
       ">:)", "[>:)]",
       ">:(", "&gt;[:(]",
+      ":-(|x", "[:-(]|x",
+      ":):(:-))", "[:)][:(][:-))]",
 
       /* Smileys and links mixed */
       ":)http://foo.com", "[:)][http://foo.com]",
       "a :) b http://foo.com c :( d www.test.com e", "a [:)] b [http://foo.com] c [:(] d [www.test.com] e",
+      "http://foo.com:)", "[http://foo.com][:)]",
+      "www.foo.com :) ftp.bar.com", "[www.foo.com] [:)] [ftp.bar.com]",
 
       /* '\r' should be stripped */
       "badger\n\rmushroom", "badger\nmushroom",
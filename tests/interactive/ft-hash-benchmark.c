@@ -0,0 +1,243 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+/*
+ * Copyright (C) 2012 Collabora Ltd.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA  02110-1301  USA
+ */
+
+/* Measures the throughput of the file transfer hashing code:
+ *
+ *   ft-hash-benchmark [FILE...]
+ *
+ * Without arguments, a file of random data is generated and hashed. Each
+ * file is also hashed with 4 KiB reads, as EmpathyFTHandler used to do, for
+ * comparison. Each file is read once before being measured so both ways
+ * run with a hot page cache, and which one runs first alternates. */
+
+#include <config.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <gio/gio.h>
+
+#include <libempathy/empathy-ft-hash.h>
+
+#define GENERATED_SIZE (256 * 1024 * 1024)
+#define SMALL_BUFFER_SIZE 4096
+
+static guint n_progress;
+
+static void
+progress_cb (guint64  hashed_bytes,
+	     gpointer user_data)
+{
+	n_progress++;
+}
+
+/* What EmpathyFTHandler did before using empathy_ft_hash_stream() */
+static gchar *
+hash_stream_small_reads (GInputStream    *stream,
+			 GChecksumType    type,
+			 GError         **error)
+{
+	GChecksum *checksum;
+	guchar buffer[SMALL_BUFFER_SIZE];
+	gssize bytes_read;
+	gchar *retval = NULL;
+
+	checksum = g_checksum_new (type);
+
+	while ((bytes_read = g_input_stream_read (stream, buffer,
+						  sizeof (buffer), NULL,
+						  error)) > 0) {
+		g_checksum_update (checksum, buffer, bytes_read);
+		n_progress++;
+	}
+
+	if (bytes_read == 0)
+		retval = g_strdup (g_checksum_get_string (checksum));
+
+	g_checksum_free (checksum);
+
+	return retval;
+}
+
+static void
+benchmark (GFile          *file,
+	   guint64         size,
+	   TpFileHashType  type,
+	   gboolean        small_reads)
+{
+	GFileInputStream *stream;
+	GTimer *timer;
+	GError *error = NULL;
+	gchar *hash;
+	gdouble elapsed;
+
+	stream = g_file_read (file, NULL, &error);
+	if (stream == NULL) {
+		g_printerr ("Can't open file: %s\n", error->message);
+		g_error_free (error);
+		return;
+	}
+
+	n_progress = 0;
+	timer = g_timer_new ();
+
+	if (small_reads) {
+		hash = hash_stream_small_reads (G_INPUT_STREAM (stream),
+						empathy_ft_hash_type_to_checksum_type (type),
+						&error);
+	} else {
+		hash = empathy_ft_hash_stream (G_INPUT_STREAM (stream), type,
+					       NULL, progress_cb, NULL, &error);
+	}
+
+	elapsed = g_timer_elapsed (timer, NULL);
+
+	if (hash == NULL) {
+		g_printerr ("Can't hash file: %s\n", error->message);
+		g_error_free (error);
+	} else {
+		g_print ("  %-6s %-11s %8.1f MB/s %8u progress reports  %s\n",
+			 type == TP_FILE_HASH_TYPE_MD5 ? "MD5" :
+			 type == TP_FILE_HASH_TYPE_SHA1 ? "SHA1" : "SHA256",
+			 small_reads ? "4 KiB reads" : "engine",
+			 size / elapsed / (1024 * 1024), n_progress, hash);
+	}
+
+	g_free (hash);
+	g_timer_destroy (timer);
+	g_object_unref (stream);
+}
+
+/* Reads the whole file once, so that it is in the page cache for all the
+ * measured runs */
+static void
+warm_up (GFile *file)
+{
+	GFileInputStream *stream;
+	guchar *buffer;
+
+	stream = g_file_read (file, NULL, NULL);
+	if (stream == NULL)
+		return;
+
+	buffer = g_malloc (GENERATED_SIZE / 256);
+	while (g_input_stream_read (G_INPUT_STREAM (stream), buffer,
+				    GENERATED_SIZE / 256, NULL, NULL) > 0)
+		;
+
+	g_free (buffer);
+	g_object_unref (stream);
+}
+
+static gchar *
+generate_file (void)
+{
+	gchar *path;
+	guint32 *data;
+	guint i;
+	gint fd;
+	GError *error = NULL;
+
+	fd = g_file_open_tmp ("ft-hash-benchmark-XXXXXX", &path, &error);
+	if (fd < 0) {
+		g_printerr ("Can't create file: %s\n", error->message);
+		g_error_free (error);
+		return NULL;
+	}
+	close (fd);
+
+	data = g_malloc (GENERATED_SIZE);
+	for (i = 0; i < GENERATED_SIZE / sizeof (guint32); i++)
+		data[i] = g_random_int ();
+
+	if (!g_file_set_contents (path, (gchar *) data, GENERATED_SIZE,
+				  &error)) {
+		g_printerr ("Can't write file: %s\n", error->message);
+		g_error_free (error);
+		g_unlink (path);
+		g_free (path);
+		path = NULL;
+	}
+
+	g_free (data);
+
+	return path;
+}
+
+int
+main (int argc, char *argv[])
+{
+	static const TpFileHashType types[] = {
+		TP_FILE_HASH_TYPE_MD5,
+		TP_FILE_HASH_TYPE_SHA1,
+		TP_FILE_HASH_TYPE_SHA256,
+	};
+	gchar *generated = NULL;
+	gint i;
+
+	g_type_init ();
+
+	if (argc < 2) {
+		generated = generate_file ();
+		if (generated == NULL)
+			return EXIT_FAILURE;
+	}
+
+	for (i = 1; i < MAX (argc, 2); i++) {
+		const gchar *path = generated != NULL ? generated : argv[i];
+		GFile *file;
+		GFileInfo *info;
+		GError *error = NULL;
+		guint64 size;
+		guint t;
+
+		file = g_file_new_for_commandline_arg (path);
+		info = g_file_query_info (file,
+					  G_FILE_ATTRIBUTE_STANDARD_SIZE,
+					  G_FILE_QUERY_INFO_NONE, NULL, &error);
+		if (info == NULL) {
+			g_printerr ("%s: %s\n", path, error->message);
+			g_error_free (error);
+			g_object_unref (file);
+			continue;
+		}
+
+		size = g_file_info_get_size (info);
+		g_print ("%s (%" G_GUINT64_FORMAT " bytes)\n", path, size);
+
+		warm_up (file);
+
+		for (t = 0; t < G_N_ELEMENTS (types); t++) {
+			/* alternate, so neither always runs first */
+			benchmark (file, size, types[t], t % 2 == 0);
+			benchmark (file, size, types[t], t % 2 != 0);
+		}
+
+		g_object_unref (info);
+		g_object_unref (file);
+	}
+
+	if (generated != NULL) {
+		g_unlink (generated);
+		g_free (generated);
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,164 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*- */
+/*
+ * Copyright (C) 2012 Collabora Ltd.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public
+ * License along with this program; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA  02110-1301  USA
+ */
+
+/* Measures the contact search index:
+ *
+ *   search-index-benchmark [N_CONTACTS]
+ *
+ * N_CONTACTS (10000 by default) names made of two random words are
+ * indexed, then texts of 1 to 5 chars are looked up and the candidates
+ * confirmed with empathy_live_search_match_stripped_words(), as the
+ * contact list does on each key stroke. */
+
+#include <config.h>
+#include <stdlib.h>
+#include <glib.h>
+#include <glib-object.h>
+
+#include <libempathy-gtk/empathy-individual-search-index-private.h>
+#include <libempathy-gtk/empathy-live-search.h>
+
+#define DEFAULT_N_CONTACTS 10000
+#define N_LOOKUPS 1000
+
+static const gchar *syllables[] = {
+	"an", "be", "cho", "da", "el", "fi", "gu", "ha", "io", "ja",
+	"ke", "li", "mo", "nu", "or", "pa", "qui", "ro", "sa", "te",
+	"ul", "vi", "wa", "xe", "yo", "zu", "ë", "ño", "çi", "ø",
+};
+
+static gchar *
+random_word (void)
+{
+	GString *word = g_string_new (NULL);
+	gint i, n = g_random_int_range (2, 5);
+
+	for (i = 0; i < n; i++)
+		g_string_append (word, syllables[g_random_int_range (0,
+			G_N_ELEMENTS (syllables))]);
+
+	return g_string_free (word, FALSE);
+}
+
+int
+main (int argc, char *argv[])
+{
+	EmpathyIndividualSearchIndex *index;
+	GObject **items;
+	GPtrArray **names;
+	GHashTable *candidates;
+	GTimer *timer;
+	guint n_contacts = DEFAULT_N_CONTACTS;
+	guint i, len;
+
+	g_type_init ();
+
+	if (argc > 1)
+		n_contacts = MAX (atoi (argv[1]), 1);
+
+	items = g_new (GObject *, n_contacts);
+	names = g_new (GPtrArray *, n_contacts);
+
+	for (i = 0; i < n_contacts; i++) {
+		gchar *first = random_word ();
+		gchar *last = random_word ();
+		gchar *name = g_strdup_printf ("%s %s", first, last);
+
+		items[i] = g_object_new (G_TYPE_OBJECT, NULL);
+		names[i] = empathy_live_search_strip_utf8_string (name);
+		g_object_set_data (items[i], "words", names[i]);
+
+		g_free (name);
+		g_free (first);
+		g_free (last);
+	}
+
+	index = empathy_individual_search_index_new_unbound ();
+
+	timer = g_timer_new ();
+	for (i = 0; i < n_contacts; i++)
+		empathy_individual_search_index_set_words (index, items[i],
+			names[i]);
+	g_print ("Indexing %u contacts: %.1f ms\n", n_contacts,
+		 g_timer_elapsed (timer, NULL) * 1000);
+
+	candidates = g_hash_table_new (NULL, NULL);
+
+	for (len = 1; len <= 5; len++) {
+		gdouble elapsed = 0;
+		guint n_candidates = 0, n_matches = 0;
+
+		for (i = 0; i < N_LOOKUPS; i++) {
+			gchar *word = random_word ();
+			gchar *text;
+			GPtrArray *words;
+			GHashTableIter iter;
+			gpointer item;
+
+			/* a prefix of a random name, which may not exist */
+			text = g_strndup (word, g_utf8_offset_to_pointer (word,
+				MIN (len, g_utf8_strlen (word, -1))) - word);
+			words = empathy_live_search_strip_utf8_string (text);
+
+			g_timer_start (timer);
+
+			empathy_individual_search_index_lookup (index, text,
+				words, candidates);
+
+			g_hash_table_iter_init (&iter, candidates);
+			while (g_hash_table_iter_next (&iter, &item, NULL)) {
+				if (empathy_live_search_match_stripped_words (
+						g_object_get_data (item, "words"),
+						words))
+					n_matches++;
+			}
+
+			g_timer_stop (timer);
+			elapsed += g_timer_elapsed (timer, NULL);
+
+			n_candidates += g_hash_table_size (candidates);
+			g_hash_table_remove_all (candidates);
+
+			if (words != NULL)
+				g_ptr_array_unref (words);
+			g_free (text);
+			g_free (word);
+		}
+
+		g_print ("%u char text: %8.3f ms per key stroke, "
+			 "%u candidates and %u matches on average\n",
+			 len, elapsed * 1000 / N_LOOKUPS,
+			 n_candidates / N_LOOKUPS, n_matches / N_LOOKUPS);
+	}
+
+	g_hash_table_unref (candidates);
+	g_timer_destroy (timer);
+	g_object_unref (index);
+
+	for (i = 0; i < n_contacts; i++) {
+		g_object_unref (items[i]);
+		if (names[i] != NULL)
+			g_ptr_array_unref (names[i]);
+	}
+	g_free (items);
+	g_free (names);
+
+	return EXIT_SUCCESS;
+}